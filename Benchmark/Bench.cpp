@@ -0,0 +1,463 @@
+/**************************************************************************************************************
+ * Benchmark harness for the edge, line & contour detectors
+ *
+ * Runs every detector linked in over a corpus of images & prints, as JSON, the min/median/p99 latency,
+ * the throughput in megapixels/s, the peak resident memory & the # of segments (lines for EDLines) per
+ * detector & image. The detectors that are linked in are chosen at compile time; the Makefile links them all:
+ *   BENCH_ED       ED, EDPF, CannySR & CannySRPF from ../ED
+ *   BENCH_PEL      PEL from ../PEL. Gray images are turned into Canny edge maps first (needs BENCH_ED)
+ *   BENCH_EDLINES  EDLines from ../EDLines, one image at a time & in batches (EDLinesBatch)
+ *   BENCH_COLORED, BENCH_GEDCONTOURS, BENCH_CEDCONTOURS  the detectors of those directories
+ * Color detectors run on PPM images; a PGM image is given to them as R=G=B.
+ *
+ * Built with -DPROFILE (make profile), each result also lists the time per run of the detector stages & -p writes
+ * all timed runs as a Chrome trace.
+ *
+ * Usage: bench [-w warmup] [-r repeat] [-t threads] [-l linkThreads] [-d name,name,...] [-o out.json] [-p trace.json] image ...
+ * -t sets the threads of PEL, of the EDPF/ColorEDPF validation & of the EDLinesBatch pool, -l those of ED/EDPF's
+ * anchor linking (1 by default: the single threaded code). A run of EDLinesBatch detects BENCH_BATCH_FRAMES copies
+ * of the image; its times are per run & its megapixels/s count all the frames.
+ * Without images, runs on the images that come with EDLines & PELtext (run it from this directory)
+ **************************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "Timer.h"
+#include "ImageIO.h"
+#include "Profiler.h"
+
+#ifdef BENCH_ED
+#include "../ED/EDLib.h"
+#endif
+#ifdef BENCH_PEL
+#include "../PEL/PEL.h"
+#endif
+#ifdef BENCH_EDLINES
+#include "../EDLines/EDLinesLib.h"
+#endif
+#ifdef BENCH_COLORED
+#include "../ColorED/ColorEDLib.h"
+#endif
+#ifdef BENCH_GEDCONTOURS
+#include "../GEDContours/GEDContours.h"
+#endif
+#ifdef BENCH_CEDCONTOURS
+#include "../CEDContours/CEDContours.h"
+void InitColorEDLib();
+#endif
+
+///-------------------------------------------------------------------------------
+/// An image of the corpus in the forms the detectors take
+///
+struct BenchImage {
+  const char *filename;
+  int width, height;
+  unsigned char *gray;          // Gray image (the red plane of a PPM image)
+  unsigned char *red, *green, *blue;
+  unsigned char *edgeImg;       // Binary 0/255 edge map for PEL: the image itself if it is binary, else its Canny edge map
+  bool isColor;
+};
+
+static int numThreads = 1;
+static int linkThreads = 1;
+
+///-------------------------------------------------------------------------------
+/// The detectors. Each returns the # of segments (lines) it found
+///
+#ifdef BENCH_ED
+static int RunED(BenchImage *img){
+  EdgeMap *map = DetectEdgesByED(img->gray, img->width, img->height, SOBEL_OPERATOR, 36, 8, 1.0, linkThreads);
+  int n = map->noSegments;
+  delete map;
+  return n;
+} //end-RunED
+
+static int RunEDPF(BenchImage *img){
+  EdgeMap *map = DetectEdgesByEDPF(img->gray, img->width, img->height, 1.0, numThreads, linkThreads);
+  int n = map->noSegments;
+  delete map;
+  return n;
+} //end-RunEDPF
+
+static int RunCannySR(BenchImage *img){
+  EdgeMap *map = DetectEdgesByCannySR(img->gray, img->width, img->height, 20, 40, 3, 1.0);
+  int n = map->noSegments;
+  delete map;
+  return n;
+} //end-RunCannySR
+
+static int RunCannySRPF(BenchImage *img){
+  EdgeMap *map = DetectEdgesByCannySRPF(img->gray, img->width, img->height, 3, 1.0);
+  int n = map->noSegments;
+  delete map;
+  return n;
+} //end-RunCannySRPF
+#endif
+
+#ifdef BENCH_PEL
+static int RunPEL(BenchImage *img){
+  EdgeMap *map = PEL(img->edgeImg, img->width, img->height, 10, NULL, numThreads);
+  int n = map->noSegments;
+  delete map;
+  return n;
+} //end-RunPEL
+#endif
+
+#ifdef BENCH_EDLINES
+static int RunEDLines(BenchImage *img){
+  int noLines = 0;
+  PROFILE_STAGE("EDLines");
+  LS *lines = DetectLinesByED(img->gray, img->width, img->height, &noLines);
+  delete[] lines;
+  return noLines;
+} //end-RunEDLines
+
+#define BENCH_BATCH_FRAMES 32
+
+// Lines of the first frame
+static int RunEDLinesBatch(BenchImage *img){
+  static EDLinesPool *pool = NULL;
+  static LSBatch batch;
+  if (pool == NULL) pool = new EDLinesPool(numThreads);
+
+  unsigned char *srcImgs[BENCH_BATCH_FRAMES];
+  int widths[BENCH_BATCH_FRAMES], heights[BENCH_BATCH_FRAMES];
+  for (int i=0; i<BENCH_BATCH_FRAMES; i++){
+    srcImgs[i] = img->gray;
+    widths[i] = img->width;
+    heights[i] = img->height;
+  } //end-for
+
+  PROFILE_STAGE("EDLinesBatch");
+  pool->DetectLines(srcImgs, widths, heights, BENCH_BATCH_FRAMES, &batch);
+  return batch.offsets[1];
+} //end-RunEDLinesBatch
+#endif
+
+#ifdef BENCH_COLORED
+static int RunColorED(BenchImage *img){
+  PROFILE_STAGE("ColorED");
+  EdgeMap *map = ColorED(img->red, img->green, img->blue, img->width, img->height, 20, 4, 1.5);
+  int n = map->noSegments;
+  delete map;
+  return n;
+} //end-RunColorED
+
+static int RunColorEDPF(BenchImage *img){
+  PROFILE_STAGE("ColorEDPF");
+  EdgeMap *map = ColorEDPF(img->red, img->green, img->blue, img->width, img->height, 1.0, numThreads);
+  int n = map->noSegments;
+  delete map;
+  return n;
+} //end-RunColorEDPF
+#endif
+
+#ifdef BENCH_GEDCONTOURS
+static int RunGEDContours(BenchImage *img){
+  PROFILE_STAGE("GEDContours");
+  EdgeMap *map = GEDContours_BW(img->gray, img->width, img->height, 30, 252);
+  int n = map->noSegments;
+  delete map;
+  return n;
+} //end-RunGEDContours
+#endif
+
+#ifdef BENCH_CEDCONTOURS
+static int RunCEDContours(BenchImage *img){
+  PROFILE_STAGE("CEDContours");
+  EdgeMap *map = CEDContours_DiZenzoBW(img->red, img->green, img->blue, img->width, img->height, 32, 200);
+  int n = map->noSegments;
+  delete map;
+  return n;
+} //end-RunCEDContours
+#endif
+
+struct BenchDetector {
+  const char *name;
+  const char *counts;           // What the returned count is
+  int (*run)(BenchImage *img);
+  int framesPerRun;             // Images detected per run (0: 1)
+};
+
+static BenchDetector detectors[] = {
+#ifdef BENCH_ED
+  {"ED", "segments", RunED},
+  {"EDPF", "segments", RunEDPF},
+  {"CannySR", "segments", RunCannySR},
+  {"CannySRPF", "segments", RunCannySRPF},
+#endif
+#ifdef BENCH_PEL
+  {"PEL", "segments", RunPEL},
+#endif
+#ifdef BENCH_EDLINES
+  {"EDLines", "lines", RunEDLines},
+  {"EDLinesBatch", "lines", RunEDLinesBatch, BENCH_BATCH_FRAMES},
+#endif
+#ifdef BENCH_COLORED
+  {"ColorED", "segments", RunColorED},
+  {"ColorEDPF", "segments", RunColorEDPF},
+#endif
+#ifdef BENCH_GEDCONTOURS
+  {"GEDContours", "segments", RunGEDContours},
+#endif
+#ifdef BENCH_CEDCONTOURS
+  {"CEDContours", "segments", RunCEDContours},
+#endif
+  {NULL, NULL, NULL}
+};
+
+///-------------------------------------------------------------------------------
+/// Peak resident memory in KB. On Linux the peak is reset before each detector so that it is its own;
+/// elsewhere it is the peak of the process so far
+///
+static void ResetPeakRSS(){
+  FILE *fp = fopen("/proc/self/clear_refs", "w");
+  if (fp == NULL) return;
+  fputs("5", fp);
+  fclose(fp);
+} //end-ResetPeakRSS
+
+static long PeakRSS(){
+  FILE *fp = fopen("/proc/self/status", "r");
+  if (fp){
+    char line[256];
+    long kb = -1;
+    while (fgets(line, sizeof(line), fp)){
+      if (strncmp(line, "VmHWM:", 6) == 0){kb = atol(line+6); break;}
+    } //end-while
+    fclose(fp);
+    if (kb >= 0) return kb;
+  } //end-if
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+} //end-PeakRSS
+
+///-------------------------------------------------------------------------------
+/// Loads an image & derives the inputs of all detectors from it. Returns false if it can not be read
+///
+static bool LoadBenchImage(const char *filename, PNMImage *file, BenchImage *img){
+  if (file->Read(filename) == false) return false;
+
+  img->filename = filename;
+  img->width = file->width;
+  img->height = file->height;
+  img->isColor = file->noChannels == 3;
+  img->gray = file->planes[0];
+  img->red = file->planes[0];
+  img->green = img->isColor ? file->planes[1] : file->planes[0];
+  img->blue = img->isColor ? file->planes[2] : file->planes[0];
+
+  int n = img->width*img->height;
+  img->edgeImg = new unsigned char[n];
+
+  bool binary = true;
+  for (int i=0; i<n && binary; i++) binary = img->gray[i] == 0 || img->gray[i] == 255;
+
+  if (binary){
+    memcpy(img->edgeImg, img->gray, n);
+
+  } else {
+#ifdef BENCH_ED
+    EDContext ctx(img->width, img->height);
+    ctx.DetectEdgesByCannySR(img->gray, 20, 40, 3, 1.0);
+    memcpy(img->edgeImg, ctx.cannyImg, n);
+#else
+    for (int i=0; i<n; i++) img->edgeImg[i] = img->gray[i] >= 128 ? 255 : 0;
+#endif
+  } //end-else
+
+  return true;
+} //end-LoadBenchImage
+
+static int CompareDoubles(const void *a, const void *b){
+  double x = *(const double *)a, y = *(const double *)b;
+  return x < y ? -1 : (x > y ? 1 : 0);
+} //end-CompareDoubles
+
+// Nearest rank percentile of sorted times
+static double Percentile(double *sorted, int n, double p){
+  int k = (int)(p/100.0*n + 0.999999) - 1;
+  if (k < 0) k = 0;
+  if (k >= n) k = n-1;
+  return sorted[k];
+} //end-Percentile
+
+static void PrintJSONString(FILE *fp, const char *s){
+  fputc('"', fp);
+  for (; *s; s++){
+    if (*s == '"' || *s == '\\') fputc('\\', fp);
+    if ((unsigned char)*s < 0x20) fprintf(fp, "\\u%04x", *s);
+    else fputc(*s, fp);
+  } //end-for
+  fputc('"', fp);
+} //end-PrintJSONString
+
+///-------------------------------------------------------------------------------
+/// Writes the time per run of each stage that ran between the 2 snapshots of the profiler counters
+///
+#define BENCH_MAX_STAGES 128
+
+static void PrintStages(FILE *out, ProfileStageStats *before, int noBefore, ProfileStageStats *after, int noAfter, int repeat){
+  int noPrinted = 0;
+
+  for (int i=0; i<noAfter; i++){
+    long long calls = after[i].calls;
+    double ms = after[i].totalMs;
+    for (int j=0; j<noBefore; j++){
+      if (strcmp(before[j].name, after[i].name) == 0){calls -= before[j].calls; ms -= before[j].totalMs; break;}
+    } //end-for
+    if (calls == 0) continue;
+
+    fprintf(out, "%s\n       {\"stage\": ", noPrinted ? "," : ",\n     \"stages\": [");
+    PrintJSONString(out, after[i].name);
+    fprintf(out, ", \"callsPerRun\": %.2f, \"msPerRun\": %.4f}", (double)calls/repeat, ms/repeat);
+    noPrinted++;
+  } //end-for
+
+  if (noPrinted) fprintf(out, "]");
+} //end-PrintStages
+
+static bool Selected(const char *list, const char *name){
+  if (list == NULL) return true;
+
+  int len = strlen(name);
+  for (const char *p = list; (p = strstr(p, name)) != NULL; p += len){
+    if ((p == list || p[-1] == ',') && (p[len] == 0 || p[len] == ',')) return true;
+  } //end-for
+
+  return false;
+} //end-Selected
+
+int main(int argc, char *argv[]){
+  int warmup = 2;
+  int repeat = 10;
+  const char *only = NULL;
+  const char *outFile = NULL;
+  const char *traceFile = NULL;
+  const char *defaultCorpus[] = {"../EDLines/house.pgm", "../EDLines/chairs.pgm", "../EDLines/cigar.pgm", "../EDLines/pasta.pgm",
+                                 "../EDLines/street.pgm", "../EDLines/zebra.pgm", "../EDLines/BoyAndGirl.pgm", "../PELtext/in.pgm"};
+
+  const char **images = (const char **)malloc(sizeof(char *)*(argc + 8));
+  int noImages = 0;
+
+  for (int i=1; i<argc; i++){
+    if (argv[i][0] == '-' && argv[i][1] && argv[i][2] == 0 && i+1 < argc){
+      switch (argv[i][1]){
+        case 'w': warmup = atoi(argv[++i]); continue;
+        case 'r': repeat = atoi(argv[++i]); continue;
+        case 't': numThreads = atoi(argv[++i]); continue;
+        case 'l': linkThreads = atoi(argv[++i]); continue;
+        case 'd': only = argv[++i]; continue;
+        case 'o': outFile = argv[++i]; continue;
+        case 'p': traceFile = argv[++i]; continue;
+      } //end-switch
+    } //end-if
+
+    if (argv[i][0] == '-'){
+      fprintf(stderr, "Usage: %s [-w warmup] [-r repeat] [-t threads] [-l linkThreads] [-d name,name,...] [-o out.json] [-p trace.json] image ...\n", argv[0]);
+      return 1;
+    } //end-if
+
+    images[noImages++] = argv[i];
+  } //end-for
+
+  if (noImages == 0){
+    for (int i=0; i<8; i++) images[noImages++] = defaultCorpus[i];
+  } //end-if
+
+  if (warmup < 0) warmup = 0;
+  if (repeat < 1) repeat = 1;
+  if (numThreads < 1) numThreads = 1;
+  if (linkThreads < 1) linkThreads = 1;
+
+  FILE *out = stdout;
+  if (outFile && (out = fopen(outFile, "w")) == NULL){
+    fprintf(stderr, "Can not write <%s>\n", outFile);
+    return 1;
+  } //end-if
+
+#if defined(BENCH_COLORED) || defined(BENCH_CEDCONTOURS)
+  // The L*a*b* LUTs are filled before the first timed run
+  InitColorEDLib();
+#endif
+
+  fprintf(out, "{\n  \"compiler\": ");
+  PrintJSONString(out, __VERSION__);
+  fprintf(out, ",\n  \"pointerBits\": %d,\n  \"warmup\": %d,\n  \"repeat\": %d,\n  \"threads\": %d,\n  \"linkThreads\": %d,\n  \"results\": [", (int)sizeof(void *)*8, warmup, repeat, numThreads, linkThreads);
+
+  double *times = new double[repeat];
+  int noResults = 0;
+
+  for (int k=0; k<noImages; k++){
+    PNMImage file;
+    BenchImage img;
+    if (LoadBenchImage(images[k], &file, &img) == false){
+      fprintf(stderr, "Skipping <%s>: not a PGM/PPM image\n", images[k]);
+      continue;
+    } //end-if
+
+    for (int d=0; detectors[d].name; d++){
+      if (Selected(only, detectors[d].name) == false) continue;
+
+      fprintf(stderr, "%s on %s (%dx%d)\n", detectors[d].name, images[k], img.width, img.height);
+
+      ResetPeakRSS();
+
+      int count = 0;
+      for (int i=0; i<warmup; i++) count = detectors[d].run(&img);
+
+      ProfileStageStats before[BENCH_MAX_STAGES], after[BENCH_MAX_STAGES];
+      int noBefore = ProfileGetStages(before, BENCH_MAX_STAGES);
+
+      Timer timer;
+      for (int i=0; i<repeat; i++){
+        timer.Start();
+        count = detectors[d].run(&img);
+        timer.Stop();
+        times[i] = timer.ElapsedTime();
+      } //end-for
+
+      long peakRSS = PeakRSS();
+      int noAfter = ProfileGetStages(after, BENCH_MAX_STAGES);
+
+      double total = 0;
+      for (int i=0; i<repeat; i++) total += times[i];
+      qsort(times, repeat, sizeof(double), CompareDoubles);
+
+      double median = repeat & 1 ? times[repeat/2] : (times[repeat/2-1] + times[repeat/2])/2;
+      int frames = detectors[d].framesPerRun > 0 ? detectors[d].framesPerRun : 1;
+      double mpPerSec = median > 0 ? (frames*img.width*(double)img.height/1e6) / (median/1e3) : 0;
+
+      fprintf(out, "%s\n    {\"detector\": ", noResults ? "," : "");
+      PrintJSONString(out, detectors[d].name);
+      fprintf(out, ", \"image\": ");
+      PrintJSONString(out, images[k]);
+      fprintf(out, ", \"width\": %d, \"height\": %d, \"color\": %s, \"framesPerRun\": %d,\n", img.width, img.height, img.isColor ? "true" : "false", frames);
+      fprintf(out, "     \"minMs\": %.4f, \"medianMs\": %.4f, \"p99Ms\": %.4f, \"meanMs\": %.4f, \"maxMs\": %.4f,\n",
+              times[0], median, Percentile(times, repeat, 99), total/repeat, times[repeat-1]);
+      fprintf(out, "     \"megapixelsPerSec\": %.3f, \"peakRSSKB\": %ld, \"%s\": %d", mpPerSec, peakRSS, detectors[d].counts, count);
+      PrintStages(out, before, noBefore, after, noAfter, repeat);
+      fprintf(out, "}");
+      fflush(out);
+      noResults++;
+    } //end-for
+
+    delete[] img.edgeImg;
+  } //end-for
+
+  fprintf(out, "\n  ]\n}\n");
+  if (out != stdout) fclose(out);
+
+  if (traceFile && ProfileWriteChromeTrace(traceFile) == false){
+    fprintf(stderr, "Can not write <%s>: build with -DPROFILE (make profile) to trace\n", traceFile);
+  } //end-if
+
+  delete[] times;
+  free(images);
+
+  return 0;
+} //end-main
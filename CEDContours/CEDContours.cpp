@@ -0,0 +1,92 @@
+/**************************************************************************************************************
+ * CEDContours: contours of a color image by validating the DiZenzo ED edge segments over the L*a*b* image at
+ * 19 scales & combining the surviving pixels into a soft contour map
+ **************************************************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+
+#include "CEDContours.h"
+#include "EDInternals.h"
+
+#define DIZENZO5x5_SIGMA   4.0     // Scales smoothed above this use the 5x5 DiZenzo operator
+#define VALIDATION_SIGMA   2.4     // Validation smoothing relative to the detection sigma
+
+///-------------------------------------------------------------------------------
+/// Detects the contours by combining the ColorEDV results at multiple scales. Returns a soft contour map
+///
+EdgeMap *CEDContours_DiZenzo(unsigned char *redImg, unsigned char *greenImg, unsigned char *blueImg, int width, int height, int GRADIENT_THRESH){
+  PROFILE_STAGE("CEDContours_DiZenzo");
+
+  static const double sigmas[] = {0.275, 0.5, 0.675, 0.75, 1.0, 1.25, 1.5, 1.75, 2.0, 2.25, 2.5, 2.75, 3.0,
+                                  3.25, 3.5, 3.75, 4.0, 4.25, 4.5, 4.75, -1};
+  int n = width*height;
+
+  unsigned char *grayImg = new unsigned char[n];
+  for (int i=0; i<n; i++) grayImg[i] = (unsigned char)(short)(0.2989*redImg[i] + 0.587*greenImg[i] + 0.114*blueImg[i] + 0.5);
+
+  unsigned char *LImg = new unsigned char[n];
+  unsigned char *aImg = new unsigned char[n];
+  unsigned char *bImg = new unsigned char[n];
+
+  MyRGB2LabFast(redImg, greenImg, blueImg, LImg, aImg, bImg, width, height);
+  StretchHistogram(LImg, LImg, n);
+  StretchHistogram(aImg, aImg, n);
+  StretchHistogram(bImg, bImg, n);
+
+  unsigned char *smoothLImg = new unsigned char[n];
+  unsigned char *smoothAImg = new unsigned char[n];
+  unsigned char *smoothBImg = new unsigned char[n];
+  unsigned char *dirImg = new unsigned char[n];
+  short *gradImg = new short[n];
+  EDContext ctx(width, height);            // Linking memory, shared by the scales
+
+  unsigned char *levels[MAX_DIV_LEVELS];    // Validation counts, shared by the scales
+  memset(levels, 0, sizeof(levels));
+  int noLevels = 0;
+
+  for (int s=0; sigmas[s] >= 0; s++){
+    double sigma = sigmas[s];
+
+    SmoothImage(LImg, smoothLImg, width, height, sigma, NULL, true);
+    SmoothImage(aImg, smoothAImg, width, height, sigma, NULL, true);
+    SmoothImage(bImg, smoothBImg, width, height, sigma, NULL, true);
+
+    if (sigma > DIZENZO5x5_SIGMA) ComputeGradientMapByDiZenzo5x5(smoothLImg, smoothAImg, smoothBImg, gradImg, dirImg, width, height);
+    else                          ComputeGradientMapByDiZenzo(smoothLImg, smoothAImg, smoothBImg, gradImg, dirImg, width, height);
+    EdgeMap *map = DoDetectEdgesByED(&ctx, gradImg, dirImg, GRADIENT_THRESH, 0, false);
+
+    double validationSigma = sigma*VALIDATION_SIGMA;
+    SmoothImage(LImg, smoothLImg, width, height, validationSigma, NULL, true);
+    SmoothImage(aImg, smoothAImg, width, height, validationSigma, NULL, true);
+    SmoothImage(bImg, smoothBImg, width, height, validationSigma, NULL, true);
+
+    noLevels = ValidateEdgeSegmentsMultipleDiv(map, smoothLImg, smoothAImg, smoothBImg, levels, noLevels);
+    delete map;
+  } //end-for
+
+  EdgeMap *map = EDContoursPostprocess(levels, noLevels, grayImg, width, height, 8, 8);
+
+  for (int i=0; i<noLevels; i++) delete[] levels[i];
+
+  delete[] grayImg;
+  delete[] LImg;
+  delete[] aImg;
+  delete[] bImg;
+  delete[] smoothLImg;
+  delete[] smoothAImg;
+  delete[] smoothBImg;
+  delete[] dirImg;
+  delete[] gradImg;
+
+  return map;
+} //end-CEDContours_DiZenzo
+
+///-------------------------------------------------------------------------------
+/// CEDContours_DiZenzo thresholded at cutoffThresh into a binary contour map
+///
+EdgeMap *CEDContours_DiZenzoBW(unsigned char *redImg, unsigned char *greenImg, unsigned char *blueImg, int width, int height, int GRADIENT_THRESH, int cutoffThresh){
+  EdgeMap *map = CEDContours_DiZenzo(redImg, greenImg, blueImg, width, height, GRADIENT_THRESH);
+  EDContoursThreshold(map, cutoffThresh);
+
+  return map;
+} //end-CEDContours_DiZenzoBW
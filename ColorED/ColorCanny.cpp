@@ -0,0 +1,185 @@
+/**************************************************************************************************************
+ * ColorCanny: Canny's edge detector over the DiZenzo gradient of the L*a*b* channels
+ **************************************************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "ColorEDLib.h"
+#include "EDInternals.h"
+
+///-------------------------------------------------------------------------------
+/// DiZenzo gradient in double precision, scaled to [0, 255]. dirImg gets the direction of the edge in degrees [0, 180]
+///
+static void ComputeGradientMapByDiZenzo(unsigned char *ch1Img, unsigned char *ch2Img, unsigned char *ch3Img, double *gradImg, unsigned char *dirImg, int width, int height){
+  memset(gradImg, 0, sizeof(double)*width*height);
+
+  unsigned char *chImgs[3] = {ch1Img, ch2Img, ch3Img};
+  double max = 0;
+
+  for (int i=1; i<height-1; i++){
+    for (int j=1; j<width-1; j++){
+      double gxx = 0, gyy = 0, gxy = 0;
+
+      for (int k=0; k<3; k++){
+        unsigned char *X = chImgs[k];
+
+        // Prewitt. gy runs bottom to top
+        int com1 = X[(i+1)*width+j+1] - X[(i-1)*width+j-1];
+        int com2 = X[(i-1)*width+j+1] - X[(i+1)*width+j-1];
+
+        int gx = com1 + com2 + (X[i*width+j+1] - X[i*width+j-1]);
+        int gy = com2 - com1 - (X[(i+1)*width+j] - X[(i-1)*width+j]);
+
+        gxx += gx*gx;
+        gyy += gy*gy;
+        gxy += gx*gy;
+      } //end-for
+
+      double theta = atan2(2.0*gxy, gxx-gyy)*0.5;
+      double val = 0.5*((gxx+gyy) + (gxx-gyy)*cos(2.0*theta) + 2.0*gxy*sin(2.0*theta));
+      double grad = sqrt(val);
+
+      gradImg[i*width+j] = grad;
+      if (grad > max) max = grad;
+
+      // Direction of the edge, perpendicular to the gradient
+      double t = theta + 1.570795;
+      if (t < 0) t += 3.14159;
+      else if (t > 3.14159) t -= 3.14159;
+
+      dirImg[i*width+j] = (unsigned char)(int)(t/3.14159*180 + 0.5);
+    } //end-for
+  } //end-for
+
+  if (max == 0) return;
+
+  double scale = 255.0/max;
+  for (int i=0; i<width*height; i++) gradImg[i] *= scale;
+} //end-ComputeGradientMapByDiZenzo
+
+///-------------------------------------------------------------------------------
+/// Keeps the weak (128) pixels connected to a strong (255) one & deletes the rest
+///
+static void Hysteresis(unsigned char *edgeImg, int width, int height){
+  int noWeak = 0;
+  for (int i=0; i<width*height; i++) if (edgeImg[i] == 128) noWeak++;
+
+  Pixel *stack = new Pixel[noWeak+1];
+
+  static const int dr[8] = {0, 0, -1, 1, -1, -1, 1, 1};
+  static const int dc[8] = {-1, 1, 0, 0, -1, 1, 1, -1};
+
+  for (int i=1; i<height-1; i++){
+    for (int j=1; j<width-1; j++){
+      if (edgeImg[i*width+j] != 128) continue;
+
+      // Collect the weak pixels connected to this one
+      int top = 0;
+      stack[top].r = i;
+      stack[top].c = j;
+      top++;
+      edgeImg[i*width+j] = 0;
+
+      bool strong = false;
+      for (int idx=0; idx<top; idx++){
+        int r = stack[idx].r;
+        int c = stack[idx].c;
+        if (r <= 0 || r >= height-1 || c <= 0 || c >= width-1) continue;
+
+        for (int k=0; k<8; k++){
+          int p = (r+dr[k])*width + c+dc[k];
+
+          if (edgeImg[p] == 255){
+            strong = true;
+
+          } else if (edgeImg[p] == 128){
+            stack[top].r = r+dr[k];
+            stack[top].c = c+dc[k];
+            top++;
+            edgeImg[p] = 0;
+          } //end-else
+        } //end-for
+      } //end-for
+
+      if (strong){
+        for (int idx=0; idx<top; idx++) edgeImg[stack[idx].r*width+stack[idx].c] = 254;
+      } //end-if
+    } //end-for
+  } //end-for
+
+  for (int i=0; i<width*height; i++) if (edgeImg[i] == 254) edgeImg[i] = 255;
+
+  delete[] stack;
+} //end-Hysteresis
+
+///-------------------------------------------------------------------------------
+/// Returns the edge image: 255 at the edge pixels, 0 elsewhere. The caller deletes it with delete[]
+///
+unsigned char *ColorCanny(unsigned char *redImg, unsigned char *greenImg, unsigned char *blueImg, int width, int height, int lowThresh, int highThresh, double smoothingSigma){
+  PROFILE_STAGE("ColorCanny");
+
+  if (smoothingSigma < 1.0) smoothingSigma = 1.0;
+  if (lowThresh <= 0) lowThresh = 1;
+  if (highThresh < lowThresh) highThresh = lowThresh;
+
+  unsigned char *L = new unsigned char[width*height];
+  unsigned char *a = new unsigned char[width*height];
+  unsigned char *b = new unsigned char[width*height];
+  MyRGB2LabFast(redImg, greenImg, blueImg, L, a, b, width, height);
+
+  unsigned char *smoothL = new unsigned char[width*height];
+  unsigned char *smoothA = new unsigned char[width*height];
+  unsigned char *smoothB = new unsigned char[width*height];
+  double *gradImg = new double[width*height];
+  unsigned char *dirImg = new unsigned char[width*height];
+
+  SmoothImage(L, smoothL, width, height, smoothingSigma, NULL, true);
+  SmoothImage(a, smoothA, width, height, smoothingSigma, NULL, true);
+  SmoothImage(b, smoothB, width, height, smoothingSigma, NULL, true);
+  ComputeGradientMapByDiZenzo(smoothL, smoothA, smoothB, gradImg, dirImg, width, height);
+
+  unsigned char *edgeImg = new unsigned char[width*height];
+  memset(edgeImg, 0, width*height);
+
+  // Non maxima suppression: interpolate the gradient at the 2 neighbors across the edge
+  for (int i=1; i<height-1; i++){
+    for (int j=1; j<width-1; j++){
+      int p = i*width+j;
+      double g = gradImg[p];
+      if (g < lowThresh) continue;
+
+      double theta = dirImg[p]*3.14159/180.0;
+      double s = fabs(sin(theta));
+      double c = fabs(cos(theta));
+
+      double A, B, C, D;
+      if (dirImg[p] > 90){
+        A = gradImg[p-width+1]; B = gradImg[p+1]; C = gradImg[p+width-1]; D = gradImg[p-1];
+      } else {
+        A = gradImg[p-width-1]; B = gradImg[p-1]; C = gradImg[p+width+1]; D = gradImg[p+1];
+      } //end-else
+
+      double n1 = A*c*s + gradImg[p-width]*(1-s)*c + B*s*(1-c) + g*(1-s)*(1-c);
+      if (g <= n1) continue;
+
+      double n2 = C*c*s + gradImg[p+width]*(1-s)*c + D*s*(1-c) + g*(1-s)*(1-c);
+      if (g < n2) continue;
+
+      edgeImg[p] = g < highThresh ? 128 : 255;
+    } //end-for
+  } //end-for
+
+  if (lowThresh < highThresh) Hysteresis(edgeImg, width, height);
+
+  delete[] L;
+  delete[] a;
+  delete[] b;
+  delete[] smoothL;
+  delete[] smoothA;
+  delete[] smoothB;
+  delete[] gradImg;
+  delete[] dirImg;
+
+  return edgeImg;
+} //end-ColorCanny
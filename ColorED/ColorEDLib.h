@@ -10,21 +10,22 @@ void InitColorEDLib();
 /// Detect Edges by Edge Drawing (ED). smoothingSigma must be >= 1.0
 EdgeMap *GrayED(unsigned char *srcImg, int width, int height, GradientOperator op=PREWITT_OPERATOR, int GRADIENT_THRESH=20, int ANCHOR_THRESH=4, double smoothingSigma=1.0);
 
-/// Detect Edges by Edge Drawing (ED) and validate the resulting edge segments. smoothingSigma must be >= 1.0
-EdgeMap *GrayEDV(unsigned char *srcImg, int width, int height, GradientOperator op=PREWITT_OPERATOR, int GRADIENT_THRESH=20, double smoothingSigma=1.0);
+/// Detect Edges by Edge Drawing (ED) and validate the resulting edge segments. smoothingSigma must be >= 1.0.
+/// numThreads threads share the linking & the validation, with the same result for any numThreads
+EdgeMap *GrayEDV(unsigned char *srcImg, int width, int height, GradientOperator op=PREWITT_OPERATOR, int GRADIENT_THRESH=20, double smoothingSigma=1.0, int numThreads=1);
 
 /// Detect Edges by Edge Drawing Parameter Free (EDPF). smoothingSigma must be >= 1.0
-EdgeMap *GrayEDPF(unsigned char *srcImg, int width, int height, double smoothingSigma=1.0);
+EdgeMap *GrayEDPF(unsigned char *srcImg, int width, int height, double smoothingSigma=1.0, int numThreads=1);
 
 ///-------------------------- COLOR ED BELOW ------------------------------------------------
 /// Detect Edges by Edge Drawing (ED) for color images represented by ch1Img, ch2Img and ch3Img. Uses the multi-image gradient method by DiZenzo for gradient computation. smoothingSigma must be >= 1.0
 EdgeMap *ColorED(unsigned char *redImg, unsigned char *greenImg, unsigned char *blueImg, int width, int height, int GRADIENT_THRESH=20, int ANCHOR_THRESH=4, double smoothingSigma=1.5);
 
 /// ColorED with Validation. smoothingSigma must be >= 1.0
-EdgeMap *ColorEDV(unsigned char *redImg, unsigned char *greenImg, unsigned char *blueImg, int width, int height, int GRADIENT_THRESH=20, double smoothingSigma=1.5);
+EdgeMap *ColorEDV(unsigned char *redImg, unsigned char *greenImg, unsigned char *blueImg, int width, int height, int GRADIENT_THRESH=20, double smoothingSigma=1.5, int numThreads=1);
 
 /// ColorEDPF. smoothingSigma must be >= 1.0
-EdgeMap *ColorEDPF(unsigned char *redImg, unsigned char *greenImg, unsigned char *blueImg, int width, int height, double smoothingSigma=1.0);
+EdgeMap *ColorEDPF(unsigned char *redImg, unsigned char *greenImg, unsigned char *blueImg, int width, int height, double smoothingSigma=1.0, int numThreads=1);
 
 ///-------------------------- COLORCANNY BELOW ---------------------------------------------
 unsigned char *ColorCanny(unsigned char *redImg, unsigned char *greenImg, unsigned char *blueImg, int width, int height, int lowThresh, int highThresh, double smoothingSigma);
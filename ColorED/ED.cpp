@@ -0,0 +1,216 @@
+/**************************************************************************************************************
+ * Gray & color Edge Drawing: GrayED, GrayEDV, GrayEDPF, ColorED, ColorEDV & ColorEDPF
+ *
+ * See main.cpp for the disclaimer & the paper to cite.
+ **************************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ColorEDLib.h"
+#include "EDInternals.h"
+
+///-------------------------------------------------------------------------------
+/// Gradient of a smoothed gray image by the given operator
+///
+static void ComputeGradientMap(unsigned char *smoothImg, short *gradImg, unsigned char *dirImg, int width, int height, GradientOperator op, int GRADIENT_THRESH){
+  switch (op){
+    case SOBEL_OPERATOR:   ComputeGradientMapBySobel(smoothImg, gradImg, dirImg, width, height, GRADIENT_THRESH); break;
+    case SCHARR_OPERATOR:  ComputeGradientMapByScharr(smoothImg, gradImg, dirImg, width, height, GRADIENT_THRESH); break;
+    default:               ComputeGradientMapByPrewitt(smoothImg, gradImg, dirImg, width, height, GRADIENT_THRESH); break;
+  } //end-switch
+} //end-ComputeGradientMap
+
+///-------------------------------------------------------------------------------
+/// Detect Edges by Edge Drawing (ED)
+///
+EdgeMap *GrayED(unsigned char *srcImg, int width, int height, GradientOperator op, int GRADIENT_THRESH, int ANCHOR_THRESH, double smoothingSigma){
+  PROFILE_STAGE("GrayED");
+
+  // Check parameters for sanity
+  if (smoothingSigma < 1.0) smoothingSigma = 1.0;
+  if (GRADIENT_THRESH <= 0) GRADIENT_THRESH = 1;
+  if (ANCHOR_THRESH < 0) ANCHOR_THRESH = 0;
+
+  unsigned char *smoothImg = new unsigned char[width*height];
+  unsigned char *dirImg = new unsigned char[width*height];
+  short *gradImg = new short[width*height];
+
+  SmoothImage(srcImg, smoothImg, width, height, smoothingSigma, NULL, true);
+  ComputeGradientMap(smoothImg, gradImg, dirImg, width, height, op, GRADIENT_THRESH);
+
+  EdgeMap *map = DoDetectEdgesByED(gradImg, dirImg, width, height, GRADIENT_THRESH, ANCHOR_THRESH, true);
+
+  delete[] smoothImg;
+  delete[] dirImg;
+  delete[] gradImg;
+
+  FixEdgeSegments(map, 1);
+
+  return map;
+} //end-GrayED
+
+///-------------------------------------------------------------------------------
+/// ED with all anchors, followed by the validation of the edge segments over a lightly smoothed image
+///
+EdgeMap *GrayEDV(unsigned char *srcImg, int width, int height, GradientOperator op, int GRADIENT_THRESH, double smoothingSigma, int numThreads){
+  PROFILE_STAGE("GrayEDV");
+
+  if (smoothingSigma < 1.0) smoothingSigma = 1.0;
+  if (GRADIENT_THRESH <= 0) GRADIENT_THRESH = 1;
+
+  unsigned char *smoothImg = new unsigned char[width*height];
+  unsigned char *dirImg = new unsigned char[width*height];
+  short *gradImg = new short[width*height];
+
+  SmoothImage(srcImg, smoothImg, width, height, smoothingSigma, NULL, true);
+  ComputeGradientMap(smoothImg, gradImg, dirImg, width, height, op, GRADIENT_THRESH);
+
+  EdgeMap *map = DoDetectEdgesByED(gradImg, dirImg, width, height, GRADIENT_THRESH, 0, false, numThreads);
+
+  SmoothImage(srcImg, smoothImg, width, height, smoothingSigma/2.5, NULL, true);
+  ValidateEdgeSegments(map, smoothImg, 2.25, numThreads);
+
+  delete[] smoothImg;
+  delete[] dirImg;
+  delete[] gradImg;
+
+  FixEdgeSegments(map, 1);
+
+  return map;
+} //end-GrayEDV
+
+///-------------------------------------------------------------------------------
+/// Parameter free ED: GrayEDV with the Prewitt operator & the lowest meaningful gradient threshold
+///
+EdgeMap *GrayEDPF(unsigned char *srcImg, int width, int height, double smoothingSigma, int numThreads){
+  PROFILE_STAGE("GrayEDPF");
+
+  if (smoothingSigma < 1.0) smoothingSigma = 1.0;
+
+  const int GRADIENT_THRESH = 16;
+
+  unsigned char *smoothImg = new unsigned char[width*height];
+  unsigned char *dirImg = new unsigned char[width*height];
+  short *gradImg = new short[width*height];
+
+  SmoothImage(srcImg, smoothImg, width, height, smoothingSigma, NULL, true);
+  ComputeGradientMapByPrewitt(smoothImg, gradImg, dirImg, width, height, GRADIENT_THRESH);
+
+  EdgeMap *map = DoDetectEdgesByED(gradImg, dirImg, width, height, GRADIENT_THRESH, 0, false, numThreads);
+
+  SmoothImage(srcImg, smoothImg, width, height, smoothingSigma/2.5, NULL, true);
+  ValidateEdgeSegments(map, smoothImg, 2.25, numThreads);
+
+  delete[] smoothImg;
+  delete[] dirImg;
+  delete[] gradImg;
+
+  FixEdgeSegments(map, 1);
+
+  return map;
+} //end-GrayEDPF
+
+///-------------------------------------------------------------------------------
+/// Working memory of the color detectors: the image in L*a*b* & its smoothed version
+///
+struct ColorImages {
+  int width, height;
+  unsigned char *L, *a, *b;
+  unsigned char *smoothL, *smoothA, *smoothB;
+  unsigned char *dirImg;
+  short *gradImg;
+
+public:
+  // constructor. Converts the image to L*a*b*
+  ColorImages(unsigned char *redImg, unsigned char *greenImg, unsigned char *blueImg, int width, int height){
+    this->width = width;
+    this->height = height;
+
+    L = new unsigned char[width*height];
+    a = new unsigned char[width*height];
+    b = new unsigned char[width*height];
+    MyRGB2LabFast(redImg, greenImg, blueImg, L, a, b, width, height);
+
+    smoothL = new unsigned char[width*height];
+    smoothA = new unsigned char[width*height];
+    smoothB = new unsigned char[width*height];
+    dirImg = new unsigned char[width*height];
+    gradImg = new short[width*height];
+  } //end-ColorImages
+
+  // Destructor
+  ~ColorImages(){
+    delete[] L;
+    delete[] a;
+    delete[] b;
+    delete[] smoothL;
+    delete[] smoothA;
+    delete[] smoothB;
+    delete[] dirImg;
+    delete[] gradImg;
+  } //end-~ColorImages
+
+  void Smooth(double sigma){
+    SmoothImage(L, smoothL, width, height, sigma, NULL, true);
+    SmoothImage(a, smoothA, width, height, sigma, NULL, true);
+    SmoothImage(b, smoothB, width, height, sigma, NULL, true);
+  } //end-Smooth
+};
+
+///-------------------------------------------------------------------------------
+/// Color Edge Drawing: ED over the DiZenzo gradient of the smoothed L*a*b* channels
+///
+EdgeMap *ColorED(unsigned char *redImg, unsigned char *greenImg, unsigned char *blueImg, int width, int height, int GRADIENT_THRESH, int ANCHOR_THRESH, double smoothingSigma){
+  PROFILE_STAGE("ColorED");
+
+  if (smoothingSigma < 1.0) smoothingSigma = 1.0;
+  if (GRADIENT_THRESH <= 0) GRADIENT_THRESH = 1;
+  if (ANCHOR_THRESH < 0) ANCHOR_THRESH = 0;
+
+  ColorImages img(redImg, greenImg, blueImg, width, height);
+
+  img.Smooth(smoothingSigma);
+  ComputeGradientMapByDiZenzo(img.smoothL, img.smoothA, img.smoothB, img.gradImg, img.dirImg, width, height);
+
+  EdgeMap *map = DoDetectEdgesByED(img.gradImg, img.dirImg, width, height, GRADIENT_THRESH, ANCHOR_THRESH, true);
+  FixEdgeSegments(map, 1);
+
+  return map;
+} //end-ColorED
+
+///-------------------------------------------------------------------------------
+/// ColorED with all anchors & the given gradient threshold, validated over the lightly smoothed channels
+///
+static EdgeMap *ColorEDValidated(unsigned char *redImg, unsigned char *greenImg, unsigned char *blueImg, int width, int height, int GRADIENT_THRESH, double smoothingSigma, int numThreads){
+  ColorImages img(redImg, greenImg, blueImg, width, height);
+
+  img.Smooth(smoothingSigma);
+  ComputeGradientMapByDiZenzo(img.smoothL, img.smoothA, img.smoothB, img.gradImg, img.dirImg, width, height);
+
+  EdgeMap *map = DoDetectEdgesByED(img.gradImg, img.dirImg, width, height, GRADIENT_THRESH, 0, false, numThreads);
+
+  img.Smooth(smoothingSigma/2.5);
+  ValidateEdgeSegments(map, img.smoothL, img.smoothA, img.smoothB, 2.25, numThreads);
+
+  FixEdgeSegments(map, 1);
+
+  return map;
+} //end-ColorEDValidated
+
+EdgeMap *ColorEDV(unsigned char *redImg, unsigned char *greenImg, unsigned char *blueImg, int width, int height, int GRADIENT_THRESH, double smoothingSigma, int numThreads){
+  PROFILE_STAGE("ColorEDV");
+
+  if (smoothingSigma < 1.0) smoothingSigma = 1.0;
+  if (GRADIENT_THRESH <= 0) GRADIENT_THRESH = 1;
+
+  return ColorEDValidated(redImg, greenImg, blueImg, width, height, GRADIENT_THRESH, smoothingSigma, numThreads);
+} //end-ColorEDV
+
+EdgeMap *ColorEDPF(unsigned char *redImg, unsigned char *greenImg, unsigned char *blueImg, int width, int height, double smoothingSigma, int numThreads){
+  PROFILE_STAGE("ColorEDPF");
+
+  if (smoothingSigma < 1.0) smoothingSigma = 1.0;
+
+  return ColorEDValidated(redImg, greenImg, blueImg, width, height, 16, smoothingSigma, numThreads);
+} //end-ColorEDPF
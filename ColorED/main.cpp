@@ -30,19 +30,12 @@
 #include "ColorEDLib.h"
 #include "EdgeMap.h"
 #include "Timer.h"
+#include "ImageIO.h"
+#include "Profiler.h"
 
-/// This code needs OpenCV2.1 DLLs to run (for cvSmooth function)
-/// They have been copied to the current directory from OpenCV distribution
-/// cv210.dll & cxcore210.dll
-///
-
-/// Two functions to read/save PGM files
-int ReadImagePGM(char *filename, char **pBuffer, int *pWidth, int *pHeight);
+/// Saves a PGM file. Images are read by PNMImage (ImageIO.h)
 void SaveImagePGM(char *filename, char *buffer, int width, int height);
 
-/// One function to read PPM color image files
-bool ReadImagePPM(char *filename, int *pWidth, int *pHeight, unsigned char **pRedImg, unsigned char **pGreenImg, unsigned char **pBlueImg);
-
 /// One function to save an edgemap to a file
 void SaveEdgeMap(char *filename, EdgeMap *map);
 
@@ -65,7 +58,17 @@ int main(int argc,char*argv[]){
 
   printf("ColorED in.ppm out.pgm gradtresh anchortresh sigma mode\n");
   
-  if (ReadImagePPM(str, &width, &height, &redImg, &greenImg, &blueImg) == false) exit;
+  PNMImage image;
+  if (image.Read(str) == false || image.noChannels != 3){
+    printf("Failed opening <%s>\n", str);
+    return 1;
+  } //end-if
+
+  width = image.width;
+  height = image.height;
+  redImg = image.Red();
+  greenImg = image.Green();
+  blueImg = image.Blue();
 
   timer.Start();
   
@@ -87,120 +90,15 @@ int main(int argc,char*argv[]){
 
   printf("\n");
 
-  delete redImg;
-  delete greenImg;
-  delete blueImg;
+#ifdef PROFILE
+  // Time spent in each stage, also written as a Chrome trace
+  ProfilePrint(stdout);
+  ProfileWriteChromeTrace("trace.json");
+#endif
 
   return 0;
 } //end-main
 
-/******************************************************************************
-* Function: ReadImagePGM
-* Purpose: This function reads in an image in PGM format. The image can be
-* read in from either a file or from standard input. The image is only read
-* from standard input when infilename = NULL. Because the PGM format includes
-* the number of columns and the number of rows in the image, these are read
-* from the file. Memory to store the image is allocated in this function.
-* All comments in the header are discarded in the process of reading the
-* image. Upon failure, this function returns 0, upon sucess it returns 1.
-******************************************************************************/
-int ReadImagePGM(char *filename, char **pBuffer, int *pWidth, int *pHeight){
-   FILE *fp;
-   char buf[71];
-   int width, height;
-
-   if ((fp = fopen(filename, "rb")) == NULL){
-     fprintf(stderr, "Error reading the file %s in ReadImagePGM().\n", filename);
-     return(0);
-   } //end-if
-
-   /***************************************************************************
-   * Verify that the image is in PGM format, read in the number of columns
-   * and rows in the image and scan past all of the header information.
-   ***************************************************************************/
-   fgets(buf, 70, fp);
-   bool P2 = false;
-   bool P5 = false;
-
-   if      (strncmp(buf, "P2", 2) == 0) P2 = true;
-   else if (strncmp(buf, "P5", 2) == 0) P5 = true;
-
-   if (P2 == false && P5 == false){
-      fprintf(stderr, "The file %s is not in PGM format in ", filename);
-      fprintf(stderr, "ReadImagePGM().\n");
-      fclose(fp);
-      return 0;
-   } //end-if
-
-   do {fgets(buf, 70, fp);} while (buf[0] == '#');  /* skip all comment lines */
-   sscanf(buf, "%d %d", &width, &height);
-   fgets(buf, 70, fp);  // Skip max value (255)
-
-   *pWidth = width;
-   *pHeight = height;
-
-   /***************************************************************************
-   * Allocate memory to store the image then read the image from the file.
-   ***************************************************************************/
-   if (((*pBuffer) = (char *) malloc((*pWidth)*(*pHeight))) == NULL){
-      fprintf(stderr, "Memory allocation failure in ReadImagePGM().\n");
-      fclose(fp);
-      return(0);
-   } //end-if  
-
-   if (P2){
-      int index=0;
-      char *p = *pBuffer;
-      int col = 0;
-      int read = 0;
-
-      while (1){
-        int c;
-        if (fscanf(fp, "%d", &c) < 1) break;
-        read++;
-
-        if (col < *pWidth) p[index++] = (unsigned char)c;
-
-        col++;
-        if (col == width) col = 0;
-      } //end-while
-
-      if (read != width*height){
-        fprintf(stderr, "Error reading the image data in ReadImagePGM().\n");
-        fclose(fp);
-        free((*pBuffer));
-        return(0);
-      } //end-if
-
-   } else if (P5){
-      int index=0;
-      char *p = *pBuffer;
-      int col = 0;
-      int read = 0;
-
-      while (1){
-        unsigned char c;
-        if (fread(&c, 1, 1, fp) < 1) break;
-        read++;
-
-        if (col < *pWidth) p[index++] = c;
-
-        col++;
-        if (col == width) col = 0;
-      } //end-while
-
-     if (read != width*height){
-        fprintf(stderr, "Error reading the image data in ReadImagePGM().\n");
-        fclose(fp);
-        free((*pBuffer));
-        return(0);
-     } //end-if
-   } //end-else
-
-   fclose(fp);
-   return 1;
-} //end-ReadPGMImage
-
 ///---------------------------------------------------------------------------------
 /// Save a buffer as a .pgm image
 ///
@@ -219,87 +117,6 @@ void SaveImagePGM(char *filename, char *buffer, int width, int height){
   fclose( fp );
 } //end-SaveImagePGM
 
-///-------------------------------------------------------------------------------------------------------------------------------------
-/// Reads a PPM image. Returns true if the image is successfully read, false otherwise
-///
-bool ReadImagePPM(char *filename, int *pWidth, int *pHeight, unsigned char **pRedImg, unsigned char **pGreenImg, unsigned char **pBlueImg){
-  FILE *fp = fopen(filename, "rb");
-  if (fp == NULL) return false;
-
-  char line[101];
-  unsigned char *redImg = NULL;
-  unsigned char *greenImg = NULL;
-  unsigned char *blueImg = NULL;
-
-  // Read the encoding
-  bool binaryEncoding = false;
-  fgets(line, 100, fp);
-  if (strncmp(line, "P6", 2) == 0) binaryEncoding = true;
-
-  // Read the width & height of the image
-  int width = 0, height = 0;
-
-  fgets(line, 100, fp);
-  if (line[0] == '#') fgets(line, 100, fp);  // Skip the comment line if it exists
-  sscanf(line, "%d %d", &width, &height);
-  if (width == 0 || height == 0) goto PPMError;
-
-  // Read and skip the next line
-  fgets(line, 100, fp);
-
-  // Allocate buffer for the images & read them
-  redImg = new unsigned char[width*height];
-  greenImg = new unsigned char[width*height];
-  blueImg = new unsigned char[width*height];
-
-  if (binaryEncoding){
-    for (int i=0; i<width*height; i++){
-      unsigned char c;
-
-      if (fread(&c, 1, 1, fp) != 1) goto PPMError;
-      redImg[i] = c;
-
-      if (fread(&c, 1, 1, fp) != 1) goto PPMError;
-      greenImg[i] = c;
-
-      if (fread(&c, 1, 1, fp) != 1) goto PPMError;
-      blueImg[i] = c;
-    } //end-for
-
-  } else {
-    for (int i=0; i<width*height; i++){
-      int c;
-
-      if (fscanf(fp, "%d", &c) != 1) goto PPMError;
-      redImg[i] = (unsigned char)c;
-
-      if (fscanf(fp, "%d", &c) != 1) goto PPMError;
-      greenImg[i] = (unsigned char)c;
-
-      if (fscanf(fp, "%d", &c) != 1) goto PPMError;
-      blueImg[i] = (unsigned char)c;
-    } //end-for
-  } //end-else
-
-  fclose(fp);
-
-  *pWidth = width;
-  *pHeight = height;
-  *pRedImg = redImg;
-  *pGreenImg = greenImg;
-  *pBlueImg = blueImg;
-
-  return true;
-
-PPMError:
-  fclose(fp);
-  if (redImg) delete redImg;
-  if (greenImg)delete greenImg;
-  if (blueImg) delete blueImg;
-
-  return false;
-} //end-ReadImagePPM
-
 ///--------------------------------------------------------------
 /// Save the edge segments to a file
 ///
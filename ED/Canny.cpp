@@ -0,0 +1,178 @@
+/**************************************************************************************************************
+ * Canny edge detector
+ *
+ * Reproduces OpenCV 2.4's cvCanny with the L1 gradient, so that CannySR finds the same anchors it was tuned with.
+ **************************************************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+
+#include "EDLib.h"
+#include "EDInternals.h"
+
+///-------------------------------------------------------------------------------
+/// Separable Sobel derivative along x (dx=1) or y (dx=0) with replicated borders, saturated to shorts
+///
+static void Sobel(unsigned char *srcImg, short *dstImg, int width, int height, int dx, int apertureSize, int *tmpImg){
+  static const int smooth[3][7] = {{1, 2, 1}, {1, 4, 6, 4, 1}, {1, 6, 15, 20, 15, 6, 1}};
+  static const int deriv[3][7] = {{-1, 0, 1}, {-1, -2, 0, 2, 1}, {-1, -4, -5, 0, 5, 4, 1}};
+
+  int radius = apertureSize/2;
+  const int *kx = dx ? deriv[radius-1] : smooth[radius-1];
+  const int *ky = dx ? smooth[radius-1] : deriv[radius-1];
+
+  // Horizontal pass
+  for (int i=0; i<height; i++){
+    for (int j=0; j<width; j++){
+      int sum = 0;
+      for (int k=0; k<apertureSize; k++){
+        int c = j-radius+k;
+        if (c < 0) c = 0;
+        else if (c >= width) c = width-1;
+        sum += kx[k]*srcImg[i*width+c];
+      } //end-for
+
+      tmpImg[i*width+j] = sum;
+    } //end-for
+  } //end-for
+
+  // Vertical pass
+  for (int i=0; i<height; i++){
+    for (int j=0; j<width; j++){
+      int sum = 0;
+      for (int k=0; k<apertureSize; k++){
+        int r = i-radius+k;
+        if (r < 0) r = 0;
+        else if (r >= height) r = height-1;
+        sum += ky[k]*tmpImg[r*width+j];
+      } //end-for
+
+      dstImg[i*width+j] = sum < -32768 ? -32768 : (sum > 32767 ? 32767 : sum);
+    } //end-for
+  } //end-for
+} //end-Sobel
+
+///-------------------------------------------------------------------------------
+/// Canny: Sobel gradient, non-maxima suppression & hysteresis thresholding
+///
+void CannyEdgeMap(EDContext *ctx, unsigned char *srcImg, unsigned char *edgeImg, int lowThresh, int highThresh, int apertureSize){
+  PROFILE_STAGE("CannyEdgeMap");
+
+  int width = ctx->width;
+  int height = ctx->height;
+
+  if (lowThresh > highThresh){int t = lowThresh; lowThresh = highThresh; highThresh = t;}
+
+  short *dx = ctx->dx;
+  short *dy = ctx->dy;
+  int *tmpImg = ctx->ReserveTmp(width*height);
+  Sobel(srcImg, dx, width, height, 1, apertureSize, tmpImg);
+  Sobel(srcImg, dy, width, height, 0, apertureSize, tmpImg);
+
+  // The map has a 1 pixel border. Values:
+  //   0 - the pixel might belong to an edge
+  //   1 - the pixel can not belong to an edge
+  //   2 - the pixel does belong to an edge
+  int mapstep = width+2;
+  unsigned char *map = ctx->cannyMap;
+  memset(map, 1, mapstep);
+  memset(map + mapstep*(height+1), 1, mapstep);
+
+  // Ring buffer of 3 rows of magnitudes with a 0 border
+  int *magBuf[3] = {ctx->magBuf, ctx->magBuf + mapstep, ctx->magBuf + 2*mapstep};
+  memset(magBuf[0], 0, sizeof(int)*mapstep);
+
+  int *stack = ctx->cannyStack;
+  int top = 0;
+
+  const int CANNY_SHIFT = 15;
+  const int TG22 = (int)(0.4142135623730950488016887242097*(1<<CANNY_SHIFT) + 0.5);
+
+  for (int i=0; i<=height; i++){
+    int *mag = magBuf[(i > 0) + 1] + 1;
+
+    if (i < height){
+      mag[-1] = mag[width] = 0;
+      for (int j=0; j<width; j++) mag[j] = abs(dx[i*width+j]) + abs(dy[i*width+j]);
+
+    } else {
+      memset(mag-1, 0, sizeof(int)*mapstep);
+    } //end-else
+
+    // at the very beginning we do not have a complete ring buffer of 3 magnitude rows for non-maxima suppression
+    if (i == 0) continue;
+
+    unsigned char *_map = map + mapstep*i + 1;
+    _map[-1] = _map[width] = 1;
+
+    int *_mag = magBuf[1] + 1;     // the central row
+    int *magUp = magBuf[0] + 1;
+    int *magDown = magBuf[2] + 1;
+    short *_dx = dx + (i-1)*width;
+    short *_dy = dy + (i-1)*width;
+
+    int prevFlag = 0;
+    for (int j=0; j<width; j++){
+      int m = _mag[j];
+
+      if (m > lowThresh){
+        int xs = _dx[j];
+        int ys = _dy[j];
+        int x = abs(xs);
+        int y = abs(ys) << CANNY_SHIFT;
+
+        int tg22x = x*TG22;
+        int tg67x = tg22x + (x << (CANNY_SHIFT+1));
+
+        bool isMax;
+        if (y < tg22x)       isMax = m > _mag[j-1] && m >= _mag[j+1];                  // horizontal gradient
+        else if (y > tg67x)  isMax = m > magUp[j] && m >= magDown[j];                  // vertical gradient
+        else {
+          int s = (xs ^ ys) < 0 ? -1 : 1;                                              // diagonal gradient
+          isMax = m > magUp[j-s] && m > magDown[j+s];
+        } //end-else
+
+        if (isMax){
+          if (m > highThresh && !prevFlag && _map[j-mapstep] != 2){
+            _map[j] = 2;
+            stack[top++] = (int)(_map+j-map);
+            prevFlag = 1;
+
+          } else {
+            _map[j] = 0;
+          } //end-else
+
+          continue;
+        } //end-if
+      } //end-if
+
+      prevFlag = 0;
+      _map[j] = 1;
+    } //end-for
+
+    // scroll the ring buffer
+    int *t = magBuf[0];
+    magBuf[0] = magBuf[1];
+    magBuf[1] = magBuf[2];
+    magBuf[2] = t;
+  } //end-for
+
+  // now track the edges (hysteresis thresholding)
+  const int offsets[8] = {-1, 1, -mapstep-1, -mapstep, -mapstep+1, mapstep-1, mapstep, mapstep+1};
+
+  while (top > 0){
+    int m = stack[--top];
+
+    for (int k=0; k<8; k++){
+      if (map[m+offsets[k]] == 0){
+        map[m+offsets[k]] = 2;
+        stack[top++] = m+offsets[k];
+      } //end-if
+    } //end-for
+  } //end-while
+
+  // the final pass, form the final image
+  for (int i=0; i<height; i++){
+    unsigned char *_map = map + mapstep*(i+1) + 1;
+    for (int j=0; j<width; j++) edgeImg[i*width+j] = (unsigned char)-(_map[j] >> 1);
+  } //end-for
+} //end-CannyEdgeMap
@@ -0,0 +1,228 @@
+/**************************************************************************************************************
+ * Edge Drawing (ED), EDPF, CannySR & CannySRPF
+ *
+ * See main.cpp for the disclaimer & the papers to cite.
+ **************************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "EdgeMap.h"
+#include "EDLib.h"
+#include "EDInternals.h"
+
+///-------------------------------------------------------------------------------
+/// Allocates the images of the ED detectors at the first call of one. A context that only links, as the color
+/// detectors' do, never needs them
+///
+void EDContext::AllocImages(){
+  if (smoothImg) return;
+
+  smoothImg = new unsigned char[width*height];
+  gradImg = new short[width*height];
+  dirImg = new unsigned char[width*height];
+} //end-AllocImages
+
+///-------------------------------------------------------------------------------
+/// Hands the EdgeMap of the last call over to the caller, together with the pool its memory comes from
+///
+EdgeMap *EDContext::DetachEdgeMap(){
+  EdgeMap *detached = map;
+  if (detached) detached->ownsPool = true;
+
+  map = NULL;
+  pool = NULL;
+
+  return detached;
+} //end-DetachEdgeMap
+
+///-------------------------------------------------------------------------------
+/// Empties the EdgeMap for a new frame & carves its edge image out of the pool. Its pixels & segments are carved
+/// by SizeEdgeMap once the anchors are known. Only allocates if the last one was detached or a frame needs more
+/// room than any before it
+///
+EdgeMap *EDContext::ResetEdgeMap(){
+  if (map == NULL){
+    pool = new EdgeMapPool();
+    map = new EdgeMap(width, height, 0, 0, pool);
+
+  } else {
+    pool->Reset();
+    map->edgeImg = (unsigned char *)pool->Alloc(width*height);
+  } //end-else
+
+  memset(map->edgeImg, 0, width*height);
+  map->noSegments = 0;
+
+  return map;
+} //end-ResetEdgeMap
+
+///-------------------------------------------------------------------------------
+/// Detect Edges by Edge Drawing (ED)
+///
+EdgeMap *EDContext::DetectEdgesByED(unsigned char *srcImg, GradientOperator op, int GRADIENT_THRESH, int ANCHOR_THRESH, double smoothingSigma, int linkThreads){
+  PROFILE_STAGE("ED");
+
+  // Check parameters for sanity
+  if (GRADIENT_THRESH < 1) GRADIENT_THRESH = 1;
+  if (ANCHOR_THRESH < 0) ANCHOR_THRESH = 0;
+  if (smoothingSigma < 1.0) smoothingSigma = 1.0;
+
+  // Smooth the image, compute the gradient & edge directions & the anchors in one pass
+  AllocImages();
+  ResetEdgeMap();
+  int noCandidates;
+  int noAnchors = ComputeGradientAndAnchors(this, srcImg, smoothingSigma, op, map->edgeImg, GRADIENT_THRESH, ANCHOR_THRESH, &noCandidates);
+  SizeEdgeMap(map, noCandidates);
+
+  // Link the anchors
+  if (linkThreads > 1) JoinAnchorPointsInTiles(this, gradImg, dirImg, map, noAnchors, GRADIENT_THRESH, MIN_PATH_LEN, linkThreads);
+  else                 JoinAnchorPointsUsingSortedAnchors(this, gradImg, dirImg, map, noAnchors, GRADIENT_THRESH, MIN_PATH_LEN);
+
+  return map;
+} //end-DetectEdgesByED
+
+///-------------------------------------------------------------------------------
+/// Parameter free ED: Detect all edge segments with the Prewitt operator & keep the ones validated by
+/// the Helmholtz principle
+///
+EdgeMap *EDContext::DetectEdgesByEDPF(unsigned char *srcImg, double smoothingSigma, int numThreads, int linkThreads){
+  PROFILE_STAGE("EDPF");
+
+  if (smoothingSigma < 1.0) smoothingSigma = 1.0;
+
+  const int GRADIENT_THRESH = 16;
+  const int ANCHOR_THRESH = 0;
+
+  AllocImages();
+  ResetEdgeMap();
+  int noCandidates;
+  int noAnchors = ComputeGradientAndAnchors(this, srcImg, smoothingSigma, PREWITT_OPERATOR, map->edgeImg, GRADIENT_THRESH, ANCHOR_THRESH, &noCandidates);
+  SizeEdgeMap(map, noCandidates);
+  if (linkThreads > 1) JoinAnchorPointsInTiles(this, gradImg, dirImg, map, noAnchors, GRADIENT_THRESH, MIN_PATH_LEN, linkThreads);
+  else                 JoinAnchorPointsUsingSortedAnchors(this, gradImg, dirImg, map, noAnchors, GRADIENT_THRESH, MIN_PATH_LEN);
+
+  // Validate the edge segments over a lightly smoothed image
+  SmoothImage(srcImg, smoothImg, width, height, smoothingSigma/2.5, ReserveTmp(SmoothScratchSize(width, height, smoothingSigma/2.5)));
+  ValidateEdgeSegments(this, map, smoothImg, 2.25, numThreads);
+
+  return map;
+} //end-DetectEdgesByEDPF
+
+///-------------------------------------------------------------------------------
+/// Use the Canny edge pixels as anchors & link them by smart routing over the Prewitt gradient
+///
+EdgeMap *EDContext::DetectEdgesByCannySR(unsigned char *srcImg, int cannyLowThresh, int cannyHighThresh, int sobelKernelApertureSize, double smoothingSigma){
+  PROFILE_STAGE("CannySR");
+
+  if (sobelKernelApertureSize != 3 && sobelKernelApertureSize != 5 && sobelKernelApertureSize != 7) sobelKernelApertureSize = 3;
+
+  // Canny's working memory
+  AllocImages();
+  if (cannyImg == NULL){
+    dx = new short[width*height];
+    dy = new short[width*height];
+    magBuf = new int[(width+2)*3];
+    cannyMap = new unsigned char[(width+2)*(height+2)];
+    cannyStack = new int[width*height];
+    cannyImg = new unsigned char[width*height];
+  } //end-if
+
+  // Smooth the image & run Canny on it
+  if (smoothingSigma < 1.0) smoothingSigma = 1.0;
+  SmoothImage(srcImg, smoothImg, width, height, smoothingSigma, ReserveTmp(SmoothScratchSize(width, height, smoothingSigma)));
+  CannyEdgeMap(this, smoothImg, cannyImg, cannyLowThresh, cannyHighThresh, sobelKernelApertureSize);
+
+  // Canny edge pixels are the anchors
+  ResetEdgeMap();
+  unsigned char *edgeImg = map->edgeImg;
+  int noAnchors = 0;
+  for (int i=1; i<height-1; i++){
+    ReserveAnchorList(noAnchors+width, noAnchors);
+
+    for (int j=1; j<width-1; j++){
+      if (cannyImg[i*width+j] == 0) continue;
+
+      edgeImg[i*width+j] = ANCHOR_PIXEL;
+      anchorList[noAnchors++] = i*width+j;
+    } //end-for
+  } //end-for
+
+  // Route only in the vicinity of the Canny edges: compute the gradient where the blurred edge map is bright enough.
+  // The walks only step on these pixels & the anchors
+  SmoothImage(cannyImg, cannyImg, width, height, 1.0, ReserveTmp(SmoothScratchSize(width, height, 1.0)));
+  memset(gradImg, 0, sizeof(short)*width*height);
+  int noCandidates = noAnchors;
+
+  for (int i=1; i<height-1; i++){
+    for (int j=1; j<width-1; j++){
+      if (cannyImg[i*width+j] < 32) continue;
+
+      noCandidates++;
+
+      // Prewitt
+      int com1 = smoothImg[(i+1)*width+j+1] - smoothImg[(i-1)*width+j-1];
+      int com2 = smoothImg[(i-1)*width+j+1] - smoothImg[(i+1)*width+j-1];
+
+      int gx = abs(com1 + com2 + (smoothImg[i*width+j+1] - smoothImg[i*width+j-1]));
+      int gy = abs(com1 - com2 + (smoothImg[(i+1)*width+j] - smoothImg[(i-1)*width+j]));
+
+      gradImg[i*width+j] = gx+gy;
+      dirImg[i*width+j] = gx >= gy ? EDGE_VERTICAL : EDGE_HORIZONTAL;
+    } //end-for
+  } //end-for
+
+  // Count the anchors by gradient value for the sort
+  memset(anchorCounts, 0, sizeof(int)*MAX_GRAD_VALUE);
+  for (int k=0; k<noAnchors; k++) anchorCounts[gradImg[anchorList[k]]]++;
+
+  SizeEdgeMap(map, noCandidates);
+  JoinAnchorPointsUsingSortedAnchors(this, gradImg, dirImg, map, noAnchors, 1, MIN_PATH_LEN);
+
+  return map;
+} //end-DetectEdgesByCannySR
+
+///-------------------------------------------------------------------------------
+/// CannySR with low thresholds followed by the Helmholtz principle validation
+///
+EdgeMap *EDContext::DetectEdgesByCannySRPF(unsigned char *srcImg, int sobelKernelApertureSize, double smoothingSigma){
+  PROFILE_STAGE("CannySRPF");
+
+  DetectEdgesByCannySR(srcImg, 20, 20, sobelKernelApertureSize, smoothingSigma);
+
+  SmoothImage(srcImg, smoothImg, width, height, smoothingSigma/2.5, ReserveTmp(SmoothScratchSize(width, height, smoothingSigma/2.5)));
+  ValidateEdgeSegments(this, map, smoothImg, 2.25, 1);
+
+  return map;
+} //end-DetectEdgesByCannySRPF
+
+///===================================== Single shot API =========================================
+/// Each call runs a temporary context & hands its EdgeMap over to the caller
+///
+EdgeMap *DetectEdgesByED(unsigned char *srcImg, int width, int height, GradientOperator op, int GRADIENT_THRESH, int ANCHOR_THRESH, double smoothingSigma, int linkThreads){
+  EDContext ctx(width, height);
+  ctx.DetectEdgesByED(srcImg, op, GRADIENT_THRESH, ANCHOR_THRESH, smoothingSigma, linkThreads);
+
+  return ctx.DetachEdgeMap();
+} //end-DetectEdgesByED
+
+EdgeMap *DetectEdgesByEDPF(unsigned char *srcImg, int width, int height, double smoothingSigma, int numThreads, int linkThreads){
+  EDContext ctx(width, height);
+  ctx.DetectEdgesByEDPF(srcImg, smoothingSigma, numThreads, linkThreads);
+
+  return ctx.DetachEdgeMap();
+} //end-DetectEdgesByEDPF
+
+EdgeMap *DetectEdgesByCannySR(unsigned char *srcImg, int width, int height, int cannyLowThresh, int cannyHighThresh, int sobelKernelApertureSize, double smoothingSigma){
+  EDContext ctx(width, height);
+  ctx.DetectEdgesByCannySR(srcImg, cannyLowThresh, cannyHighThresh, sobelKernelApertureSize, smoothingSigma);
+
+  return ctx.DetachEdgeMap();
+} //end-DetectEdgesByCannySR
+
+EdgeMap *DetectEdgesByCannySRPF(unsigned char *srcImg, int width, int height, int sobelKernelApertureSize, double smoothingSigma){
+  EDContext ctx(width, height);
+  ctx.DetectEdgesByCannySRPF(srcImg, sobelKernelApertureSize, smoothingSigma);
+
+  return ctx.DetachEdgeMap();
+} //end-DetectEdgesByCannySRPF
@@ -2,23 +2,30 @@
 #define _EDLIB_H_
 
 #include "EdgeMap.h"
+#include "EDContext.h"
 
 /// Detect Edges by Edge Drawing (ED). Steps of the algorithm:
 /// (1) Smooth the image with a 5x5 Gaussian kernel with sigma=smoothingSigma
-/// (2) Compute the gradient magnitude and directions using the GradientOperator (can be Prewitt, Sobel, Scharr)
+/// (2) Compute the gradient magnitude and directions using the GradientOperator (can be Prewitt, Sobel, Scharr, LSD)
 /// (3) Compute the anchors using ANCHOR_THRESH
 /// (4) Link the anchors using Edge Drawing's Smart Routing Algorithm to obtain edge segments
 /// (5) Return the edge segments to the user
 /// Note: smoothingSigma must be >= 1.0
-EdgeMap *DetectEdgesByED(unsigned char *srcImg, int width, int height, GradientOperator op, int GRADIENT_THRESH, int ANCHOR_THRESH, double smoothingSigma);
+/// linkThreads > 1 links the anchors of horizontal tiles of the image in parallel (opt-in). The result is the single
+/// threaded one, the same edge segments in the same order, for any linkThreads. It takes more CPU time than the single
+/// threaded linking, so it is only worth it on large images with idle cores. Images of fewer than 128 rows are
+/// linked by a single thread
+EdgeMap *DetectEdgesByED(unsigned char *srcImg, int width, int height, GradientOperator op, int GRADIENT_THRESH, int ANCHOR_THRESH, double smoothingSigma, int linkThreads=1);
 
 /// (1) Use DetectEdgesByED(srcImg, width, height, PREWITT_OPERATOR, 16, 0, smoothingSigma) to ontain ALL edge segments in the image
 /// (2) Validate the edge segments using the Helmholtz principle, returning only the validated edge segments
 /// Note: smoothingSigma must be >= 1.0
-EdgeMap *DetectEdgesByEDPF(unsigned char *srcImg, int width, int height, double smoothingSigma);
+/// Note: the validation is shared by numThreads threads & gives the same result for any numThreads. The linking stays
+/// single threaded unless linkThreads > 1, as in DetectEdgesByED
+EdgeMap *DetectEdgesByEDPF(unsigned char *srcImg, int width, int height, double smoothingSigma, int numThreads=1, int linkThreads=1);
 
-/// (1) Smooth srcImg with cvSmooth(srcImg, smoothedImg, 5, 5, smoothingSigma)       [smooth the src image with the gaussian kernel]
-/// (2) Use cvCanny(smoothedImg, cannyLowThresh, cannyHighThresh, sobelApertureSize) [Obtain Canny binary edge map by cvCanny]
+/// (1) Smooth srcImg with a 5x5 Gaussian kernel with sigma=smoothingSigma (SmoothImage, same output as cvSmooth)
+/// (2) Obtain the Canny binary edge map with cannyLowThresh, cannyHighThresh & sobelApertureSize (CannyEdgeMap, same output as cvCanny)
 /// (3) Pick the canny edge map points as anchors and use Smart Routing to link the anchor points and obtain the edge segments
 /// (4) Return the edge segments to the user
 /// Note: smoothingSigma must be >= 1.0
@@ -27,15 +27,20 @@
  ***************************************************/
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "Timer.h"
+#include "ImageIO.h"
+#include "Profiler.h"
 #include "EdgeMap.h"
 #include "EDLib.h"
 
-/// Two functions to read/save PGM files
-int ReadImagePGM(char *filename, char **pBuffer, int *pWidth, int *pHeight);
+/// Saves a PGM file. Images are read by PNMImage (ImageIO.h)
 void SaveImagePGM(char *filename, char *buffer, int width, int height);
 
+/// Are the edge maps & the edge segments of a & b the same, pixel for pixel & in the same order?
+bool SameEdgeMaps(EdgeMap *a, EdgeMap *b);
+
 int main(int argc,char*argv[]){
   // Here is the test code
   int width, height;
@@ -55,12 +60,18 @@ int main(int argc,char*argv[]){
   printf("mode 1: EDPF\n");
   printf("mode 2: CannySR\n");
   printf("mode 3: CannySRPF\n");
+  printf("mode 4: check that ED & EDPF give the same result with 2, 3, 4 & 8 threads as with 1\n");
   
-  if (ReadImagePGM(str, (char **)&srcImg, &width, &height) == 0){
+  PNMImage image;
+  if (image.Read(str) == false || image.noChannels != 1){
     printf("Failed opening <%s>\n", str);
     return 1;
   } //end-if
 
+  width = image.width;
+  height = image.height;
+  srcImg = image.Gray();
+
   printf("Working on %dx%d image\n", width, height);
 
   //-------------------------------- ED Test ------------------------------------
@@ -137,116 +148,36 @@ int main(int argc,char*argv[]){
   SaveImagePGM(argv[2], (char *)map->edgeImg, width, height);
   delete map; 
   }
-  delete srcImg;
-  return 0;
-} //end-main
-
-/******************************************************************************
-* Function: ReadImagePGM
-* Purpose: This function reads in an image in PGM format. The image can be
-* read in from either a file or from standard input. The image is only read
-* from standard input when infilename = NULL. Because the PGM format includes
-* the number of columns and the number of rows in the image, these are read
-* from the file. Memory to store the image is allocated in this function.
-* All comments in the header are discarded in the process of reading the
-* image. Upon failure, this function returns 0, upon sucess it returns 1.
-******************************************************************************/
-int ReadImagePGM(char *filename, char **pBuffer, int *pWidth, int *pHeight){
-   FILE *fp;
-   char buf[71];
-   int width, height;
-
-   if ((fp = fopen(filename, "rb")) == NULL){
-     fprintf(stderr, "Error reading the file %s in ReadImagePGM().\n", filename);
-     return(0);
-   } //end-if
-
-   /***************************************************************************
-   * Verify that the image is in PGM format, read in the number of columns
-   * and rows in the image and scan past all of the header information.
-   ***************************************************************************/
-   fgets(buf, 70, fp);
-   bool P2 = false;
-   bool P5 = false;
-
-   if      (strncmp(buf, "P2", 2) == 0) P2 = true;
-   else if (strncmp(buf, "P5", 2) == 0) P5 = true;
-
-   if (P2 == false && P5 == false){
-      fprintf(stderr, "The file %s is not in PGM format in ", filename);
-      fprintf(stderr, "ReadImagePGM().\n");
-      fclose(fp);
-      return 0;
-   } //end-if
-
-   do {fgets(buf, 70, fp);} while (buf[0] == '#');  /* skip all comment lines */
-   sscanf(buf, "%d %d", &width, &height);
-   fgets(buf, 70, fp);  // Skip max value (255)
-
-   *pWidth = width;
-   *pHeight = height;
-
-   /***************************************************************************
-   * Allocate memory to store the image then read the image from the file.
-   ***************************************************************************/
-   if (((*pBuffer) = (char *) malloc((*pWidth)*(*pHeight))) == NULL){
-      fprintf(stderr, "Memory allocation failure in ReadImagePGM().\n");
-      fclose(fp);
-      return(0);
-   } //end-if  
-
-   if (P2){
-      int index=0;
-      char *p = *pBuffer;
-      int col = 0;
-      int read = 0;
-
-      while (1){
-        int c;
-        if (fscanf(fp, "%d", &c) < 1) break;
-        read++;
-
-        if (col < *pWidth) p[index++] = (unsigned char)c;
-
-        col++;
-        if (col == width) col = 0;
-      } //end-while
-
-      if (read != width*height){
-        fprintf(stderr, "Error reading the image data in ReadImagePGM().\n");
-        fclose(fp);
-        free((*pBuffer));
-        return(0);
-      } //end-if
-
-   } else if (P5){
-      int index=0;
-      char *p = *pBuffer;
-      int col = 0;
-      int read = 0;
-
-      while (1){
-        unsigned char c;
-        if (fread(&c, 1, 1, fp) < 1) break;
-        read++;
-
-        if (col < *pWidth) p[index++] = c;
-
-        col++;
-        if (col == width) col = 0;
-      } //end-while
+  //-------------------------------- Parallel linking check ------------------------------------
+  if (mode == 4) {
+  int threadCounts[] = {2, 3, 4, 8};
+  EDContext serial(width, height);
+  EDContext parallel(width, height);
+  int noMismatches = 0;
+
+  for (int pf=0; pf<2; pf++){
+    EdgeMap *expected = pf ? serial.DetectEdgesByEDPF(srcImg, sigma) : serial.DetectEdgesByED(srcImg, SOBEL_OPERATOR, gradtresh, anchortresh, sigma);
+
+    for (int k=0; k<4; k++){
+      int numThreads = threadCounts[k];
+      map = pf ? parallel.DetectEdgesByEDPF(srcImg, sigma, numThreads, numThreads) : parallel.DetectEdgesByED(srcImg, SOBEL_OPERATOR, gradtresh, anchortresh, sigma, numThreads);
+
+      bool same = SameEdgeMaps(expected, map);
+      if (!same) noMismatches++;
+      printf("%s with %d threads: <%d> edge segments, %s\n", pf ? "EDPF" : "ED", numThreads, map->noSegments, same ? "same as 1 thread" : "DIFFERENT from 1 thread");
+    } //end-for
+  } //end-for
 
-     if (read != width*height){
-        fprintf(stderr, "Error reading the image data in ReadImagePGM().\n");
-        fclose(fp);
-        free((*pBuffer));
-        return(0);
-     } //end-if
-   } //end-else
+  if (noMismatches > 0) return 1;
+  }
+#ifdef PROFILE
+  // Time spent in each stage, also written as a Chrome trace
+  ProfilePrint(stdout);
+  ProfileWriteChromeTrace("trace.json");
+#endif
 
-   fclose(fp);
-   return 1;
-} //end-ReadPGMImage
+  return 0;
+} //end-main
 
 ///---------------------------------------------------------------------------------
 /// Save a buffer as a .pgm image
@@ -265,3 +196,18 @@ void SaveImagePGM(char *filename, char *buffer, int width, int height){
 
   fclose( fp );
 } //end-SaveImagePGM
+
+///---------------------------------------------------------------------------------
+/// Compares the edge maps & the edge segments of 2 detections of the same image
+///
+bool SameEdgeMaps(EdgeMap *a, EdgeMap *b){
+  if (a->noSegments != b->noSegments) return false;
+  if (memcmp(a->edgeImg, b->edgeImg, a->width*a->height) != 0) return false;
+
+  for (int i=0; i<a->noSegments; i++){
+    if (a->segments[i].noPixels != b->segments[i].noPixels) return false;
+    if (memcmp(a->segments[i].pixels, b->segments[i].pixels, sizeof(Pixel)*a->segments[i].noPixels) != 0) return false;
+  } //end-for
+
+  return true;
+} //end-SameEdgeMaps
@@ -0,0 +1,292 @@
+/**************************************************************************************************************
+ * Edge drawing over a contour image: the "gradient" is the contour strength itself, and the anchors are linked
+ * by walking from pixel to pixel along the ridge of the contour image
+ **************************************************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+
+#include "EDInternals.h"
+
+// Walk directions, clockwise starting at the upper left neighbor
+#define WALK_UP_LEFT     1
+#define WALK_UP          2
+#define WALK_UP_RIGHT    3
+#define WALK_RIGHT       4
+#define WALK_DOWN_RIGHT  5
+#define WALK_DOWN        6
+#define WALK_DOWN_LEFT   7
+#define WALK_LEFT        8
+
+/// A neighbor of the current pixel & the walk direction that leads to it
+struct WalkStep {
+  int dr, dc;
+  int dir;
+};
+
+/// For each walk direction: the 3 neighbors ahead, tried in this order, and the 2 neighbors looked at when none
+/// of the 3 is above the gradient threshold. Index 0 is unused
+static const WalkStep AheadSteps[9][3] = {
+  {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}},
+  {{0, -1, WALK_LEFT}, {-1, 0, WALK_UP}, {-1, -1, WALK_UP_LEFT}},
+  {{-1, 0, WALK_UP}, {-1, -1, WALK_UP_LEFT}, {-1, 1, WALK_UP_RIGHT}},
+  {{-1, 0, WALK_UP}, {0, 1, WALK_RIGHT}, {-1, 1, WALK_UP_RIGHT}},
+  {{0, 1, WALK_RIGHT}, {-1, 1, WALK_UP_RIGHT}, {1, 1, WALK_DOWN_RIGHT}},
+  {{0, 1, WALK_RIGHT}, {1, 0, WALK_DOWN}, {1, 1, WALK_DOWN_RIGHT}},
+  {{1, 0, WALK_DOWN}, {1, 1, WALK_DOWN_RIGHT}, {1, -1, WALK_DOWN_LEFT}},
+  {{1, 0, WALK_DOWN}, {0, -1, WALK_LEFT}, {1, -1, WALK_DOWN_LEFT}},
+  {{0, -1, WALK_LEFT}, {1, -1, WALK_DOWN_LEFT}, {-1, -1, WALK_UP_LEFT}},
+};
+
+static const WalkStep SideSteps[9][2] = {
+  {{0, 0, 0}, {0, 0, 0}},
+  {{-1, 1, WALK_UP_RIGHT}, {1, -1, WALK_DOWN_LEFT}},
+  {{0, -1, WALK_LEFT}, {0, 1, WALK_RIGHT}},
+  {{-1, -1, WALK_UP_LEFT}, {1, 1, WALK_DOWN_RIGHT}},
+  {{-1, 0, WALK_UP}, {1, 0, WALK_DOWN}},
+  {{-1, 1, WALK_UP_RIGHT}, {1, -1, WALK_DOWN_LEFT}},
+  {{0, -1, WALK_LEFT}, {0, 1, WALK_RIGHT}},
+  {{-1, -1, WALK_UP_LEFT}, {1, 1, WALK_DOWN_RIGHT}},
+  {{-1, 0, WALK_UP}, {1, 0, WALK_DOWN}},
+};
+
+/// The 2 neighbors of the current pixel that flank a step in each walk direction. Anchors there are dropped,
+/// as the walk has already covered them
+static const WalkStep FlankSteps[9][2] = {
+  {{0, 0, 0}, {0, 0, 0}},
+  {{-1, 0, 0}, {0, -1, 0}},
+  {{0, -1, 0}, {0, 1, 0}},
+  {{-1, 0, 0}, {0, 1, 0}},
+  {{-1, 0, 0}, {1, 0, 0}},
+  {{1, 0, 0}, {0, 1, 0}},
+  {{0, -1, 0}, {0, 1, 0}},
+  {{1, 0, 0}, {0, -1, 0}},
+  {{-1, 0, 0}, {1, 0, 0}},
+};
+
+///-------------------------------------------------------------------------------
+/// Walks from (r, c) in direction dir, always stepping to the neighbor ahead having the greatest gradient, until
+/// the walk hits an edge pixel, runs out of gradient or reaches the image border. The pixels walked over are
+/// stored in pixels[] & marked as edge pixels. Returns the # of pixels walked over
+///
+static int EDWalk(short *gradImg, EdgeMap *map, int GRADIENT_THRESH, int r, int c, int dir, Pixel *pixels){
+  int width = map->width;
+  int height = map->height;
+  unsigned char *edgeImg = map->edgeImg;
+
+  if (r <= 0 || r >= height-1 || c <= 0 || c >= width-1) return 0;
+  if (dir < WALK_UP_LEFT || dir > WALK_LEFT) dir = WALK_LEFT;
+
+  int count = 0;
+
+  while (1){
+    pixels[count].r = r;
+    pixels[count].c = c;
+    count++;
+
+    edgeImg[r*width+c] = EDGE_PIXEL;
+
+    // Step to the neighbor ahead having the greatest gradient
+    int maxGrad = GRADIENT_THRESH-1;
+    int newDir = -1;
+    int nr = r, nc = c;
+
+    for (int k=0; k<3; k++){
+      const WalkStep &s = AheadSteps[dir][k];
+      int index = (r+s.dr)*width+c+s.dc;
+
+      if (edgeImg[index] == EDGE_PIXEL) return count;
+      if (gradImg[index] > maxGrad){maxGrad = gradImg[index]; newDir = s.dir; nr = r+s.dr; nc = c+s.dc;}
+    } //end-for
+
+    if (newDir < 0){
+      // Nothing ahead: turn to the stronger one of the 2 side neighbors
+      const WalkStep &s1 = SideSteps[dir][0];
+      const WalkStep &s2 = SideSteps[dir][1];
+      int grad1 = gradImg[(r+s1.dr)*width+c+s1.dc];
+      int grad2 = gradImg[(r+s2.dr)*width+c+s2.dc];
+
+      const WalkStep &s = grad1 > grad2 ? s1 : s2;
+      if ((grad1 > grad2 ? grad1 : grad2) <= maxGrad) return count;
+
+      newDir = s.dir; nr = r+s.dr; nc = c+s.dc;
+    } //end-if
+
+    if (edgeImg[nr*width+nc] == EDGE_PIXEL) return count;
+
+    for (int k=0; k<2; k++){
+      const WalkStep &s = FlankSteps[newDir][k];
+      int index = (r+s.dr)*width+c+s.dc;
+      if (edgeImg[index] == ANCHOR_PIXEL) edgeImg[index] = 0;
+    } //end-for
+
+    if (nr <= 0 || nr >= height-1 || nc <= 0 || nc >= width-1) return count;
+
+    r = nr;
+    c = nc;
+    dir = newDir;
+  } //end-while
+} //end-EDWalk
+
+///-------------------------------------------------------------------------------
+/// Starting with the anchor having the greatest gradient value, walk in both directions along the edge & join the
+/// 2 walks into an edge segment
+///
+void JoinAnchorPointsUsingSortedAnchors2(short *gradImg, unsigned char *dirImg, EdgeMap *map, int GRADIENT_THRESH, int minPathLen){
+  PROFILE_STAGE("JoinAnchorPointsUsingSortedAnchors2");
+
+  int width = map->width;
+  int height = map->height;
+  unsigned char *edgeImg = map->edgeImg;
+
+  for (int i=0; i<width*height; i++){
+    if (gradImg[i] < GRADIENT_THRESH) gradImg[i] = 0;
+  } //end-for
+
+  Pixel *pixels = new Pixel[width*height];
+
+  // sort the anchor points by their gradient value in decreasing order
+  int *C = new int[MAX_GRAD_VALUE];
+  int *A = new int[width*height];
+  int noAnchors = SortAnchorsByGradValue(gradImg, edgeImg, width, height, C, A);
+  delete[] C;
+
+  int noSegments = 0;
+  int totalPixels = 0;
+  int dir1 = WALK_LEFT, dir2 = WALK_RIGHT;
+
+  for (int k=noAnchors-1; k>=0; k--){
+    int pixelOffset = A[k];
+
+    int i = pixelOffset/width;
+    int j = pixelOffset % width;
+
+    if (edgeImg[i*width+j] != ANCHOR_PIXEL) continue;
+
+    switch (dirImg[i*width+j]){
+      case 1: dir1 = WALK_UP; dir2 = WALK_DOWN; break;                // vertical ridge
+      case 2: dir1 = WALK_LEFT; dir2 = WALK_RIGHT; break;             // horizontal ridge
+      case 3: dir1 = WALK_UP_RIGHT; dir2 = WALK_DOWN_LEFT; break;     // ridge along the anti-diagonal
+      case 4: dir1 = WALK_UP_LEFT; dir2 = WALK_DOWN_RIGHT; break;     // ridge along the diagonal
+    } //end-switch
+
+    // Both walks start at the anchor
+    int len1 = EDWalk(gradImg, map, GRADIENT_THRESH, i, j, dir1, pixels);
+    int len2 = EDWalk(gradImg, map, GRADIENT_THRESH, i, j, dir2, pixels+len1);
+    int len = len1+len2;
+    if (len <= minPathLen) continue;
+
+    map->ReservePixels(totalPixels+len, totalPixels, noSegments);
+    map->ReserveSegments(noSegments+1, noSegments);
+
+    // The first walk reversed without the anchor, followed by the second walk
+    Pixel *segment = &map->pixels[totalPixels];
+    int noPixels = 0;
+
+    for (int m=len1-1; m>0; m--) segment[noPixels++] = pixels[m];
+    for (int m=len1; m<len; m++) segment[noPixels++] = pixels[m];
+
+    map->segments[noSegments].pixels = segment;
+    map->segments[noSegments].noPixels = noPixels;
+    noSegments++;
+    totalPixels += noPixels;
+  } //end-for
+
+  map->noSegments = noSegments;
+
+  delete[] pixels;
+  delete[] A;
+} //end-JoinAnchorPointsUsingSortedAnchors2
+
+///-------------------------------------------------------------------------------
+/// Edge Drawing over the smoothed contour image srcImg. The direction of a pixel is the direction of its
+/// strongest neighbor pair; an anchor stands out of both neighbors across that direction by ANCHOR_THRESH.
+/// With prevEdgeImg, only the pixels of a previous edge map can be anchors, otherwise the neighbors along the
+/// direction must agree with it
+///
+EdgeMap *DetectContourEdgeMapByED2(unsigned char *srcImg, int width, int height, int GRADIENT_THRESH, int ANCHOR_THRESH, double smoothingSigma, unsigned char *prevEdgeImg){
+  PROFILE_STAGE("DetectContourEdgeMapByED2");
+
+  if (GRADIENT_THRESH < 1) GRADIENT_THRESH = 1;
+  if (ANCHOR_THRESH < 0) ANCHOR_THRESH = 4;
+
+  unsigned char *smoothImg = new unsigned char[width*height];
+  SmoothImage(srcImg, smoothImg, width, height, smoothingSigma, NULL, true);
+
+  short *gradImg = new short[width*height];
+  unsigned char *dirImg = new unsigned char[width*height];
+  memset(gradImg, 0, sizeof(short)*width*height);
+  memset(dirImg, 0, width*height);
+
+  for (int i=1; i<height-1; i++){
+    for (int j=1; j<width-1; j++) gradImg[i*width+j] = smoothImg[i*width+j];
+  } //end-for
+
+  delete[] smoothImg;
+
+  // Direction of the strongest neighbor pair
+  for (int i=1; i<height-1; i++){
+    for (int j=1; j<width-1; j++){
+      int index = i*width+j;
+      int max = gradImg[index-1];
+      int dir = 2;
+
+      if (gradImg[index+1] >= max){max = gradImg[index+1];}
+      if (gradImg[index-width] > max){max = gradImg[index-width]; dir = 1;}
+      if (gradImg[index+width] > max){max = gradImg[index+width]; dir = 1;}
+      if (gradImg[index-width+1] > max){max = gradImg[index-width+1]; dir = 3;}
+      if (gradImg[index+width-1] > max){max = gradImg[index+width-1]; dir = 3;}
+      if (gradImg[index-width-1] > max){max = gradImg[index-width-1]; dir = 4;}
+      if (gradImg[index+width+1] > max){max = gradImg[index+width+1]; dir = 4;}
+
+      dirImg[index] = dir;
+    } //end-for
+  } //end-for
+
+  // The pixels & segments are carved once the pixels the walks may step on are counted
+  EdgeMap *map = new EdgeMap(width, height, 0, 0);
+  unsigned char *edgeImg = map->edgeImg;
+  memset(edgeImg, 0, width*height);
+  int noCandidates = 0;
+
+  for (int i=1; i<height-1; i++){
+    for (int j=1; j<width-1; j++){
+      int index = i*width+j;
+      int grad = gradImg[index];
+      if (grad < GRADIENT_THRESH) continue;
+
+      noCandidates++;
+      if (prevEdgeImg && prevEdgeImg[index] == 0) continue;
+
+      int dir = dirImg[index];
+      bool agree = true;
+      int n1, n2;   // Neighbors across the direction
+
+      if (dir == 2){
+        n1 = index-width; n2 = index+width;
+        if (prevEdgeImg == NULL) agree = dirImg[index-1] == 2 && dirImg[index+1] == 2;
+
+      } else if (dir == 1){
+        n1 = index-1; n2 = index+1;
+        if (prevEdgeImg == NULL) agree = dirImg[index-width] == 1 && dirImg[index+width] == 1;
+
+      } else if (dir == 4){
+        n1 = index-width+1; n2 = index+width-1;
+        if (prevEdgeImg == NULL) agree = dirImg[index-width-1] == 4 && dirImg[index+width+1] == 4;
+
+      } else {
+        n1 = index-width-1; n2 = index+width+1;
+        if (prevEdgeImg == NULL) agree = dirImg[index-width+1] == 3 && dirImg[index+width-1] == 3;
+      } //end-else
+
+      if (agree && grad-gradImg[n1] >= ANCHOR_THRESH && grad-gradImg[n2] >= ANCHOR_THRESH) edgeImg[index] = ANCHOR_PIXEL;
+    } //end-for
+  } //end-for
+
+  SizeEdgeMap(map, noCandidates);
+  JoinAnchorPointsUsingSortedAnchors2(gradImg, dirImg, map, GRADIENT_THRESH, MIN_PATH_LEN);
+
+  delete[] gradImg;
+  delete[] dirImg;
+
+  return map;
+} //end-DetectContourEdgeMapByED2
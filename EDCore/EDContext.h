@@ -0,0 +1,84 @@
+#ifndef _EDCONTEXT_H_
+#define _EDCONTEXT_H_
+
+#include "EdgeMap.h"
+
+struct WalkMemory;
+struct TileLinker;
+struct ThreadPool;
+
+///------------------------------------------------------------------------------------
+/// Working memory of the ED detectors (EDLib.h). Create a context once per image resolution & run
+/// every frame through it: after the first frame, detecting edges does not touch the heap.
+/// EDLib.h's functions are thin wrappers that run a temporary context.
+/// The EdgeMap returned by a context belongs to it & is overwritten by the next call.
+///
+/// The detectors that bring their own gradient maps, e.g., the color ones, only use the linking
+/// memory of a context: its images are allocated at the first call of an ED detector. The rest of
+/// its memory grows with what the frames need, not with the image size.
+///
+struct EDContext {
+public:
+  int width, height;
+
+  // Images of the ED detectors (allocated at the first call of one)
+  unsigned char *smoothImg;   // Smoothed image (ED & EDPF only keep its last 3 rows: they stream the rows into the gradient)
+  short *gradImg;             // Gradient magnitudes
+  unsigned char *dirImg;      // Gradient directions
+
+  // Scratch, grown as needed: the rows of the separable Gaussian, Canny's Sobel & the validation's gradients
+  int *tmpImg;
+  int maxTmp;
+
+  // Smart routing
+  int *anchorCounts;          // MAX_GRAD_VALUE bins to sort the anchors by their gradient value, filled by the anchor extraction
+  int *anchorList;            // Offsets of the anchors in raster order
+  int maxAnchorList;
+  int *anchors;               // Offsets of the sorted anchors
+  int maxAnchors;
+  WalkMemory *walk;           // Chain tree, stack & pixels of the anchor being linked
+  TileLinker *tileLinker;     // Tiles of the parallel linking (allocated at the first call with linkThreads > 1)
+  ThreadPool *threads;        // Threads of the parallel linking & validation (started at the first call with more than 1)
+
+  // Validation
+  double *H;                  // Probability of a gradient value being >= a given value
+  int *minLens;               // Shortest meaningful piece per gradient value
+  int *threadCounts;          // Gradient histograms of the threads but the first (allocated for the most threads asked for)
+  int maxThreads;
+
+  // Canny (allocated at the first call to DetectEdgesByCannySR)
+  short *dx, *dy;             // Sobel derivatives
+  int *magBuf;                // 3 rows of gradient magnitudes
+  unsigned char *cannyMap;    // Non-maxima suppression map with a 1 pixel border
+  int *cannyStack;            // Offsets of the edge pixels whose neighbors are to be traced
+  unsigned char *cannyImg;    // Canny edge map
+
+  EdgeMap *map;               // The edge segments of the last call
+  EdgeMapPool *pool;          // Arena the map is carved from, reset at every call
+
+public:
+  // constructor
+  EDContext(int width, int height);
+
+  // Destructor
+  ~EDContext();
+
+  EdgeMap *DetectEdgesByED(unsigned char *srcImg, GradientOperator op, int GRADIENT_THRESH, int ANCHOR_THRESH, double smoothingSigma, int linkThreads=1);
+  EdgeMap *DetectEdgesByEDPF(unsigned char *srcImg, double smoothingSigma, int numThreads=1, int linkThreads=1);
+  EdgeMap *DetectEdgesByCannySR(unsigned char *srcImg, int cannyLowThresh, int cannyHighThresh, int sobelKernelApertureSize=3, double smoothingSigma=1.0);
+  EdgeMap *DetectEdgesByCannySRPF(unsigned char *srcImg, int sobelKernelApertureSize=3, double smoothingSigma=1.0);
+
+  // Hands the EdgeMap of the last call over to the caller, who must delete it. The next call allocates a new one
+  EdgeMap *DetachEdgeMap();
+
+  // Grow tmpImg to n ints, anchorList to n anchors keeping the first "keep" ones & anchors to n anchors
+  int *ReserveTmp(int n);
+  int *ReserveAnchorList(int n, int keep);
+  int *ReserveAnchors(int n);
+
+private:
+  void AllocImages();
+  EdgeMap *ResetEdgeMap();
+};
+
+#endif
\ No newline at end of file
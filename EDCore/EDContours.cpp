@@ -0,0 +1,399 @@
+/**************************************************************************************************************
+ * Post processing shared by the contour detectors: the per scale validation counts are turned into a soft
+ * contour map whose ridges are linked by ED2, and whose strength is spread & quantized along the links
+ **************************************************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+
+#include "EDInternals.h"
+
+#define BORDER_DEPTH          16    // Depth of the border strip looked at by CleanupContourImage
+#define BORDER_CLEANUP_WIDTH  4     // # of rows/columns of contour zeroed at a dark image border
+#define BORDER_THRESH         72    // Mean gray level up to which the image border is taken as dark
+#define HISTOGRAM_TAIL        0.002 // Fraction of the pixels clipped at each end of the histogram
+
+///-------------------------------------------------------------------------------
+/// One side of the image border: the (count) lines start at first+i*along & run into the image by into.
+/// If the gray level of the pixels before the first contour pixel within BORDER_DEPTH is on the average at
+/// most thresh, the first BORDER_CLEANUP_WIDTH contour pixels along each line are erased
+///
+static void CleanupBorder(unsigned char *contourImg, unsigned char *srcImg, int first, int along, int into, int count, int thresh){
+  int sum = 0, noPixels = 0;
+
+  for (int i=0; i<count; i++){
+    int index = first + i*along;
+    int k = 0, s = 0;
+
+    while (k < BORDER_DEPTH && contourImg[index+k*into] == 0){s += srcImg[index+k*into]; k++;}
+    if (contourImg[index+k*into] == 0) continue;   // No contour near the border on this line
+
+    sum += s;
+    noPixels += k;
+  } //end-for
+
+  if (noPixels == 0 || sum/noPixels > thresh) return;
+
+  for (int i=0; i<count; i++){
+    int index = first + i*along;
+    int k = 0;
+
+    while (k < BORDER_DEPTH && contourImg[index+k*into] == 0) k++;
+    for (int j=0; j<BORDER_CLEANUP_WIDTH; j++) contourImg[index+(k+j)*into] = 0;
+  } //end-for
+} //end-CleanupBorder
+
+///-------------------------------------------------------------------------------
+/// Dark image borders (e.g., a frame or vignetting) produce a contour running parallel to the border. Erase it
+///
+static void CleanupContourImage(unsigned char *contourImg, unsigned char *srcImg, int width, int height, int thresh){
+  CleanupBorder(contourImg, srcImg, 0, 1, width, width, thresh);                        // Top
+  CleanupBorder(contourImg, srcImg, (height-1)*width, 1, -width, width, thresh);        // Bottom
+  CleanupBorder(contourImg, srcImg, 0, width, 1, height, thresh);                       // Left
+  CleanupBorder(contourImg, srcImg, width-1, width, -1, height, thresh);                // Right
+} //end-CleanupContourImage
+
+///-------------------------------------------------------------------------------
+/// Pulls the contour strength of the pixels around the edge segments of the map onto the segments: each contour
+/// pixel within 4 pixels of an edge pixel adds its value to the nearest edge pixel. The part of an edge pixel's
+/// sum above 255 is handed over to the pixels up to N steps along the segment on both sides. Finally, an
+/// isolated spur pixel much stronger than its only neighbor is brought down to it
+///
+static void EDContours_Boost(unsigned char *img, int width, int height, EdgeMap *map, double sigma, int N){
+  int n = width*height;
+  unsigned char *tmp = new unsigned char[n];
+
+  if (sigma > 0){
+    SmoothImage(img, tmp, width, height, sigma, NULL, true);
+    memcpy(img, tmp, n);
+  } //end-if
+
+  // tmp holds the distance to the nearest edge pixel, idx the index of that edge pixel (0 if none yet)
+  memset(tmp, 255, n);
+  int *idx = new int[n];
+  memset(idx, 0, sizeof(int)*n);
+
+  map->ConvertEdgeSegments2EdgeImg();
+  for (int i=0; i<n; i++){
+    if (map->edgeImg[i] == 0) continue;
+    idx[i] = i;
+    tmp[i] = 0;
+  } //end-for
+
+  for (int pass=0; pass<4; pass++){
+    for (int i=1; i<height-1; i++){
+      for (int j=1; j<width-1; j++){
+        int index = i*width+j;
+        if (idx[index] || img[index] == 0) continue;
+
+        int min = tmp[index-width];
+        int nb = index-width;
+
+        if (tmp[index-1] < min){min = tmp[index-1]; nb = index-1;}
+        if (tmp[index+1] < min){min = tmp[index+1]; nb = index+1;}
+        if (tmp[index+width] < min){min = tmp[index+width]; nb = index+width;}
+
+        if (min != pass) continue;
+
+        tmp[index] = pass+1;
+        idx[index] = idx[nb];
+      } //end-for
+    } //end-for
+  } //end-for
+
+  // Sum the contour strength onto the edge pixels. The edge pixel itself is counted twice
+  short *sum = new short[n];
+  memset(sum, 0, sizeof(short)*n);
+
+  for (int i=0; i<n; i++){
+    if (idx[i] == 0) continue;
+
+    if (sum[idx[i]] == 0) sum[idx[i]] = img[idx[i]] + img[i];
+    else                  sum[idx[i]] += img[i];
+  } //end-for
+
+  // Hand the overflow over to the neighbors along the segment
+  for (int i=0; i<map->noSegments; i++){
+    Pixel *pixels = map->segments[i].pixels;
+    int len = map->segments[i].noPixels;
+
+    for (int k=0; k<len; k++){
+      short &s = sum[pixels[k].r*width+pixels[k].c];
+      if (s <= 255) continue;
+
+      int excess = s-255;
+      s = 255;
+
+      for (int d=1; d<=N; d++){
+        bool leftOut = k-d < 0;
+
+        if (!leftOut){
+          short &left = sum[pixels[k-d].r*width+pixels[k-d].c];
+          if (left <= 254){
+            int give = 255-left;
+            if (excess < give) give = excess;
+            left += give;
+            excess -= give;
+            if (excess <= 0) break;
+          } //end-if
+        } //end-if
+
+        if (k+d < len){
+          short &right = sum[pixels[k+d].r*width+pixels[k+d].c];
+          if (right <= 254){
+            int give = 255-right;
+            if (excess < give) give = excess;
+            right += give;
+            excess -= give;
+          } //end-if
+
+        } else if (leftOut) break;
+
+        if (excess <= 0) break;
+      } //end-for
+    } //end-for
+  } //end-for
+
+  for (int i=0; i<n; i++){
+    if (sum[i] == 0) img[i] = 0;
+    else             img[i] = sum[i] > 255 ? 255 : sum[i];
+  } //end-for
+
+  // Spurs: a pixel with a single neighbor, more than twice as strong as it
+  for (int i=1; i<height-1; i++){
+    for (int j=1; j<width-1; j++){
+      int index = i*width+j;
+      if (img[index] == 0) continue;
+
+      int count = 0, nb = 0;
+      if (img[index-width-1]){count++; nb = index-width-1;}
+      if (img[index-width]){count++; nb = index-width;}
+      if (img[index-width+1]){count++; nb = index-width+1;}
+      if (img[index+width-1]){count++; nb = index+width-1;}
+      if (img[index+width]){count++; nb = index+width;}
+      if (img[index+width+1]){count++; nb = index+width+1;}
+      if (img[index-1]){count++; nb = index-1;}
+      if (img[index+1]){count++; nb = index+1;}
+
+      if (count == 1 && img[index] > 2*img[nb]) img[index] = img[nb];
+    } //end-for
+  } //end-for
+
+  delete[] sum;
+  delete[] idx;
+  delete[] tmp;
+} //end-EDContours_Boost
+
+///-------------------------------------------------------------------------------
+/// Along each edge segment, sets the runs of at most maxLen 0 pixels of the BW image to 255
+///
+static void FillHoles(EdgeMap *map, unsigned char *bwImg, int maxLen){
+  int width = map->width;
+
+  for (int i=0; i<width*map->height; i++) bwImg[i] = (bwImg[i] & 0x80) ? 255 : 0;
+
+  for (int i=0; i<map->noSegments; i++){
+    Pixel *pixels = map->segments[i].pixels;
+    int len = map->segments[i].noPixels;
+
+    int j = 0;
+    while (j < len){
+      while (j < len && bwImg[pixels[j].r*width+pixels[j].c] != 0) j++;
+      if (j == len) break;
+
+      int start = j++;
+      while (j < len && bwImg[pixels[j].r*width+pixels[j].c] != 255) j++;
+
+      if (j-start > maxLen) continue;
+      for (int k=start; k<j; k++) bwImg[pixels[k].r*width+pixels[k].c] = 255;
+    } //end-while
+  } //end-for
+} //end-FillHoles
+
+///-------------------------------------------------------------------------------
+/// Along each edge segment, sets the runs of at most maxLen 255 pixels of the BW image to 0
+///
+static void CleanSegments(EdgeMap *map, unsigned char *bwImg, int maxLen){
+  int width = map->width;
+
+  for (int i=0; i<map->noSegments; i++){
+    Pixel *pixels = map->segments[i].pixels;
+    int len = map->segments[i].noPixels;
+
+    int j = 0;
+    while (j < len){
+      while (j < len && bwImg[pixels[j].r*width+pixels[j].c] != 255) j++;
+      if (j == len) break;
+
+      int start = j++;
+      while (j < len && bwImg[pixels[j].r*width+pixels[j].c] != 0) j++;
+
+      if (j-start > maxLen) continue;
+      for (int k=start; k<j; k++) bwImg[pixels[k].r*width+pixels[k].c] = 0;
+    } //end-while
+  } //end-for
+} //end-CleanSegments
+
+///-------------------------------------------------------------------------------
+/// Quantizes the contour image to noLevels levels. Going down the levels, the image thresholded at each level
+/// is made consistent along the edge segments (short gaps filled, short pieces removed) & the pixel values are
+/// moved across the level accordingly
+///
+static void CreateLevels(unsigned char *img, int width, int height, EdgeMap *map, int noLevels){
+  int n = width*height;
+  int step = 256/noLevels;
+
+  for (int i=0; i<n; i++) img[i] = (img[i]/step)*step;
+
+  unsigned char *bwImg = new unsigned char[n];
+
+  for (int level=(255/step)*step; level>=step; level-=step){
+    for (int i=0; i<n; i++) bwImg[i] = img[i] < level ? 0 : 255;
+
+    FillHoles(map, bwImg, 2);
+    CleanSegments(map, bwImg, 5);
+
+    for (int i=0; i<n; i++){
+      if (bwImg[i]){
+        if (img[i] < level) img[i] = level;
+      } else {
+        if (img[i] >= level) img[i] = level-step;
+      } //end-else
+    } //end-for
+  } //end-for
+
+  delete[] bwImg;
+} //end-CreateLevels
+
+///-------------------------------------------------------------------------------
+/// Post processing of the contour detectors. The levels are left to the caller
+///
+EdgeMap *EDContoursPostprocess(unsigned char **levels, int noLevels, unsigned char *srcImg, int width, int height, int GRADIENT_THRESH, int ANCHOR_THRESH){
+  PROFILE_STAGE("EDContoursPostprocess");
+
+  int n = width*height;
+
+  short *sumImg = new short[n];
+  memset(sumImg, 0, sizeof(short)*n);
+
+  for (int k=0; k<noLevels; k++){
+    for (int i=0; i<n; i++) sumImg[i] += levels[k][i];
+  } //end-for
+
+  int max = 0;
+  for (int i=0; i<n; i++) if (sumImg[i] > max) max = sumImg[i];
+
+  unsigned char *contourImg = new unsigned char[n];
+  double scale = 255.0/max;
+  for (int i=0; i<n; i++) contourImg[i] = (unsigned char)(short)(sumImg[i]*scale);
+
+  delete[] sumImg;
+
+  CleanupContourImage(contourImg, srcImg, width, height, BORDER_THRESH);
+
+  // Link the ridges of the contour image, boost the contour along the links & link again, this time from the
+  // first links only
+  EdgeMap *map1 = DetectContourEdgeMapByED2(contourImg, width, height, 4, 4, 0.675, NULL);
+  EDContours_Boost(contourImg, width, height, map1, 0.0, 16);
+  map1->ConvertEdgeSegments2EdgeImg();
+
+  EdgeMap *map = DetectContourEdgeMapByED2(contourImg, width, height, GRADIENT_THRESH, ANCHOR_THRESH, 1.05, map1->edgeImg);
+  delete map1;
+
+  EDContours_Boost(contourImg, width, height, map, 1.0, 8);
+  CreateLevels(contourImg, width, height, map, 64);
+
+  memcpy(map->edgeImg, contourImg, n);
+  delete[] contourImg;
+
+  return map;
+} //end-EDContoursPostprocess
+
+///-------------------------------------------------------------------------------
+/// Splits the edge segments at the pixels erased from the edge map. Pieces of a single pixel are dropped
+///
+static void ExtractNewEdgeSegments(EdgeMap *map){
+  int width = map->width;
+
+  // A piece takes 2 pixels or more & the one after it
+  int maxNewSegments = 0;
+  for (int i=0; i<map->noSegments; i++) maxNewSegments += (map->segments[i].noPixels+1)/3;
+  map->ReserveSegments(map->noSegments+maxNewSegments, map->noSegments);
+
+  EdgeSegment *newSegments = map->segments + map->noSegments;
+  int noNewSegments = 0;
+
+  for (int i=0; i<map->noSegments; i++){
+    Pixel *pixels = map->segments[i].pixels;
+    int len = map->segments[i].noPixels;
+
+    int j = 0;
+    while (j < len){
+      while (j < len && map->edgeImg[pixels[j].r*width+pixels[j].c] == 0) j++;
+
+      int start = j++;
+      while (j < len && map->edgeImg[pixels[j].r*width+pixels[j].c] != 0) j++;
+
+      if (j-start > 1){
+        newSegments[noNewSegments].pixels = pixels+start;
+        newSegments[noNewSegments].noPixels = j-start;
+        noNewSegments++;
+      } //end-if
+
+      j++;
+    } //end-while
+  } //end-for
+
+  for (int i=0; i<noNewSegments; i++) map->segments[i] = newSegments[i];
+  map->noSegments = noNewSegments;
+} //end-ExtractNewEdgeSegments
+
+///-------------------------------------------------------------------------------
+/// Binary contour map out of the soft one. Thresholds above 252 would leave nothing & are clipped
+///
+void EDContoursThreshold(EdgeMap *map, int cutoffThresh){
+  PROFILE_STAGE("EDContoursThreshold");
+
+  if (cutoffThresh > 252) cutoffThresh = 252;
+  if (cutoffThresh <= 0) return;
+
+  for (int i=0; i<map->width*map->height; i++) map->edgeImg[i] = map->edgeImg[i] < cutoffThresh ? 0 : 255;
+
+  ExtractNewEdgeSegments(map);
+} //end-EDContoursThreshold
+
+///-------------------------------------------------------------------------------
+/// Stretches the histogram of srcImg into dstImg, clipping HISTOGRAM_TAIL of the pixels at both ends.
+/// Works in place as well
+///
+void StretchHistogram(unsigned char *srcImg, unsigned char *dstImg, int n){
+  int hist[256];
+  memset(hist, 0, sizeof(hist));
+
+  int min = 255, max = 0;
+  for (int i=0; i<n; i++){
+    int v = srcImg[i];
+    if (v < min) min = v;
+    else if (v > max) max = v;
+    hist[v]++;
+  } //end-for
+
+  double total = (double)hist[max]/n;
+  while (total <= HISTOGRAM_TAIL){max--; total += (double)hist[max]/n;}
+
+  total = (double)hist[min]/n;
+  while (total <= HISTOGRAM_TAIL){min++; total += (double)hist[min]/n;}
+
+  if (max <= min){
+    // Flat image: nothing to stretch
+    if (dstImg != srcImg) memcpy(dstImg, srcImg, n);
+    return;
+  } //end-if
+
+  double scale = 255.0/(max-min);
+  for (int i=0; i<n; i++){
+    int v = srcImg[i];
+    if (v < min)      dstImg[i] = 0;
+    else if (v > max) dstImg[i] = 255;
+    else              dstImg[i] = (unsigned char)(short)((v-min)*scale);
+  } //end-for
+} //end-StretchHistogram
@@ -0,0 +1,264 @@
+#ifndef _ED_INTERNALS_H_
+#define _ED_INTERNALS_H_
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "EdgeMap.h"
+#include "EDContext.h"
+#include "Profiler.h"
+
+#define EDGE_VERTICAL   1
+#define EDGE_HORIZONTAL 2
+
+#define ANCHOR_PIXEL  254
+#define EDGE_PIXEL    255
+
+#define LEFT  1
+#define RIGHT 2
+#define UP    3
+#define DOWN  4
+
+#define MAX_GRAD_VALUE 32768        // Gradient values are stored as shorts
+#define MIN_PATH_LEN   10           // Anchor trees having fewer pixels are not turned into edge segments
+#define MAX_DIV_LEVELS 16           // # of divForTestSegment values tried by ValidateEdgeSegmentsMultipleDiv
+
+/// A pixel waiting on the stack of the smart routing procedure together with the direction to walk
+struct StackNode {
+  int r, c;     // Starting pixel
+  int parent;   // Parent chain (-1 if no parent)
+  int dir;      // Direction where you are supposed to go
+};
+
+/// A run of pixels traversed in one direction. The chains form a binary tree rooted at the anchor
+struct Chain {
+  int dir;              // Direction of the chain
+  int len;              // # of pixels in the chain
+  int parent;           // Parent of this node (-1 if no parent)
+  int children[2];      // Children of this node (-1 if no children)
+  Pixel *pixels;        // Pointer to the beginning of the pixels array
+};
+
+/// Memory of the walks, grown as needed & kept from walk to walk. A walk lists each pixel it steps on once & a turn
+/// pixel once more for each of the 2 chains starting at it, & every chain but the first one starts at a turn
+struct WalkMemory {
+  Chain *chains;              // Chain tree of the anchor being linked
+  int *chainNos;              // Chain #s of a path in the tree: room for as many as chains
+  int maxChains;
+  StackNode *stack;           // Pixels waiting to be walked
+  int maxStack;
+  Pixel *pixels;              // Pixels of the chains
+  int maxPixels;
+
+  WalkMemory();
+  ~WalkMemory();
+};
+
+/// An edge map write of a walk: the pixel at "offset" went from oldValue to newValue
+struct LinkWrite {
+  int offset;
+  unsigned char oldValue, newValue;
+};
+
+/// A walk of the parallel step of the tile linker (see JoinAnchorPointsInTiles). Its edge map writes, pixels &
+/// segments are the ranges of its tile's arrays starting at firstWrite, firstPixel & firstSegment
+struct LinkRecord {
+  int anchor;                 // Index of the walk's anchor in the tile's sorted anchors
+  bool deferred;              // Was the walk about to step out of the tile? Then it left its writes so far but no segments
+  int firstWrite, noWrites;
+  int firstPixel, noPixels;
+  int firstSegment, noSegments;
+};
+
+/// The rows [firstRow, lastRow) linked by one thread & the memory its walks work in. The serial linker is a
+/// single tile covering the whole image
+struct LinkTile {
+  int firstRow, lastRow;
+  int minRow, maxRow;         // Rows the walks may step on: a walk about to step on another row is given up
+  int width;
+  short *gradImg;
+  unsigned char *dirImg;
+  unsigned char *edgeImg;
+  int GRADIENT_THRESH;
+  int minPathLen;
+
+  WalkMemory *walk;
+
+  // Edge segments of the tile
+  Pixel *pixels;
+  int noPixels, maxPixels;
+  EdgeSegment *segments;
+  int noSegments, maxSegments;
+  bool ownsOutput;            // Are pixels & segments the tile's own? Otherwise they are the EdgeMap's. Both grow as needed
+  EdgeMap *map;
+  int pixelBase;              // First pixel of the walk in progress: the walk does not look at the pixels before it
+
+  // Edge map writes of the walks in order, if "writes" is not NULL
+  LinkWrite *writes;
+  int noWrites, maxWrites;
+
+  // Anchors of the tile, sorted by their gradient value: those having value g start at anchors[counts[g]]
+  int *anchors;
+  int noAnchors;
+  int *counts;
+  int firstAnchor;            // Index of anchors[0] among the sorted anchors of all the tiles
+
+  // Walks of the parallel step & where the serial step is at
+  LinkRecord *records;
+  int noRecords, maxRecords;
+  int nextRecord;
+  bool dirty;                 // Has the serial step marked any pixel of the tile dirty?
+};
+
+/// The tiles of the parallel linker & their memory. Created at the first parallel call of an EDContext
+struct TileLinker {
+  int width, height;
+  int noTiles, maxTiles;      // Tiles of the last call & the most tiles the image can be cut into
+  LinkTile *tiles;
+  int *rowTiles;              // Tile of each image row
+  int *counts;                // MAX_GRAD_VALUE bins per tile
+  unsigned char **copies;     // Per tile: its copy of the edge map, of which it uses the rows it reads
+  unsigned char *dirty;       // Pixels that may differ between the edge map & a tile's copy: bit t % 3 for the copy of
+                              // tile t. The tiles reading a row, that of the row & the 2 next to it, have distinct bits
+  unsigned char *scratch;     // A value per pixel
+  unsigned long long *revived; // A bit per sorted anchor: is the anchor to be linked by the serial step although its
+                              // tile's copy has no walk from it?
+  LinkTile serial;            // The whole image, for the walks the serial step links itself
+
+  TileLinker(int width, int height);
+  ~TileLinker();
+};
+
+/// Threads 1..noThreads-1 of a pool. They sleep between the jobs; RunThreads() wakes them up with the next one
+struct ThreadPool {
+  int noThreads;
+  std::thread *threads;
+
+  std::mutex mutex;
+  std::condition_variable start;    // A new job or quit
+  std::condition_variable done;     // The last worker finished the job
+
+  void (*job)(int t, void *arg);
+  void *arg;
+  int noJobThreads;                 // Threads 0..noJobThreads-1 run the current job
+  long long generation;             // # of jobs so far
+  int noRunning;                    // Workers still on the current job
+  bool quit;
+
+  ThreadPool(int noThreads);
+  ~ThreadPool();
+};
+
+/// Gaussian smoothing with OpenCV's cvSmooth semantics: sigma<=0 copies the image, sigma==1.0 uses the
+/// fixed 5x5 kernel, any other sigma a (6*sigma+1)x(6*sigma+1) kernel. Borders are replicated.
+/// With fixed7x7, sigma==1.5 uses the fixed 7x7 kernel, which the color & contour detectors were tuned with.
+/// tmpImg is scratch of SmoothScratchSize() ints (width*height always do); NULL allocates it for the call.
+/// srcImg & smoothImg may be the same buffer
+void SmoothImage(unsigned char *srcImg, unsigned char *smoothImg, int width, int height, double sigma, int *tmpImg, bool fixed7x7=false);
+int SmoothScratchSize(int width, int height, double sigma, bool fixed7x7=false);
+
+/// Same smoothing, row by row: smoothed row i goes to ringImg + (i%ringRows)*width & rowDone(i, arg) is called
+/// as soon as it is there. srcImg & ringImg must not overlap
+typedef void (*SmoothRowCallback)(int row, void *arg);
+void SmoothImageRows(unsigned char *srcImg, unsigned char *ringImg, int ringRows, int width, int height, double sigma, int *tmpImg, SmoothRowCallback rowDone, void *arg);
+
+/// Gradient magnitude |Gx|+|Gy| & direction maps. dirImg is only set where the gradient is >= GRADIENT_THRESH.
+/// The image border is set to GRADIENT_THRESH-1 so that no edge walks out of the image
+void ComputeGradientMapByPrewitt(unsigned char *smoothImg, short *gradImg, unsigned char *dirImg, int width, int height, int GRADIENT_THRESH);
+void ComputeGradientMapBySobel(unsigned char *smoothImg, short *gradImg, unsigned char *dirImg, int width, int height, int GRADIENT_THRESH);
+void ComputeGradientMapByScharr(unsigned char *smoothImg, short *gradImg, unsigned char *dirImg, int width, int height, int GRADIENT_THRESH);
+
+/// Color Prewitt: the per channel Gx & Gy are combined by their root of sum of squares, the gradient is the
+/// magnitude of the combined vector, scaled to [0, 255]
+void ComputeGradientMapByPrewitt(unsigned char *ch1Img, unsigned char *ch2Img, unsigned char *ch3Img, short *gradImg, unsigned char *dirImg, int width, int height);
+
+/// Multi-image gradient of DiZenzo over the 3 channels, scaled to [0, 255]. The border is left 0
+void ComputeGradientMapByDiZenzo(unsigned char *ch1Img, unsigned char *ch2Img, unsigned char *ch3Img, short *gradImg, unsigned char *dirImg, int width, int height);
+void ComputeGradientMapByDiZenzo5x5(unsigned char *ch1Img, unsigned char *ch2Img, unsigned char *ch3Img, short *gradImg, unsigned char *dirImg, int width, int height);
+
+/// The building blocks of the maps above: the border & the inner pixels of row "row" given the rows above & below it
+void SetGradientBorder(short *gradImg, int width, int height, int GRADIENT_THRESH);
+void ComputeGradientRow(const unsigned char *up, const unsigned char *row, const unsigned char *down, short *gradRow, unsigned char *dirRow, int width, int GRADIENT_THRESH, GradientOperator op);
+
+/// ED's first steps in one pass: smooths srcImg, fills ctx->gradImg & ctx->dirImg, marks the local gradient maxima
+/// as ANCHOR_PIXELs in edgeImg, lists their offsets in raster order in ctx->anchorList & counts them by gradient
+/// value in ctx->anchorCounts. Returns the # of anchors & the # of pixels a walk may step on in *noCandidates.
+/// ctx->smoothImg only holds the last 3 smoothed rows afterwards
+int ComputeGradientAndAnchors(EDContext *ctx, unsigned char *srcImg, double sigma, GradientOperator op, unsigned char *edgeImg, int GRADIENT_THRESH, int ANCHOR_THRESH, int *noCandidates);
+
+/// Makes room for n ints in *buf, which has room for *size: grows it geometrically, keeping its first "keep" ints
+void ReserveInts(int **buf, int *size, int n, int keep);
+
+/// Carves the pixels & segments of map out of its pool for the edge segments linked over noCandidates pixels, those
+/// having a gradient of at least GRADIENT_THRESH, instead of room for width*height of each
+void SizeEdgeMap(EdgeMap *map, int noCandidates);
+
+/// Smart routing: links the noAnchors anchors of ctx->anchorList into edge segments over gradImg & dirImg, starting
+/// with the anchor having the greatest gradient. ctx->anchorCounts must hold the # of anchors having each gradient value
+void JoinAnchorPointsUsingSortedAnchors(EDContext *ctx, short *gradImg, unsigned char *dirImg, EdgeMap *map, int noAnchors, int GRADIENT_THRESH, int minPathLen);
+
+/// The same linking by numThreads threads over horizontal tiles of the image. The result is the serial one, pixel
+/// for pixel & in the same order, for any numThreads
+void JoinAnchorPointsInTiles(EDContext *ctx, short *gradImg, unsigned char *dirImg, EdgeMap *map, int noAnchors, int GRADIENT_THRESH, int minPathLen, int numThreads);
+
+/// Detects the anchors over a gradient map & links them by smart routing into a new EdgeMap. With thinAnchors, all
+/// local maxima are taken as anchors & only those standing out of their neighbors across the edge by ANCHOR_THRESH
+/// are kept. linkThreads threads link the anchors, with the single threaded result. The second one uses a context
+/// of its own
+EdgeMap *DoDetectEdgesByED(EDContext *ctx, short *gradImg, unsigned char *dirImg, int GRADIENT_THRESH, int ANCHOR_THRESH, bool thinAnchors, int linkThreads=1);
+EdgeMap *DoDetectEdgesByED(short *gradImg, unsigned char *dirImg, int width, int height, int GRADIENT_THRESH, int ANCHOR_THRESH, bool thinAnchors, int linkThreads=1);
+
+/// Counting sort of the anchors in edgeImg by their gradient, greatest last. C[] must hold MAX_GRAD_VALUE ints,
+/// A[] width*height ints. Returns the # of anchors
+int SortAnchorsByGradValue(short *gradImg, unsigned char *edgeImg, int width, int height, int *C, int *A);
+
+/// Canny edge detector with cvCanny semantics (L1 gradient, replicated borders). Edge pixels are set to 255
+void CannyEdgeMap(EDContext *ctx, unsigned char *srcImg, unsigned char *edgeImg, int lowThresh, int highThresh, int apertureSize);
+
+/// Keeps the parts of the edge segments that are meaningful by the Helmholtz principle (a contrario validation),
+/// with numThreads threads. The segments' pixels must lie in map->pixels. Overwrites ctx->gradImg, ctx->H,
+/// ctx->minLens, ctx->tmpImg, ctx->anchorCounts & ctx->anchors
+void ValidateEdgeSegments(EDContext *ctx, EdgeMap *map, unsigned char *srcImg, double divForTestSegment, int numThreads);
+
+/// The same validation with memory of its own, over a gray image or over the 3 channels of a color image
+void ValidateEdgeSegments(EdgeMap *map, unsigned char *srcImg, double divForTestSegment, int numThreads=1);
+void ValidateEdgeSegments(EdgeMap *map, unsigned char *ch1Img, unsigned char *ch2Img, unsigned char *ch3Img, double divForTestSegment, int numThreads=1);
+
+/// Validates the edge segments over the 3 channels at MAX_DIV_LEVELS increasingly strict thresholds & counts the
+/// surviving pixels in levels[]. Missing levels are allocated. Returns the new # of levels
+int ValidateEdgeSegmentsMultipleDiv(EdgeMap *map, unsigned char *ch1Img, unsigned char *ch2Img, unsigned char *ch3Img, unsigned char **levels, int noLevels, int numThreads=1);
+
+/// Straightens the 1 pixel (& with maxFix>1, up to maxFix+1 pixel) fluctuations along the edge segments
+void FixEdgeSegments(EdgeMap *map, int maxFix);
+
+/// Runs job(t, arg) for t = 0..numThreads-1 on the pool (t = 0 on the calling thread) & waits for all of them to
+/// finish. numThreads must not be more than pool->noThreads; the pool may be NULL for a single thread
+void RunThreads(ThreadPool *pool, int numThreads, void (*job)(int t, void *arg), void *arg);
+
+/// The threads of ctx, started at the first call & restarted when more than before are asked for
+ThreadPool *ContextThreads(EDContext *ctx, int numThreads);
+
+/// Edge Drawing over a contour image, where the pixel values act as the gradient. With prevEdgeImg, only the
+/// pixels set there can be anchors
+EdgeMap *DetectContourEdgeMapByED2(unsigned char *srcImg, int width, int height, int GRADIENT_THRESH, int ANCHOR_THRESH, double smoothingSigma, unsigned char *prevEdgeImg);
+void JoinAnchorPointsUsingSortedAnchors2(short *gradImg, unsigned char *dirImg, EdgeMap *map, int GRADIENT_THRESH, int minPathLen);
+
+/// Turns the per scale validation counts into the final soft contour map: the counts are summed & stretched to
+/// [0, 255], the texture along the image border is cleaned up (srcImg is the gray image), the ridges are linked by
+/// ED2 twice & the contour strength is spread & quantized along them. Contour detectors share this last step
+EdgeMap *EDContoursPostprocess(unsigned char **levels, int noLevels, unsigned char *srcImg, int width, int height, int GRADIENT_THRESH, int ANCHOR_THRESH);
+
+/// Thresholds map->edgeImg at cutoffThresh & keeps the pieces of the edge segments running over the pixels left
+void EDContoursThreshold(EdgeMap *map, int cutoffThresh);
+
+/// Stretches the histogram of srcImg to [0, 255] into dstImg, clipping 0.2% of the pixels at both ends. srcImg may be dstImg
+void StretchHistogram(unsigned char *srcImg, unsigned char *dstImg, int n);
+
+/// RGB -> CIE L*a*b* through LUTs, each channel stretched to [0, 255]
+void MyRGB2LabFast(unsigned char *redImg, unsigned char *greenImg, unsigned char *blueImg, unsigned char *LImg, unsigned char *aImg, unsigned char *bImg, int width, int height);
+
+/// sRGB (D65) -> CIE L*a*b* by the textbook formulas, each channel stretched to [0, 255]
+void StdRGB2Lab(unsigned char *redImg, unsigned char *greenImg, unsigned char *blueImg, unsigned char *LImg, unsigned char *aImg, unsigned char *bImg, int width, int height);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,133 @@
+/**************************************************************************************************************
+ * Post processing of the edge segments
+ **************************************************************************************************************/
+#include <stdlib.h>
+
+#include "EDInternals.h"
+
+///-------------------------------------------------------------------------------
+/// Straightens a fluctuation of len-1 pixels between 2 pixels that are len pixels apart on the same row or column.
+/// An example one pixel problem getting fixed:
+///  x
+/// x x --> xxx
+///
+/// An example two pixel problem getting fixed (len=3):
+///  xx
+/// x  x --> xxxx
+///
+static void FixEdgeSegment(EdgeSegment *segment, int len){
+  Pixel *pixels = segment->pixels;
+  int noPixels = segment->noPixels;
+
+  int cp = noPixels-len;   // Current pixel index
+  int last = 0;            // Index of the pixel len pixels ahead
+
+  while (last < noPixels){
+    int next = cp+1;       // First pixel in between
+
+    cp = cp % noPixels;    // Roll back to the beginning
+    next = next % noPixels;
+
+    int r = pixels[cp].r;
+    int c = pixels[cp].c;
+
+    int r1 = pixels[next].r;
+    int c1 = pixels[next].c;
+
+    int rl = pixels[last].r;
+    int cl = pixels[last].c;
+
+    if (cl == c && (rl == r-len || rl == r+len)){
+      // Vertical: move the pixels in between onto column c
+      if (c1 != c){
+        for (int k=1; k<len; k++) pixels[(cp+k) % noPixels].c = c;
+      } //end-if
+
+      cp = last;
+      last += len;
+
+    } else if (rl == r && (cl == c-len || cl == c+len)){
+      // Horizontal: move the pixels in between onto row r
+      if (r1 != r){
+        for (int k=1; k<len; k++) pixels[(cp+k) % noPixels].r = r;
+      } //end-if
+
+      cp = last;
+      last += len;
+
+    } else {
+      cp++;
+      last++;
+    } //end-else
+  } //end-while
+} //end-FixEdgeSegment
+
+///-------------------------------------------------------------------------------
+/// The 4 pixel fix. Unlike the shorter ones, it straightens a row whose end 4 pixels to the left is level with
+/// the current pixel, or whose end 5 pixels to the right is
+///
+static void FixEdgeSegment4(EdgeSegment *segment){
+  Pixel *pixels = segment->pixels;
+  int noPixels = segment->noPixels;
+
+  int cp = noPixels-5;
+  int n5 = 0;
+
+  while (n5 < noPixels){
+    int n1 = (cp+1) % noPixels;
+    int n4 = (cp+4) % noPixels;
+    cp = cp % noPixels;
+
+    int r = pixels[cp].r;
+    int c = pixels[cp].c;
+
+    bool fixed = true;
+    if (pixels[n5].c == c && (pixels[n5].r == r-5 || pixels[n5].r == r+5)){
+      if (pixels[n1].c != c){
+        for (int k=1; k<5; k++) pixels[(cp+k) % noPixels].c = c;
+      } //end-if
+
+    } else if (pixels[n4].r == r && pixels[n4].c == c-4){
+      int r4 = pixels[n4].r;
+      if (pixels[n1].r != r4){
+        for (int k=1; k<5; k++) pixels[(cp+k) % noPixels].r = r4;
+      } //end-if
+
+    } else if (pixels[n5].r == r && pixels[n5].c == c+5){
+      int r5 = pixels[n5].r;
+      if (pixels[n1].r != r5){
+        for (int k=1; k<5; k++) pixels[(cp+k) % noPixels].r = r5;
+      } //end-if
+
+    } else {
+      fixed = false;
+    } //end-else
+
+    if (fixed){
+      cp = n5;
+      n5 += 5;
+
+    } else {
+      cp++;
+      n5++;
+    } //end-else
+  } //end-while
+} //end-FixEdgeSegment4
+
+///-------------------------------------------------------------------------------
+/// Fixes the 1 pixel fluctuations of all segments, then the 2 pixel ones etc. up to maxFix pixels (at most 4)
+///
+void FixEdgeSegments(EdgeMap *map, int maxFix){
+  PROFILE_STAGE("FixEdgeSegments");
+
+  for (int i=0; i<map->noSegments; i++) FixEdgeSegment(&map->segments[i], 2);
+  if (maxFix <= 1) return;
+
+  for (int i=0; i<map->noSegments; i++) FixEdgeSegment(&map->segments[i], 3);
+  if (maxFix == 2) return;
+
+  for (int i=0; i<map->noSegments; i++) FixEdgeSegment(&map->segments[i], 4);
+  if (maxFix == 3) return;
+
+  for (int i=0; i<map->noSegments; i++) FixEdgeSegment4(&map->segments[i]);
+} //end-FixEdgeSegments
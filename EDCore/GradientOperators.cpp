@@ -0,0 +1,271 @@
+/**************************************************************************************************************
+ * Gradient operators
+ *
+ * Gradient magnitude is |Gx|+|Gy| for gray images. A pixel whose horizontal derivative dominates lies on a
+ * vertical edge. Color images use the multi-image gradient of DiZenzo over their 3 channels.
+ **************************************************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "EDInternals.h"
+
+///-------------------------------------------------------------------------------
+/// Set the image border to GRADIENT_THRESH-1 so that the edges do not walk out of the image
+///
+void SetGradientBorder(short *gradImg, int width, int height, int GRADIENT_THRESH){
+  for (int j=0; j<width; j++){gradImg[j] = gradImg[(height-1)*width+j] = GRADIENT_THRESH-1;}
+  for (int i=1; i<height-1; i++){gradImg[i*width] = gradImg[(i+1)*width-1] = GRADIENT_THRESH-1;}
+} //end-SetGradientBorder
+
+///-------------------------------------------------------------------------------
+/// 3x3 gradient of the inner pixels of a row with side weight 1 & center weight "center": Prewitt (1),
+/// Sobel (2), Scharr (3 & 10). up & down are the smoothed rows above & below
+///
+static inline void ComputeGradientRow3x3(const unsigned char *up, const unsigned char *row, const unsigned char *down, short *gradRow, unsigned char *dirRow, int width, int GRADIENT_THRESH, int side, int center){
+  for (int j=1; j<width-1; j++){
+    // Compute the gradient in x & y directions
+    int com1 = down[j+1] - up[j-1];
+    int com2 = up[j+1] - down[j-1];
+
+    int gx = abs(side*(com1 + com2) + center*(row[j+1] - row[j-1]));
+    int gy = abs(side*(com1 - com2) + center*(down[j] - up[j]));
+
+    int sum = gx+gy;
+    gradRow[j] = sum;
+
+    if (sum >= GRADIENT_THRESH){
+      if (gx >= gy) dirRow[j] = EDGE_VERTICAL;
+      else          dirRow[j] = EDGE_HORIZONTAL;
+    } //end-if
+  } //end-for
+} //end-ComputeGradientRow3x3
+
+///-------------------------------------------------------------------------------
+/// LSD's 2x2 gradient, used by EDLines. Only the row & the row below it count:
+///   -1 1      -1 -1
+///   -1 1       1  1
+///
+static inline void ComputeGradientRowLSD(const unsigned char *row, const unsigned char *down, short *gradRow, unsigned char *dirRow, int width, int GRADIENT_THRESH){
+  for (int j=1; j<width-1; j++){
+    int com1 = down[j+1] - row[j];
+    int com2 = row[j+1] - down[j];
+
+    int gx = abs(com1 + com2);
+    int gy = abs(com1 - com2);
+
+    int sum = gx+gy;
+    gradRow[j] = sum;
+
+    if (sum >= GRADIENT_THRESH){
+      if (gx >= gy) dirRow[j] = EDGE_VERTICAL;
+      else          dirRow[j] = EDGE_HORIZONTAL;
+    } //end-if
+  } //end-for
+} //end-ComputeGradientRowLSD
+
+///-------------------------------------------------------------------------------
+/// Gradient of one row with the given operator. The constant weights of each case get their own loop
+///
+void ComputeGradientRow(const unsigned char *up, const unsigned char *row, const unsigned char *down, short *gradRow, unsigned char *dirRow, int width, int GRADIENT_THRESH, GradientOperator op){
+  switch (op){
+    case SOBEL_OPERATOR:   ComputeGradientRow3x3(up, row, down, gradRow, dirRow, width, GRADIENT_THRESH, 1, 2); break;
+    case SCHARR_OPERATOR:  ComputeGradientRow3x3(up, row, down, gradRow, dirRow, width, GRADIENT_THRESH, 3, 10); break;
+    case LSD_OPERATOR:     ComputeGradientRowLSD(row, down, gradRow, dirRow, width, GRADIENT_THRESH); break;
+    default:               ComputeGradientRow3x3(up, row, down, gradRow, dirRow, width, GRADIENT_THRESH, 1, 1); break;
+  } //end-switch
+} //end-ComputeGradientRow
+
+///-------------------------------------------------------------------------------
+/// Gradient of the whole image
+///
+static void ComputeGradientMap(unsigned char *smoothImg, short *gradImg, unsigned char *dirImg, int width, int height, int GRADIENT_THRESH, GradientOperator op){
+  SetGradientBorder(gradImg, width, height, GRADIENT_THRESH);
+
+  for (int i=1; i<height-1; i++){
+    ComputeGradientRow(smoothImg+(i-1)*width, smoothImg+i*width, smoothImg+(i+1)*width, gradImg+i*width, dirImg+i*width, width, GRADIENT_THRESH, op);
+  } //end-for
+} //end-ComputeGradientMap
+
+///-------------------------------------------------------------------------------
+/// Prewitt:
+///   -1 0 1      -1 -1 -1
+///   -1 0 1       0  0  0
+///   -1 0 1       1  1  1
+///
+void ComputeGradientMapByPrewitt(unsigned char *smoothImg, short *gradImg, unsigned char *dirImg, int width, int height, int GRADIENT_THRESH){
+  PROFILE_STAGE("ComputeGradientMapByPrewitt");
+  ComputeGradientMap(smoothImg, gradImg, dirImg, width, height, GRADIENT_THRESH, PREWITT_OPERATOR);
+} //end-ComputeGradientMapByPrewitt
+
+///-------------------------------------------------------------------------------
+/// Sobel:
+///   -1 0 1      -1 -2 -1
+///   -2 0 2       0  0  0
+///   -1 0 1       1  2  1
+///
+void ComputeGradientMapBySobel(unsigned char *smoothImg, short *gradImg, unsigned char *dirImg, int width, int height, int GRADIENT_THRESH){
+  PROFILE_STAGE("ComputeGradientMapBySobel");
+  ComputeGradientMap(smoothImg, gradImg, dirImg, width, height, GRADIENT_THRESH, SOBEL_OPERATOR);
+} //end-ComputeGradientMapBySobel
+
+///-------------------------------------------------------------------------------
+/// Scharr:
+///   -3  0  3     -3 -10 -3
+///  -10  0 10      0   0  0
+///   -3  0  3      3  10  3
+///
+void ComputeGradientMapByScharr(unsigned char *smoothImg, short *gradImg, unsigned char *dirImg, int width, int height, int GRADIENT_THRESH){
+  PROFILE_STAGE("ComputeGradientMapByScharr");
+  ComputeGradientMap(smoothImg, gradImg, dirImg, width, height, GRADIENT_THRESH, SCHARR_OPERATOR);
+} //end-ComputeGradientMapByScharr
+
+///-------------------------------------------------------------------------------
+/// DiZenzo: the Prewitt derivatives of the 3 channels make up a 2x2 structure tensor. The gradient is the square
+/// root of its largest eigenvalue, taken along the angle theta that maximizes the rate of change.
+/// The magnitudes are scaled so that the largest is 255
+///
+void ComputeGradientMapByDiZenzo(unsigned char *ch1Img, unsigned char *ch2Img, unsigned char *ch3Img, short *gradImg, unsigned char *dirImg, int width, int height){
+  PROFILE_STAGE("ComputeGradientMapByDiZenzo");
+
+  memset(gradImg, 0, sizeof(short)*width*height);
+
+  unsigned char *channels[3] = {ch1Img, ch2Img, ch3Img};
+  int max = 0;
+
+  for (int i=1; i<height-1; i++){
+    for (int j=1; j<width-1; j++){
+      int gxx = 0, gyy = 0, gxy = 0;
+
+      for (int k=0; k<3; k++){
+        unsigned char *img = channels[k];
+
+        int com1 = img[(i+1)*width+j+1] - img[(i-1)*width+j-1];
+        int com2 = img[(i-1)*width+j+1] - img[(i+1)*width+j-1];
+
+        int gx = com1 + com2 + (img[i*width+j+1] - img[i*width+j-1]);
+        int gy = com1 - com2 + (img[(i+1)*width+j] - img[(i-1)*width+j]);
+
+        gxx += gx*gx;
+        gyy += gy*gy;
+        gxy += gx*gy;
+      } //end-for
+
+      double theta = atan2(2.0*gxy, (double)(gxx-gyy))*0.5;
+      double val = 0.5*((gxx+gyy) + (gxx-gyy)*cos(2*theta) + 2*gxy*sin(2*theta));
+      int grad = (int)(sqrt(val) + 0.5);
+
+      if (theta >= -3.14159/4 && theta <= 3.14159/4) dirImg[i*width+j] = EDGE_VERTICAL;
+      else                                           dirImg[i*width+j] = EDGE_HORIZONTAL;
+
+      gradImg[i*width+j] = grad;
+      if (grad > max) max = grad;
+    } //end-for
+  } //end-for
+
+  // Scale the gradient values to [0, 255]
+  if (max == 0) return;
+
+  for (int i=0; i<width*height; i++) gradImg[i] = gradImg[i]*255/max;
+} //end-ComputeGradientMapByDiZenzo
+
+///-------------------------------------------------------------------------------
+/// DiZenzo over a 5x5 neighborhood: the derivatives weigh the outer columns (rows) twice the inner ones & are
+/// summed over the 5 rows (columns). Used at the large scales, where the 3x3 derivatives are too weak.
+/// As in the original, the x derivative of the 3rd channel keeps its sign
+///
+void ComputeGradientMapByDiZenzo5x5(unsigned char *ch1Img, unsigned char *ch2Img, unsigned char *ch3Img, short *gradImg, unsigned char *dirImg, int width, int height){
+  PROFILE_STAGE("ComputeGradientMapByDiZenzo5x5");
+
+  memset(gradImg, 0, sizeof(short)*width*height);
+
+  unsigned char *channels[3] = {ch1Img, ch2Img, ch3Img};
+  int max = 0;
+
+  for (int i=2; i<height-2; i++){
+    for (int j=2; j<width-2; j++){
+      int gxx = 0, gyy = 0, gxy = 0;
+
+      for (int k=0; k<3; k++){
+        unsigned char *img = channels[k];
+
+        int gx = 0, gy = 0;
+        for (int d=-2; d<=2; d++){
+          gx += 2*(img[(i+d)*width+j+2] - img[(i+d)*width+j-2]) + (img[(i+d)*width+j+1] - img[(i+d)*width+j-1]);
+          gy += 2*(img[(i+2)*width+j+d] - img[(i-2)*width+j+d]) + (img[(i+1)*width+j+d] - img[(i-1)*width+j+d]);
+        } //end-for
+
+        if (k < 2) gx = abs(gx);
+        gy = abs(gy);
+
+        gxx += gx*gx;
+        gyy += gy*gy;
+        gxy += gx*gy;
+      } //end-for
+
+      double theta = atan2(2.0*gxy, (double)(gxx-gyy))*0.5;
+      double val = 0.5*((gxx+gyy) + (gxx-gyy)*cos(2*theta) + 2*gxy*sin(2*theta));
+      int grad = (int)(sqrt(val) + 0.5);
+
+      if (theta >= -3.14159/4 && theta <= 3.14159/4) dirImg[i*width+j] = EDGE_VERTICAL;
+      else                                           dirImg[i*width+j] = EDGE_HORIZONTAL;
+
+      gradImg[i*width+j] = grad;
+      if (grad > max) max = grad;
+    } //end-for
+  } //end-for
+
+  // Scale the gradient values to [0, 255]
+  if (max == 0) return;
+
+  double scale = 255.0/max;
+  for (int i=0; i<width*height; i++) gradImg[i] = (short)(gradImg[i]*scale);
+} //end-ComputeGradientMapByDiZenzo5x5
+
+///-------------------------------------------------------------------------------
+/// Prewitt gradient over the 3 channels: the x & y gradients are the norms of the channels' x & y gradients.
+/// The magnitudes are scaled so that the largest is 255; the border is left 0
+///
+void ComputeGradientMapByPrewitt(unsigned char *ch1Img, unsigned char *ch2Img, unsigned char *ch3Img, short *gradImg, unsigned char *dirImg, int width, int height){
+  PROFILE_STAGE("ComputeGradientMapByPrewitt (color)");
+
+  memset(gradImg, 0, sizeof(short)*width*height);
+
+  unsigned char *channels[3] = {ch1Img, ch2Img, ch3Img};
+  int max = 0;
+
+  for (int i=1; i<height-1; i++){
+    for (int j=1; j<width-1; j++){
+      int gxx = 0, gyy = 0;
+
+      for (int k=0; k<3; k++){
+        unsigned char *img = channels[k];
+
+        int com1 = img[(i+1)*width+j+1] - img[(i-1)*width+j-1];
+        int com2 = img[(i-1)*width+j+1] - img[(i+1)*width+j-1];
+
+        int gx = abs(com1 + com2 + (img[i*width+j+1] - img[i*width+j-1]));
+        int gy = abs(com1 - com2 + (img[(i+1)*width+j] - img[(i-1)*width+j]));
+
+        gxx += gx*gx;
+        gyy += gy*gy;
+      } //end-for
+
+      int gx = (int)(sqrt((double)gxx) + 0.5);
+      int gy = (int)(sqrt((double)gyy) + 0.5);
+      int grad = (int)(sqrt((double)(gx*gx + gy*gy)) + 0.5);
+
+      if (gx > gy) dirImg[i*width+j] = EDGE_VERTICAL;
+      else         dirImg[i*width+j] = EDGE_HORIZONTAL;
+
+      gradImg[i*width+j] = grad;
+      if (grad > max) max = grad;
+    } //end-for
+  } //end-for
+
+  // Scale the gradient values to [0, 255]
+  if (max == 0) return;
+
+  double scale = max/255.0;
+  for (int i=0; i<width*height; i++) gradImg[i] = (short)(gradImg[i]/scale);
+} //end-ComputeGradientMapByPrewitt
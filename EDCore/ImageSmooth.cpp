@@ -0,0 +1,389 @@
+/**************************************************************************************************************
+ * Gaussian smoothing
+ *
+ * A separable 8 bit fixed-point Gaussian that reproduces OpenCV 2.4's cvSmooth(CV_GAUSSIAN) bit by bit,
+ * which the detectors were tuned with. The color & contour detectors smooth sigma 1.5 with the fixed 7x7
+ * kernel instead of the 11x11 one, as they were tuned with (fixed7x7).
+ *
+ * The rows are filtered horizontally into a ring of min(ksize, height) rows, & each output row is filtered
+ * vertically as soon as the rows it needs are in the ring. The horizontal pass multiplies 16 bit pixels by
+ * pairs of 16 bit taps (pmaddwd), the vertical pass runs cvSmooth's single precision arithmetic 4/8 pixels
+ * at a time, so the SIMD kernels give the same bits as the scalar code.
+ *
+ * SmoothImageRows hands each output row over to a callback as soon as it is done, so that ED computes the
+ * gradient & the anchors of a row while it is still in the cache.
+ **************************************************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "EDInternals.h"
+
+// SSE2/AVX2 kernels are picked at run time on x86. Build with -DSMOOTH_NO_SIMD to get the scalar reference code only
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(SMOOTH_NO_SIMD)
+#define SMOOTH_SIMD 1
+#include <immintrin.h>
+#else
+#define SMOOTH_SIMD 0
+#endif
+
+#define MAX_KERNEL_SIZE 255
+
+///-------------------------------------------------------------------------------
+/// The taps of one sigma, computed once per SmoothImage call & shared by both passes
+///
+struct GaussianKernel {
+  int ksize, radius;
+  int taps[MAX_KERNEL_SIZE];                  // 8 bit fixed-point taps, summing up to ~256
+  float ftaps[MAX_KERNEL_SIZE];               // taps/65536, for the single precision vertical pass
+  int tapPairs[(MAX_KERNEL_SIZE+1)/2];        // (taps[2k], taps[2k+1]) as two 16 bit halves for pmaddwd
+};
+
+///-------------------------------------------------------------------------------
+/// Computes the taps of a ksize Gaussian as 8 bit fixed-point numbers (they sum up to ~256).
+/// sigma<=0 selects the fixed binomial kernels of size 3, 5 & 7
+///
+static void ComputeGaussianKernel(int ksize, double sigma, int *taps){
+  static const float smallKernels[][7] = {
+    {1.f},
+    {0.25f, 0.5f, 0.25f},
+    {0.0625f, 0.25f, 0.375f, 0.25f, 0.0625f},
+    {0.03125f, 0.109375f, 0.21875f, 0.28125f, 0.21875f, 0.109375f, 0.03125f}
+  };
+
+  const float *fixedKernel = (ksize % 2 == 1 && ksize <= 7 && sigma <= 0) ? smallKernels[ksize>>1] : NULL;
+  float kernel[MAX_KERNEL_SIZE];
+
+  double sigmaX = sigma > 0 ? sigma : ((ksize-1)*0.5 - 1)*0.3 + 0.8;
+  double scale2X = -0.5/(sigmaX*sigmaX);
+  double sum = 0;
+
+  // The float rounding steps are those of cv::getGaussianKernel
+  for (int i=0; i<ksize; i++){
+    double x = i - (ksize-1)*0.5;
+    kernel[i] = fixedKernel ? fixedKernel[i] : (float)exp(scale2X*x*x);
+    sum += kernel[i];
+  } //end-for
+
+  sum = 1./sum;
+  for (int i=0; i<ksize; i++){
+    kernel[i] = (float)(kernel[i]*sum);
+    taps[i] = (int)lrintf(kernel[i]*256.0f);
+  } //end-for
+} //end-ComputeGaussianKernel
+
+///-------------------------------------------------------------------------------
+/// The kernel size of sigma
+///
+static int GaussianKernelSize(double sigma, bool fixed7x7){
+  // sigma==1.0 is cvSmooth(src, dst, CV_GAUSSIAN, 5, 5): the fixed 5x5 kernel. With fixed7x7, sigma==1.5 is the fixed 7x7 kernel
+  if (sigma == 1.0) return 5;
+  if (sigma == 1.5 && fixed7x7) return 7;
+
+  int ksize = ((int)lrint(sigma*3*2 + 1)) | 1;
+  return ksize < MAX_KERNEL_SIZE ? ksize : MAX_KERNEL_SIZE;
+} //end-GaussianKernelSize
+
+///-------------------------------------------------------------------------------
+/// Fills in the taps of sigma's kernel
+///
+static void InitGaussianKernel(double sigma, bool fixed7x7, GaussianKernel *K){
+  int ksize = GaussianKernelSize(sigma, fixed7x7);
+  if (sigma == 1.0 || (sigma == 1.5 && fixed7x7)) sigma = 0;   // The fixed kernels
+
+  K->ksize = ksize;
+  K->radius = ksize/2;
+  ComputeGaussianKernel(ksize, sigma, K->taps);
+
+  for (int k=0; k<ksize; k++) K->ftaps[k] = K->taps[k]*(1.0f/65536);
+
+  for (int k=0; k<ksize; k+=2){
+    int next = k+1 < ksize ? K->taps[k+1] : 0;
+    K->tapPairs[k/2] = (K->taps[k] & 0xffff) | (next << 16);
+  } //end-for
+} //end-InitGaussianKernel
+
+///-------------------------------------------------------------------------------
+/// Horizontal pass over pixels [first, last) of a row: exact integer sums with replicated borders
+///
+static void SmoothRowHScalar(const unsigned char *src, int *dst, int width, const GaussianKernel &K, int first, int last){
+  int ksize = K.ksize, radius = K.radius;
+
+  for (int j=first; j<last; j++){
+    int sum = 0;
+
+    if (j >= radius && j+radius < width){
+      for (int k=0; k<ksize; k++) sum += K.taps[k]*src[j-radius+k];
+
+    } else {
+      for (int k=0; k<ksize; k++){
+        int c = j-radius+k;
+        if (c < 0) c = 0;
+        else if (c >= width) c = width-1;
+        sum += K.taps[k]*src[c];
+      } //end-for
+    } //end-else
+
+    dst[j] = sum;
+  } //end-for
+} //end-SmoothRowHScalar
+
+///-------------------------------------------------------------------------------
+/// Vertical pass over pixels [first, width) of a row; center[k] is the horizontally filtered row at offset k.
+/// cvSmooth computes groups of 4 pixels in single precision with the taps scaled by 1/65536 & rounds to the
+/// nearest even; the trailing width%4 pixels are done in fixed-point, rounding halves up
+///
+static void SmoothRowVScalar(const int **center, unsigned char *dst, int width, const GaussianKernel &K, int first){
+  int radius = K.radius;
+  int floatWidth = width & ~3;
+  const float *fcenter = K.ftaps + radius;
+  const int *icenter = K.taps + radius;
+
+  for (int j=first; j<floatWidth; j++){
+    float sum = center[0][j]*fcenter[0];
+    for (int k=1; k<=radius; k++){
+      float p = (float)(center[k][j] + center[-k][j])*fcenter[k];
+      sum += p;
+    } //end-for
+
+    int v = (int)lrintf(sum);
+    dst[j] = v < 0 ? 0 : (v > 255 ? 255 : v);
+  } //end-for
+
+  for (int j=floatWidth > first ? floatWidth : first; j<width; j++){
+    int sum = center[0][j]*icenter[0];
+    for (int k=1; k<=radius; k++) sum += (center[k][j] + center[-k][j])*icenter[k];
+
+    int v = (sum + (1<<15)) >> 16;
+    dst[j] = v < 0 ? 0 : (v > 255 ? 255 : v);
+  } //end-for
+} //end-SmoothRowVScalar
+
+#if SMOOTH_SIMD
+///-------------------------------------------------------------------------------
+/// 2: AVX2, 1: SSE2, 0: none
+///
+static int SimdLevel(){
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx2")) return 2;
+  if (__builtin_cpu_supports("sse2")) return 1;
+  return 0;
+} //end-SimdLevel
+
+///-------------------------------------------------------------------------------
+/// Horizontal pass, 8 pixels at a time. Pixel j-radius+k & its right neighbor are interleaved as 16 bit
+/// numbers so that pmaddwd multiplies them by a tap pair & adds them up in 32 bits. The loads reach
+/// radius+8 pixels right of the group, so the pixels closer to the borders are left to the scalar code
+///
+__attribute__((target("sse2")))
+static void SmoothRowHSSE2(const unsigned char *src, int *dst, int width, const GaussianKernel &K){
+  const __m128i zero = _mm_setzero_si128();
+  int ksize = K.ksize, radius = K.radius;
+
+  int j = radius < width ? radius : width;
+  SmoothRowHScalar(src, dst, width, K, 0, j);
+
+  for (; j+radius+8 < width; j+=8){
+    const unsigned char *p = src + j-radius;
+    __m128i lo = zero, hi = zero;
+
+    for (int k=0; k<ksize; k+=2){
+      __m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(p+k)), zero);
+      __m128i b = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(p+k+1)), zero);
+      __m128i t = _mm_set1_epi32(K.tapPairs[k/2]);
+
+      lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), t));
+      hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), t));
+    } //end-for
+
+    _mm_storeu_si128((__m128i *)(dst+j), lo);
+    _mm_storeu_si128((__m128i *)(dst+j+4), hi);
+  } //end-for
+
+  SmoothRowHScalar(src, dst, width, K, j, width);
+} //end-SmoothRowHSSE2
+
+///-------------------------------------------------------------------------------
+/// Same, 16 pixels at a time. The unpacks work within 128 bit lanes: lo gets pixels 0-3 & 8-11, hi 4-7 & 12-15
+///
+__attribute__((target("avx2")))
+static void SmoothRowHAVX2(const unsigned char *src, int *dst, int width, const GaussianKernel &K){
+  const __m256i zero = _mm256_setzero_si256();
+  int ksize = K.ksize, radius = K.radius;
+
+  int j = radius < width ? radius : width;
+  SmoothRowHScalar(src, dst, width, K, 0, j);
+
+  for (; j+radius+16 < width; j+=16){
+    const unsigned char *p = src + j-radius;
+    __m256i lo = zero, hi = zero;
+
+    for (int k=0; k<ksize; k+=2){
+      __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(p+k)));
+      __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(p+k+1)));
+      __m256i t = _mm256_set1_epi32(K.tapPairs[k/2]);
+
+      lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), t));
+      hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), t));
+    } //end-for
+
+    _mm256_storeu_si256((__m256i *)(dst+j), _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256((__m256i *)(dst+j+8), _mm256_permute2x128_si256(lo, hi, 0x31));
+  } //end-for
+
+  SmoothRowHScalar(src, dst, width, K, j, width);
+} //end-SmoothRowHAVX2
+
+///-------------------------------------------------------------------------------
+/// Vertical pass, 4 pixels at a time with the scalar code's float operations in the scalar code's order.
+/// cvtps2dq rounds to the nearest even like lrintf, the saturating packs clamp to [0, 255]
+///
+__attribute__((target("sse2")))
+static void SmoothRowVSSE2(const int **center, unsigned char *dst, int width, const GaussianKernel &K){
+  int radius = K.radius;
+  int floatWidth = width & ~3;
+  const float *fcenter = K.ftaps + radius;
+
+  int j = 0;
+  for (; j<floatWidth; j+=4){
+    __m128 sum = _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(center[0]+j))), _mm_set1_ps(fcenter[0]));
+
+    for (int k=1; k<=radius; k++){
+      __m128i s = _mm_add_epi32(_mm_loadu_si128((const __m128i *)(center[k]+j)), _mm_loadu_si128((const __m128i *)(center[-k]+j)));
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_cvtepi32_ps(s), _mm_set1_ps(fcenter[k])));
+    } //end-for
+
+    __m128i v = _mm_cvtps_epi32(sum);
+    v = _mm_packs_epi32(v, v);
+    int pixels = _mm_cvtsi128_si32(_mm_packus_epi16(v, v));
+    memcpy(dst+j, &pixels, 4);
+  } //end-for
+
+  SmoothRowVScalar(center, dst, width, K, j);
+} //end-SmoothRowVSSE2
+
+///-------------------------------------------------------------------------------
+/// Same, 8 pixels at a time
+///
+__attribute__((target("avx2")))
+static void SmoothRowVAVX2(const int **center, unsigned char *dst, int width, const GaussianKernel &K){
+  int radius = K.radius;
+  int floatWidth = width & ~3;
+  const float *fcenter = K.ftaps + radius;
+
+  int j = 0;
+  for (; j+8<=floatWidth; j+=8){
+    __m256 sum = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i *)(center[0]+j))), _mm256_set1_ps(fcenter[0]));
+
+    for (int k=1; k<=radius; k++){
+      __m256i s = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(center[k]+j)), _mm256_loadu_si256((const __m256i *)(center[-k]+j)));
+      sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_cvtepi32_ps(s), _mm256_set1_ps(fcenter[k])));
+    } //end-for
+
+    __m256i v = _mm256_cvtps_epi32(sum);
+    __m128i v16 = _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    _mm_storel_epi64((__m128i *)(dst+j), _mm_packus_epi16(v16, v16));
+  } //end-for
+
+  SmoothRowVScalar(center, dst, width, K, j);
+} //end-SmoothRowVAVX2
+#endif
+
+///-------------------------------------------------------------------------------
+/// Horizontal & vertical pass of one row with the best kernel the CPU runs
+///
+static void SmoothRowH(const unsigned char *src, int *dst, int width, const GaussianKernel &K){
+#if SMOOTH_SIMD
+  static const int level = SimdLevel();
+
+  if (level >= 2){SmoothRowHAVX2(src, dst, width, K); return;}
+  if (level >= 1){SmoothRowHSSE2(src, dst, width, K); return;}
+#endif
+
+  SmoothRowHScalar(src, dst, width, K, 0, width);
+} //end-SmoothRowH
+
+static void SmoothRowV(const int **center, unsigned char *dst, int width, const GaussianKernel &K){
+#if SMOOTH_SIMD
+  static const int level = SimdLevel();
+
+  if (level >= 2){SmoothRowVAVX2(center, dst, width, K); return;}
+  if (level >= 1){SmoothRowVSSE2(center, dst, width, K); return;}
+#endif
+
+  SmoothRowVScalar(center, dst, width, K, 0);
+} //end-SmoothRowV
+
+///-------------------------------------------------------------------------------
+/// Smooths the rows top to bottom. Row i goes to dst + (i%dstRows)*width & rowDone(i, arg) is called as soon as
+/// it is there. Without tmpImg, allocates the ring of the call
+///
+static void SmoothRows(unsigned char *srcImg, unsigned char *dst, int dstRows, int width, int height, double sigma, bool fixed7x7, int *tmpImg, SmoothRowCallback rowDone, void *arg){
+  if (sigma <= 0){
+    for (int i=0; i<height; i++){
+      unsigned char *row = dst + (i % dstRows)*width;
+      if (row != srcImg + i*width) memcpy(row, srcImg + i*width, width);
+      if (rowDone) rowDone(i, arg);
+    } //end-for
+
+    return;
+  } //end-if
+
+  GaussianKernel K;
+  InitGaussianKernel(sigma, fixed7x7, &K);
+
+  int radius = K.radius;
+
+  // Output row i needs the rows i-radius..i+radius, clamped to the image: at most ringRows distinct rows,
+  // which never share a slot of the ring. Row i is written after source row i has been read, so srcImg
+  // may be smoothImg
+  int ringRows = K.ksize < height ? K.ksize : height;
+  int *ring = tmpImg ? tmpImg : new int[ringRows*width];
+  const int *rows[MAX_KERNEL_SIZE];
+  int nextRow = 0;
+
+  for (int i=0; i<height; i++){
+    int lastRow = i+radius < height ? i+radius : height-1;
+
+    for (; nextRow<=lastRow; nextRow++) SmoothRowH(srcImg + nextRow*width, ring + (nextRow % ringRows)*width, width, K);
+
+    for (int k=0; k<K.ksize; k++){
+      int r = i-radius+k;
+      if (r < 0) r = 0;
+      else if (r >= height) r = height-1;
+      rows[k] = ring + (r % ringRows)*width;
+    } //end-for
+
+    SmoothRowV(rows + radius, dst + (i % dstRows)*width, width, K);
+    if (rowDone) rowDone(i, arg);
+  } //end-for
+
+  if (ring != tmpImg) delete[] ring;
+} //end-SmoothRows
+
+///-------------------------------------------------------------------------------
+/// # of ints of scratch SmoothRows needs: its ring of rows
+///
+int SmoothScratchSize(int width, int height, double sigma, bool fixed7x7){
+  if (sigma <= 0) return 0;
+
+  int ksize = GaussianKernelSize(sigma, fixed7x7);
+  return (ksize < height ? ksize : height)*width;
+} //end-SmoothScratchSize
+
+///-------------------------------------------------------------------------------
+/// Smooth the image with a Gaussian kernel
+///
+void SmoothImage(unsigned char *srcImg, unsigned char *smoothImg, int width, int height, double sigma, int *tmpImg, bool fixed7x7){
+  PROFILE_STAGE("SmoothImage");
+
+  SmoothRows(srcImg, smoothImg, height, width, height, sigma, fixed7x7, tmpImg, NULL, NULL);
+} //end-SmoothImage
+
+///-------------------------------------------------------------------------------
+/// Streams the smoothed rows through a ring of ringRows rows instead of writing the whole image
+///
+void SmoothImageRows(unsigned char *srcImg, unsigned char *ringImg, int ringRows, int width, int height, double sigma, int *tmpImg, SmoothRowCallback rowDone, void *arg){
+  SmoothRows(srcImg, ringImg, ringRows, width, height, sigma, false, tmpImg, rowDone, arg);
+} //end-SmoothImageRows
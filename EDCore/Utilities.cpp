@@ -0,0 +1,155 @@
+/**************************************************************************************************************
+ * Color space conversions
+ **************************************************************************************************************/
+#include <stdlib.h>
+#include <math.h>
+
+#include "EDInternals.h"
+
+#define CBRT_LUT_SIZE  16384     // # of steps of the f(t) LUT over [0, 1], which is interpolated linearly
+
+static bool LUTsInitialized = false;
+static double GammaLUT[256];                  // sRGB -> linear RGB, by 8 bit value
+static double CubicRootLUT[CBRT_LUT_SIZE+1];  // f(t) of L*a*b*
+
+///-------------------------------------------------------------------------------
+/// Fills the LUTs of the RGB -> L*a*b* conversion. Called by the conversion itself if need be
+///
+void InitColorEDLib(){
+  if (LUTsInitialized) return;
+
+  for (int i=0; i<256; i++){
+    double x = i/255.0;
+
+    if (x < 0.04045) GammaLUT[i] = x/12.92;
+    else             GammaLUT[i] = pow((x+0.055)/1.055, 2.4);
+  } //end-for
+
+  for (int i=0; i<=CBRT_LUT_SIZE; i++){
+    double x = i/(double)CBRT_LUT_SIZE;
+
+    if (x > 0.008856) CubicRootLUT[i] = pow(x, 1.0/3.0);
+    else              CubicRootLUT[i] = 7.787*x + 16.0/116.0;
+  } //end-for
+
+  LUTsInitialized = true;
+} //end-InitColorEDLib
+
+///-------------------------------------------------------------------------------
+/// f(t) of L*a*b* for t in [0, 1], interpolated from its LUT: within 5e-7 of the formula
+///
+static inline double LabFLUT(double t){
+  double p = t*CBRT_LUT_SIZE;
+  int i = (int)p;
+  if (i >= CBRT_LUT_SIZE) i = CBRT_LUT_SIZE-1;   // t may round to a hair over 1 for white
+
+  return CubicRootLUT[i] + (p-i)*(CubicRootLUT[i+1]-CubicRootLUT[i]);
+} //end-LabFLUT
+
+///-------------------------------------------------------------------------------
+/// Stretches the values of a channel to [0, 255]
+///
+static void ScaleChannel(double *channel, unsigned char *img, int n){
+  double min = 1e10, max = -1e10;
+
+  for (int i=0; i<n; i++){
+    if (channel[i] < min) min = channel[i];
+    else if (channel[i] > max) max = channel[i];
+  } //end-for
+
+  double scale = 255.0/(max-min);
+  for (int i=0; i<n; i++) img[i] = (unsigned char)(short)((channel[i]-min)*scale);
+} //end-ScaleChannel
+
+///-------------------------------------------------------------------------------
+/// RGB -> CIE L*a*b* (D65 white) through the LUTs. Each channel is stretched to [0, 255]
+///
+void MyRGB2LabFast(unsigned char *redImg, unsigned char *greenImg, unsigned char *blueImg, unsigned char *LImg, unsigned char *aImg, unsigned char *bImg, int width, int height){
+  PROFILE_STAGE("MyRGB2LabFast");
+
+  int n = width*height;
+
+  double *L = new double[n];
+  double *a = new double[n];
+  double *b = new double[n];
+
+  InitColorEDLib();
+
+  for (int i=0; i<n; i++){
+    double red = GammaLUT[redImg[i]]*100;
+    double green = GammaLUT[greenImg[i]]*100;
+    double blue = GammaLUT[blueImg[i]]*100;
+
+    double x = red*0.4124564 + green*0.3575761 + blue*0.1804375;
+    double y = red*0.2126729 + green*0.7151522 + blue*0.0721750;
+    double z = red*0.0193339 + green*0.1191920 + blue*0.9503041;
+
+    double fx = LabFLUT(x/95.047);
+    double fy = LabFLUT(y/100.0);
+    double fz = LabFLUT(z/108.883);
+
+    // a* is taken as the ratio of fx & fy, which the detectors were tuned with
+    L[i] = 116.0*fy - 16.0;
+    a[i] = 500.0*(fx/fy);
+    b[i] = 200.0*(fy-fz);
+  } //end-for
+
+  ScaleChannel(L, LImg, n);
+  ScaleChannel(a, aImg, n);
+  ScaleChannel(b, bImg, n);
+
+  delete[] L;
+  delete[] a;
+  delete[] b;
+} //end-MyRGB2LabFast
+
+///-------------------------------------------------------------------------------
+/// RGB -> CIE L*a*b* (D65 white) by the standard formulas, without the LUTs. Each channel is stretched to [0, 255]
+///
+static double InverseGamma(unsigned char v){
+  double x = v/255.0;
+
+  if (x > 0.04045) return pow((x+0.055)/1.055, 2.4)*100;
+  else             return x/12.92*100;
+} //end-InverseGamma
+
+static double LabF(double t){
+  if (t > 0.008856) return pow(t, 1.0/3.0);
+  else              return 7.787*t + 16.0/116.0;
+} //end-LabF
+
+void StdRGB2Lab(unsigned char *redImg, unsigned char *greenImg, unsigned char *blueImg, unsigned char *LImg, unsigned char *aImg, unsigned char *bImg, int width, int height){
+  PROFILE_STAGE("StdRGB2Lab");
+
+  int n = width*height;
+
+  double *L = new double[n];
+  double *a = new double[n];
+  double *b = new double[n];
+
+  for (int i=0; i<n; i++){
+    double red = InverseGamma(redImg[i]);
+    double green = InverseGamma(greenImg[i]);
+    double blue = InverseGamma(blueImg[i]);
+
+    double x = red*0.4124564 + green*0.3575761 + blue*0.1804375;
+    double y = red*0.2126729 + green*0.7151522 + blue*0.0721750;
+    double z = red*0.0193339 + green*0.1191920 + blue*0.9503041;
+
+    double fx = LabF(x/95.047);
+    double fy = LabF(y/100.0);
+    double fz = LabF(z/108.883);
+
+    L[i] = 116.0*fy - 16.0;
+    a[i] = 500.0*(fx-fy);
+    b[i] = 200.0*(fy-fz);
+  } //end-for
+
+  ScaleChannel(L, LImg, n);
+  ScaleChannel(a, aImg, n);
+  ScaleChannel(b, bImg, n);
+
+  delete[] L;
+  delete[] a;
+  delete[] b;
+} //end-StdRGB2Lab
@@ -0,0 +1,548 @@
+/**************************************************************************************************************
+ * Edge segment validation by the Helmholtz principle
+ *
+ * A piece of an edge segment is meaningful if the expected # of such pieces in a random image, whose gradients
+ * follow the distribution of the image's own gradients, is below EPSILON (Number of False Alarms)
+ *
+ * The segments are tested independently of each other, so numThreads threads can share the work: the gradient
+ * is computed over horizontal bands of the image, then the segments are tested & cut in chunks of about the same
+ * # of pixels, taken by the threads one after the other. The result is the same for any numThreads.
+ **************************************************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+
+#include "EDInternals.h"
+
+#define EPSILON 1.0
+#define MIN_SEGMENT_LEN 10
+
+#define CHUNKS_PER_THREAD 8         // Chunks of segments per thread, so that the threads finish at about the same time
+#define MAX_CHUNKS        1024
+
+///-------------------------------------------------------------------------------
+/// Turns the histogram of the gradients of the image's inner pixels into the probability H[g] of a pixel having
+/// a gradient >= g
+///
+static void ComputeProbabilities(int *grads, double *H, int width, int height){
+  int size = (width-2)*(height-2);
+
+  for (int i=MAX_GRAD_VALUE-1; i>0; i--) grads[i-1] += grads[i];
+  for (int i=0; i<MAX_GRAD_VALUE; i++) H[i] = (double)grads[i]/((double)size);
+} //end-ComputeProbabilities
+
+///-------------------------------------------------------------------------------
+/// Prewitt gradient magnitudes of the rows [firstRow, lastRow) of srcImg, which must be inner rows. Adds the
+/// gradients of the inner pixels to the histogram grads
+///
+static void ComputePrewitt3x3Rows(unsigned char *srcImg, short *gradImg, int width, int firstRow, int lastRow, int *grads){
+  for (int i=firstRow; i<lastRow; i++){
+    gradImg[i*width] = gradImg[i*width+width-1] = 0;
+
+    for (int j=1; j<width-1; j++){
+      // Prewitt Operator in horizontal and vertical direction
+      int com1 = srcImg[(i+1)*width+j+1] - srcImg[(i-1)*width+j-1];
+      int com2 = srcImg[(i-1)*width+j+1] - srcImg[(i+1)*width+j-1];
+
+      int gx = abs(com1 + com2 + (srcImg[i*width+j+1] - srcImg[i*width+j-1]));
+      int gy = abs(com1 - com2 + (srcImg[(i+1)*width+j] - srcImg[(i-1)*width+j]));
+
+      gradImg[i*width+j] = gx+gy;
+    } //end-for
+
+    // Kept out of the loop above so that the compiler vectorizes it
+    for (int j=1; j<width-1; j++) grads[gradImg[i*width+j]]++;
+  } //end-for
+} //end-ComputePrewitt3x3Rows
+
+///-------------------------------------------------------------------------------
+/// Same over the 3 channels of a color image: the gradient is the mean of the channels' gradients, rounded
+/// by adding "bias" before the division
+///
+static void ComputePrewitt3x3Rows(unsigned char **channels, short *gradImg, int width, int firstRow, int lastRow, int *grads, int bias){
+  for (int i=firstRow; i<lastRow; i++){
+    gradImg[i*width] = gradImg[i*width+width-1] = 0;
+
+    for (int j=1; j<width-1; j++){
+      int sum = 0;
+
+      for (int k=0; k<3; k++){
+        unsigned char *img = channels[k];
+
+        int com1 = img[(i+1)*width+j+1] - img[(i-1)*width+j-1];
+        int com2 = img[(i-1)*width+j+1] - img[(i+1)*width+j-1];
+
+        int gx = abs(com1 + com2 + (img[i*width+j+1] - img[i*width+j-1]));
+        int gy = abs(com1 - com2 + (img[(i+1)*width+j] - img[(i-1)*width+j]));
+
+        sum += gx+gy;
+      } //end-for
+
+      gradImg[i*width+j] = (sum+bias)/3;
+    } //end-for
+
+    for (int j=1; j<width-1; j++) grads[gradImg[i*width+j]]++;
+  } //end-for
+} //end-ComputePrewitt3x3Rows
+
+///-------------------------------------------------------------------------------
+/// The shortest piece (in pixels/divForTestSegment) whose weakest pixel has a gradient of probability prob that is
+/// meaningful: the smallest len for which the Number of False Alarms np*prob^len, multiplied out one pixel at a
+/// time, is <= EPSILON. Returns maxLen+1 if it is longer than maxLen
+///
+static int MinMeaningfulLen(double prob, int np, int maxLen){
+  double nfa = np;
+  int len = 0;
+  while (nfa > EPSILON && len <= maxLen){nfa *= prob; len++;}
+
+  return len;
+} //end-MinMeaningfulLen
+
+/// The NFA test of one validation. The shortest meaningful piece only depends on the weakest gradient of the
+/// piece, so it is computed once per gradient value, the first time a piece needs it. Threads that need the same
+/// entry at once both compute the same value, so the entries are read & written atomically, without locks
+struct NFATest {
+  double *H;                  // Probability of a gradient value being >= a given value
+  int np;                     // # of segment pieces
+  int maxLen;                 // Longest piece to be tested, in pixels/divForTestSegment
+  double divForTestSegment;
+  int *minLens;               // MAX_GRAD_VALUE entries, -1 until computed
+};
+
+static inline bool IsMeaningful(NFATest *T, int minGrad, int chainLen){
+  int minLen = __atomic_load_n(&T->minLens[minGrad], __ATOMIC_RELAXED);
+  if (minLen < 0){
+    minLen = MinMeaningfulLen(T->H[minGrad], T->np, T->maxLen);
+    __atomic_store_n(&T->minLens[minGrad], minLen, __ATOMIC_RELAXED);
+  } //end-if
+
+  return (int)(chainLen/T->divForTestSegment) >= minLen;
+} //end-IsMeaningful
+
+///-------------------------------------------------------------------------------
+/// Tests the pixels [startIndex, endIndex] of a segment, whose gradients are in grads. If they are not meaningful
+/// as a whole, the segment is split at its weakest pixel & both halves are tested recursively. Meaningful pieces
+/// are marked in edgeImg. Segments may share a pixel, which all mark with the same value: the stores are atomic
+///
+static void TestSegment(EdgeMap *map, int segmentNo, int *grads, int startIndex, int endIndex, NFATest *T){
+  int chainLen = endIndex-startIndex+1;
+  if (chainLen < MIN_SEGMENT_LEN) return;
+
+  int width = map->width;
+  Pixel *pixels = map->segments[segmentNo].pixels;
+
+  // Test the whole segment
+  int minGrad = 1<<30;
+  int minGradIndex = 0;
+  for (int k=startIndex; k<=endIndex; k++){
+    if (grads[k] < minGrad){minGrad = grads[k]; minGradIndex = k;}
+  } //end-for
+
+  if (IsMeaningful(T, minGrad, chainLen)){
+    for (int k=startIndex; k<=endIndex; k++){
+      __atomic_store_n(&map->edgeImg[pixels[k].r*width+pixels[k].c], 255, __ATOMIC_RELAXED);
+    } //end-for
+
+    return;
+  } //end-if
+
+  // Split into two halves. We divide at the point where the gradient is the minimum
+  int end = minGradIndex-1;
+  while (end > startIndex && grads[end] <= minGrad) end--;
+
+  int start = minGradIndex+1;
+  while (start < endIndex && grads[start] <= minGrad) start++;
+
+  TestSegment(map, segmentNo, grads, startIndex, end, T);
+  TestSegment(map, segmentNo, grads, start, endIndex, T);
+} //end-TestSegment
+
+
+///-------------------------------------------------------------------------------
+/// The runs of pixels of segment i that are marked in edgeImg & long enough. Writes them to newSegments unless it
+/// is NULL & returns their #
+///
+static int ExtractRuns(EdgeMap *map, int i, EdgeSegment *newSegments){
+  int width = map->width;
+  unsigned char *edgeImg = map->edgeImg;
+  Pixel *pixels = map->segments[i].pixels;
+  int noPixels = map->segments[i].noPixels;
+  int noRuns = 0;
+
+  int start = 0;
+  while (start < noPixels){
+    while (start < noPixels){
+      if (edgeImg[pixels[start].r*width+pixels[start].c]) break;
+      start++;
+    } //end-while
+
+    int end = start+1;
+    while (end < noPixels){
+      if (edgeImg[pixels[end].r*width+pixels[end].c] == 0) break;
+      end++;
+    } //end-while
+
+    int len = end-start;
+    if (len >= MIN_SEGMENT_LEN){
+      if (newSegments){
+        newSegments[noRuns].pixels = &pixels[start];
+        newSegments[noRuns].noPixels = len;
+      } //end-if
+      noRuns++;
+    } //end-if
+
+    start = end+1;
+  } //end-while
+
+  return noRuns;
+} //end-ExtractRuns
+
+/// One validation, shared by the threads. ED's detectors run it in the memory of their EDContext, the other
+/// detectors in memory of its own
+struct Validation {
+  EdgeMap *map;
+  unsigned char *channels[3];   // The image, or the 3 channels of a color image
+  int noChannels;
+  int bias;                     // Rounding of the mean of the 3 channels' gradients
+  int numThreads;
+  ThreadPool *pool;
+
+  short *gradImg;
+  int *counts;                  // Gradient histogram of thread 0
+  int *threadCounts;            // Those of the other threads
+  double *H;
+  int *grads;                   // Gradients of the segments' pixels, at the pixels' place in map->pixels
+  int *offsets;                 // # of new segments of each segment, then the index of its first one
+  int maxGrads, maxOffsets;
+  NFATest T;
+  EDContext *ctx;               // The context whose memory is used, NULL if the validation owns its memory
+
+  // Chunks of segments [chunks[k], chunks[k+1]), taken by the threads in turn
+  int chunks[MAX_CHUNKS+1];
+  int noChunks;
+  int next;
+
+  Validation(EDContext *ctx, EdgeMap *map, unsigned char *ch1Img, unsigned char *ch2Img, unsigned char *ch3Img, int bias, int numThreads){
+    int n = map->width*map->height;
+
+    this->map = map;
+    channels[0] = ch1Img;
+    channels[1] = ch2Img;
+    channels[2] = ch3Img;
+    noChannels = ch2Img ? 3 : 1;
+    this->bias = bias;
+    this->numThreads = numThreads < 1 ? 1 : numThreads;
+    numThreads = this->numThreads;
+
+    this->ctx = ctx;
+
+    if (ctx){
+      if (numThreads > 1 && ctx->maxThreads < numThreads){
+        delete[] ctx->threadCounts;
+        ctx->threadCounts = new int[(numThreads-1)*MAX_GRAD_VALUE];
+        ctx->maxThreads = numThreads;
+      } //end-if
+      if (numThreads > 1) ContextThreads(ctx, numThreads);
+
+      pool = ctx->threads;
+      gradImg = ctx->gradImg;
+      counts = ctx->anchorCounts;
+      threadCounts = ctx->threadCounts;
+      H = ctx->H;
+      T.minLens = ctx->minLens;
+
+    } else {
+      pool = numThreads > 1 ? new ThreadPool(numThreads) : NULL;
+      gradImg = new short[n];
+      counts = new int[MAX_GRAD_VALUE];
+      threadCounts = new int[(numThreads-1)*MAX_GRAD_VALUE];
+      H = new double[MAX_GRAD_VALUE];
+      T.minLens = new int[MAX_GRAD_VALUE];
+    } //end-else
+
+    grads = offsets = NULL;
+    maxGrads = maxOffsets = 0;
+  } //end-Validation
+
+  // Room for the gradients of noPixels pixels of map->pixels & the offsets of noSegments segments
+  void Reserve(int noPixels, int noSegments){
+    if (ctx){
+      grads = ctx->ReserveTmp(noPixels);
+      offsets = ctx->ReserveAnchors(noSegments);
+
+    } else {
+      ReserveInts(&grads, &maxGrads, noPixels, 0);
+      ReserveInts(&offsets, &maxOffsets, noSegments, 0);
+    } //end-else
+  } //end-Reserve
+
+  ~Validation(){
+    if (ctx) return;
+
+    delete pool;
+    delete[] gradImg;
+    delete[] counts;
+    delete[] threadCounts;
+    delete[] H;
+    delete[] grads;
+    delete[] offsets;
+    delete[] T.minLens;
+  } //end-~Validation
+};
+
+///-------------------------------------------------------------------------------
+/// Thread t computes the gradient of its band of rows & its histogram
+///
+static void PrewittJob(int t, void *arg){
+  Validation *V = (Validation *)arg;
+  int width = V->map->width;
+
+  int *grads = t == 0 ? V->counts : V->threadCounts + (t-1)*MAX_GRAD_VALUE;
+  memset(grads, 0, sizeof(int)*MAX_GRAD_VALUE);
+
+  int rows = V->map->height-2;
+  int firstRow = 1 + (int)((long long)t*rows/V->numThreads);
+  int lastRow = 1 + (int)((long long)(t+1)*rows/V->numThreads);
+
+  if (V->noChannels == 1) ComputePrewitt3x3Rows(V->channels[0], V->gradImg, width, firstRow, lastRow, grads);
+  else                    ComputePrewitt3x3Rows(V->channels, V->gradImg, width, firstRow, lastRow, grads, V->bias);
+} //end-PrewittJob
+
+///-------------------------------------------------------------------------------
+/// Prewitt gradient magnitudes of the image over bands of rows. Computes the probability H[g] of a pixel having
+/// a gradient >= g
+///
+static void ComputePrewitt3x3(Validation *V){
+  int width = V->map->width;
+  int height = V->map->height;
+
+  memset(V->gradImg, 0, sizeof(short)*width);
+  memset(V->gradImg+(height-1)*width, 0, sizeof(short)*width);
+
+  int numThreads = V->numThreads;
+  V->numThreads = height-2 < numThreads ? (height > 2 ? height-2 : 1) : numThreads;
+  if (height > 2) RunThreads(V->pool, V->numThreads, PrewittJob, V);
+  else            memset(V->counts, 0, sizeof(int)*MAX_GRAD_VALUE);
+
+  int *grads = V->counts;
+  for (int t=1; t<V->numThreads; t++){
+    int *threadGrads = V->threadCounts + (t-1)*MAX_GRAD_VALUE;
+    for (int g=0; g<MAX_GRAD_VALUE; g++) grads[g] += threadGrads[g];
+  } //end-for
+
+  V->numThreads = numThreads;
+  ComputeProbabilities(grads, V->H, width, height);
+} //end-ComputePrewitt3x3
+
+///-------------------------------------------------------------------------------
+/// Tests the segments of the chunks the thread takes. The gradients of a segment are read once, in the order of
+/// its pixels
+///
+static void TestJob(int, void *arg){
+  Validation *V = (Validation *)arg;
+  EdgeMap *map = V->map;
+  int width = map->width;
+
+  int k;
+  while ((k = __atomic_fetch_add(&V->next, 1, __ATOMIC_RELAXED)) < V->noChunks){
+    for (int i=V->chunks[k]; i<V->chunks[k+1]; i++){
+      Pixel *pixels = map->segments[i].pixels;
+      int noPixels = map->segments[i].noPixels;
+      int *grads = V->grads + (pixels - map->pixels);
+
+      for (int p=0; p<noPixels; p++) grads[p] = V->gradImg[pixels[p].r*width+pixels[p].c];
+
+      TestSegment(map, i, grads, 0, noPixels-1, &V->T);
+    } //end-for
+  } //end-while
+} //end-TestJob
+
+///-------------------------------------------------------------------------------
+/// Counts the new segments of each segment
+///
+static void CountRunsJob(int, void *arg){
+  Validation *V = (Validation *)arg;
+
+  int k;
+  while ((k = __atomic_fetch_add(&V->next, 1, __ATOMIC_RELAXED)) < V->noChunks){
+    for (int i=V->chunks[k]; i<V->chunks[k+1]; i++) V->offsets[i] = ExtractRuns(V->map, i, NULL);
+  } //end-while
+} //end-CountRunsJob
+
+///-------------------------------------------------------------------------------
+/// Writes the new segments of each segment after the old ones, at its offset
+///
+static void ExtractRunsJob(int, void *arg){
+  Validation *V = (Validation *)arg;
+  EdgeMap *map = V->map;
+
+  int k;
+  while ((k = __atomic_fetch_add(&V->next, 1, __ATOMIC_RELAXED)) < V->noChunks){
+    for (int i=V->chunks[k]; i<V->chunks[k+1]; i++) ExtractRuns(map, i, &map->segments[map->noSegments + V->offsets[i]]);
+  } //end-while
+} //end-ExtractRunsJob
+
+///-------------------------------------------------------------------------------
+/// Replaces the edge segments by their runs of pixels marked in edgeImg that are long enough.
+/// The new segments are first put after the old ones, then moved to the front. With several threads, each segment's
+/// new segments go to the offset given by the counts of the segments before it, so they keep the same order
+///
+static void ExtractNewSegments(Validation *V, int numThreads){
+  EdgeMap *map = V->map;
+  EdgeSegment *segments = &map->segments[map->noSegments];
+  int noSegments = 0;
+
+  if (numThreads == 1){
+    for (int i=0; i<map->noSegments; i++) noSegments += ExtractRuns(map, i, &segments[noSegments]);
+
+  } else {
+    V->next = 0;
+    RunThreads(V->pool, numThreads, CountRunsJob, V);
+
+    for (int i=0; i<map->noSegments; i++){
+      int noRuns = V->offsets[i];
+      V->offsets[i] = noSegments;
+      noSegments += noRuns;
+    } //end-for
+
+    V->next = 0;
+    RunThreads(V->pool, numThreads, ExtractRunsJob, V);
+  } //end-else
+
+  // Copy to the beginning of the segments array
+  for (int i=0; i<noSegments; i++) map->segments[i] = segments[i];
+
+  map->noSegments = noSegments;
+} //end-ExtractNewSegments
+
+///-------------------------------------------------------------------------------
+/// Tests the segments against the gradient distribution V->H & keeps their meaningful pieces
+///
+static void TestSegments(Validation *V, double divForTestSegment){
+  EdgeMap *map = V->map;
+
+  // Compute np: # of segment pieces
+  int np = 0;
+  int maxNoPixels = 0;
+  long long totalPixels = 0;
+  int lastPixel = 0;        // The pixels of the segments lie in map->pixels[0, lastPixel)
+  int maxRuns = 0;          // A run takes MIN_SEGMENT_LEN pixels or more & the one after it
+  for (int i=0; i<map->noSegments; i++){
+    int len = map->segments[i].noPixels;
+    np += (len*(len-1))/2;
+    if (len > maxNoPixels) maxNoPixels = len;
+    totalPixels += len;
+    maxRuns += (len+1)/(MIN_SEGMENT_LEN+1);
+
+    int end = (int)(map->segments[i].pixels - map->pixels) + len;
+    if (end > lastPixel) lastPixel = end;
+  } //end-for
+
+  V->Reserve(lastPixel, map->noSegments);
+
+  // The new segments are put after the old ones
+  map->ReserveSegments(map->noSegments+maxRuns, map->noSegments);
+
+  V->T.H = V->H;
+  V->T.np = np;
+  V->T.maxLen = (int)(maxNoPixels/divForTestSegment);
+  V->T.divForTestSegment = divForTestSegment;
+  memset(V->T.minLens, -1, sizeof(int)*MAX_GRAD_VALUE);
+
+  // Cut the segments into chunks of about the same # of pixels
+  int numThreads = map->noSegments < V->numThreads ? (map->noSegments > 0 ? map->noSegments : 1) : V->numThreads;
+  int noChunks = numThreads == 1 ? 1 : numThreads*CHUNKS_PER_THREAD;
+  if (noChunks > MAX_CHUNKS) noChunks = MAX_CHUNKS;
+
+  V->noChunks = 0;
+  V->chunks[0] = 0;
+  long long chunkPixels = 0;
+  for (int i=0; i<map->noSegments; i++){
+    chunkPixels += map->segments[i].noPixels;
+    if (chunkPixels*noChunks >= totalPixels*(V->noChunks+1) && V->noChunks < noChunks-1) V->chunks[++V->noChunks] = i+1;
+  } //end-for
+  V->chunks[++V->noChunks] = map->noSegments;
+
+  // Validate segments
+  V->next = 0;
+  RunThreads(V->pool, numThreads, TestJob, V);
+
+  ExtractNewSegments(V, numThreads);
+} //end-TestSegments
+
+///-------------------------------------------------------------------------------
+/// Validate the edge segments over srcImg, which is usually a lightly smoothed version of the image
+///
+void ValidateEdgeSegments(EDContext *ctx, EdgeMap *map, unsigned char *srcImg, double divForTestSegment, int numThreads){
+  PROFILE_STAGE("ValidateEdgeSegments");
+
+  memset(map->edgeImg, 0, map->width*map->height);
+
+  Validation V(ctx, map, srcImg, NULL, NULL, 0, numThreads);
+  ComputePrewitt3x3(&V);
+  TestSegments(&V, divForTestSegment);
+} //end-ValidateEdgeSegments
+
+///-------------------------------------------------------------------------------
+/// The same in memory of its own
+///
+void ValidateEdgeSegments(EdgeMap *map, unsigned char *srcImg, double divForTestSegment, int numThreads){
+  PROFILE_STAGE("ValidateEdgeSegments");
+
+  memset(map->edgeImg, 0, map->width*map->height);
+
+  Validation V(NULL, map, srcImg, NULL, NULL, 0, numThreads);
+  ComputePrewitt3x3(&V);
+  TestSegments(&V, divForTestSegment);
+} //end-ValidateEdgeSegments
+
+///-------------------------------------------------------------------------------
+/// Validate the edge segments over the 3 channels of a color image
+///
+void ValidateEdgeSegments(EdgeMap *map, unsigned char *ch1Img, unsigned char *ch2Img, unsigned char *ch3Img, double divForTestSegment, int numThreads){
+  PROFILE_STAGE("ValidateEdgeSegments (color)");
+
+  memset(map->edgeImg, 0, map->width*map->height);
+
+  Validation V(NULL, map, ch1Img, ch2Img, ch3Img, 2, numThreads);
+  ComputePrewitt3x3(&V);
+  TestSegments(&V, divForTestSegment);
+} //end-ValidateEdgeSegments
+
+///-------------------------------------------------------------------------------
+/// Validates the edge segments over the 3 channels with divForTestSegment = 1.0, 1.5, ..., 8.5 in turn, each
+/// time keeping the surviving pieces only. Every surviving pixel at the kth division adds 1 to levels[k].
+/// Missing levels are allocated. Returns the new # of levels
+///
+int ValidateEdgeSegmentsMultipleDiv(EdgeMap *map, unsigned char *ch1Img, unsigned char *ch2Img, unsigned char *ch3Img, unsigned char **levels, int noLevels, int numThreads){
+  PROFILE_STAGE("ValidateEdgeSegmentsMultipleDiv");
+
+  int width = map->width;
+  int height = map->height;
+
+  Validation V(NULL, map, ch1Img, ch2Img, ch3Img, 1, numThreads);
+  ComputePrewitt3x3(&V);
+
+  double divForTestSegment = 1.0;
+  for (int k=0; k<MAX_DIV_LEVELS; k++){
+    if (levels[k] == NULL){
+      levels[k] = new unsigned char[width*height];
+      memset(levels[k], 0, width*height);
+      noLevels++;
+    } //end-if
+
+    memset(map->edgeImg, 0, width*height);
+    TestSegments(&V, divForTestSegment);
+
+    unsigned char *level = levels[k];
+    for (int i=0; i<map->noSegments; i++){
+      for (int j=0; j<map->segments[i].noPixels; j++){
+        Pixel &p = map->segments[i].pixels[j];
+        level[p.r*width+p.c]++;
+      } //end-for
+    } //end-for
+
+    divForTestSegment += 0.5;
+  } //end-for
+
+  return noLevels;
+} //end-ValidateEdgeSegmentsMultipleDiv
@@ -0,0 +1,668 @@
+/**************************************************************************************************************
+ * EDLines: line segments fitted to the edge segments of ED & validated by the Helmholtz principle
+ *
+ * See main.cpp for the disclaimer & the papers to cite.
+ **************************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+#include "EDLinesLib.h"
+#include "EDLib.h"
+#include "EDInternals.h"
+#include "EDLinesInternals.h"
+
+#define EDLINES_GRADIENT_THRESH  11       // ED on the LSD gradient
+#define EDLINES_ANCHOR_THRESH    3
+
+#define LINE_ERROR               1.0      // A pixel farther than this from the line does not belong to it
+#define MAX_INITIAL_FIT_ERROR    0.5      // Fitting error of the first minLineLen pixels of a line
+#define MAX_BAD_PIXELS           5        // A line ends after this many pixels in a row off the line
+#define DISTANCE_BLOCK           16       // Pixels whose distances to a growing line are computed at once
+
+#define MAX_JOIN_DISTANCE        6.0      // Collinear line segments this close are joined
+#define MAX_JOIN_ERROR           1.3
+
+#define LONG_LINE_LEN            80       // Lines of this many pixels are not validated
+#define MIN_PIXEL_VALIDATION_LEN 26       // Lines this long are first validated over their own pixels
+
+#define ALIGN_PROB               0.125    // Probability of a pixel's gradient being aligned with the line: 1/8
+
+///-------------------------------------------------------------------------------
+/// The shortest meaningful line for the image size: the n for which 1/8^n * # of lines < 1, halved
+///
+static int ComputeMinLineLength(int width, int height){
+  double logNT = 2.0*(log10((double)width) + log10((double)height));
+  return (int)((logNT/log10(8.0))*0.5 + 0.5);
+} //end-ComputeMinLineLength
+
+///-------------------------------------------------------------------------------
+/// Allocates the working memory of the image size
+///
+EDLinesContext::EDLinesContext(int width, int height){
+  this->width = width;
+  this->height = height;
+
+  ed = new EDContext(width, height);
+
+  maxPixels = (width+height)*8;
+  x = new double[maxPixels];
+  y = new double[maxPixels];
+
+  maxLines = (width+height)*4;
+  lines = new LineSegment[maxLines];
+  noLines = 0;
+
+  srcImg = NULL;
+
+  rectX = new int[(width+height)*4];
+  rectY = new int[(width+height)*4];
+
+  double logNT = 2.0*(log10((double)width) + log10((double)height));
+  LUT = new NFALUT((width+height)/8, ALIGN_PROB, logNT);
+
+  minLineLen = ComputeMinLineLength(width, height);
+  if (minLineLen < 9) minLineLen = 9;
+  lineError = LINE_ERROR;
+} //end-EDLinesContext
+
+///-------------------------------------------------------------------------------
+/// Destructor
+///
+EDLinesContext::~EDLinesContext(){
+  delete ed;
+
+  delete[] x;
+  delete[] y;
+  delete[] lines;
+  delete[] rectX;
+  delete[] rectY;
+  delete LUT;
+} //end-~EDLinesContext
+
+///-------------------------------------------------------------------------------
+/// Appends a line segment, doubling the buffer if it is full
+///
+static void AddLine(EDLinesContext *ctx, double a, double b, int invert, double sx, double sy, double ex, double ey, int segmentNo, int firstPixelIndex, int len){
+  if (ctx->noLines == ctx->maxLines){
+    LineSegment *lines = new LineSegment[ctx->maxLines*2];
+    memcpy(lines, ctx->lines, sizeof(LineSegment)*ctx->noLines);
+    delete[] ctx->lines;
+
+    ctx->lines = lines;
+    ctx->maxLines *= 2;
+  } //end-if
+
+  LineSegment *ls = &ctx->lines[ctx->noLines++];
+  ls->a = a;
+  ls->b = b;
+  ls->invert = invert;
+  ls->sx = sx;
+  ls->sy = sy;
+  ls->ex = ex;
+  ls->ey = ey;
+  ls->segmentNo = segmentNo;
+  ls->firstPixelIndex = firstPixelIndex;
+  ls->len = len;
+  ls->noPoints = ls->noAligned = 0;
+} //end-AddLine
+
+///-------------------------------------------------------------------------------
+/// Walks along the pixels of an edge segment & cuts it into line segments: a line starts at the first
+/// minLineLen pixels that fit a line & grows while the next pixels stay within LINE_ERROR of it.
+/// The fits come from running sums, so a line costs O(1) per pixel however long it grows; the distances
+/// of the pixels ahead of it are computed DISTANCE_BLOCK at a time
+///
+static void SplitSegment2Lines(EDLinesContext *ctx, double *x, double *y, int noPixels, int segmentNo){
+  int minLineLen = ctx->minLineLen;
+  double lineError = ctx->lineError;
+
+  // First pixel of the line segment within the edge segment
+  int firstPixelIndex = 0;
+
+  LineFitSums sums;
+  double dist[DISTANCE_BLOCK];
+
+  while (noPixels >= minLineLen){
+    // Start by fitting a line to minLineLen pixels, sliding them along until they fit
+    bool valid = false;
+    double lastA, lastB, error;
+    int lastInvert;
+
+    ResetLineFitSums(&sums);
+    for (int k=0; k<minLineLen; k++) AddLineFitPoint(&sums, x[k], y[k]);
+
+    while (noPixels >= minLineLen){
+      LineFit(&sums, x, y, minLineLen, &lastA, &lastB, &error, &lastInvert);
+      if (error <= MAX_INITIAL_FIT_ERROR){valid = true; break;}
+
+      // Skip a pixel & try again
+      RemoveLineFitPoint(&sums, x[0], y[0]);
+      noPixels -= 1;
+      x += 1; y += 1;
+      firstPixelIndex += 1;
+
+      if (noPixels >= minLineLen) AddLineFitPoint(&sums, x[minLineLen-1], y[minLineLen-1]);
+    } //end-while
+
+    if (valid == false) return;
+
+    // Now, try to extend this line segment
+    int index = minLineLen;
+    int len = minLineLen;
+
+    while (index < noPixels){
+      int startIndex = index;
+      int lastGoodIndex = index-1;
+      int goodPixelCount = 0;
+      int badPixelCount = 0;
+
+      // Distances to the current line of the pixels [blockStart, blockEnd)
+      int blockStart = index, blockEnd = index;
+
+      while (index < noPixels){
+        if (index == blockEnd){
+          blockStart = index;
+          blockEnd = index + DISTANCE_BLOCK < noPixels ? index + DISTANCE_BLOCK : noPixels;
+          ComputeMinDistances(x+blockStart, y+blockStart, blockEnd-blockStart, lastA, lastB, lastInvert, dist);
+        } //end-if
+
+        double d = dist[index-blockStart];
+
+        if (d <= lineError){
+          lastGoodIndex = index;
+          goodPixelCount++;
+          badPixelCount = 0;
+
+        } else {
+          badPixelCount++;
+          if (badPixelCount >= MAX_BAD_PIXELS) break;
+        } //end-else
+
+        index++;
+      } //end-while
+
+      if (goodPixelCount >= 2){
+        // Refit the line to the pixels so far: add the new ones to the sums
+        for (int k=startIndex; k<=lastGoodIndex; k++) AddLineFitPoint(&sums, x[k], y[k]);
+        len += lastGoodIndex - startIndex + 1;
+
+        LineFit(&sums, &lastA, &lastB, lastInvert);
+        index = lastGoodIndex+1;
+      } //end-if
+
+      if (goodPixelCount < 2 || index >= noPixels){
+        // End of the line segment: its end points are the projections of its first & last pixels on the line
+        double sx, sy, ex, ey;
+
+        int index = 0;
+        while (ComputeMinDistance(x[index], y[index], lastA, lastB, lastInvert) > lineError) index++;
+        ComputeClosestPoint(x[index], y[index], lastA, lastB, lastInvert, &sx, &sy);
+        int noSkippedPixels = index;
+
+        index = lastGoodIndex;
+        while (ComputeMinDistance(x[index], y[index], lastA, lastB, lastInvert) > lineError) index--;
+        ComputeClosestPoint(x[index], y[index], lastA, lastB, lastInvert, &ex, &ey);
+
+        AddLine(ctx, lastA, lastB, lastInvert, sx, sy, ex, ey, segmentNo, firstPixelIndex+noSkippedPixels, index-noSkippedPixels+1);
+
+        len = index+1;
+        break;
+      } //end-if
+    } //end-while
+
+    noPixels -= len;
+    x += len;
+    y += len;
+    firstPixelIndex += len;
+  } //end-while
+} //end-SplitSegment2Lines
+
+///-------------------------------------------------------------------------------
+/// Joins the collinear line segments of each edge segment that are next to each other, the last one
+/// with the first one as well for closed edge segments
+///
+static void JoinCollinearLines(EDLinesContext *ctx, double MAX_DISTANCE_BETWEEN_TWO_LINES, double MAX_ERROR){
+  LineSegment *lines = ctx->lines;
+  int lastLineIndex = -1;
+
+  int i = 0;
+  while (i < ctx->noLines){
+    int segmentNo = lines[i].segmentNo;
+
+    lastLineIndex++;
+    if (lastLineIndex != i) lines[lastLineIndex] = lines[i];
+
+    int firstLineIndex = lastLineIndex;     // First line of this edge segment
+
+    int count = 1;
+    for (int j=i+1; j<ctx->noLines; j++){
+      if (lines[j].segmentNo != segmentNo) break;
+
+      // Try to combine this line with the previous one
+      if (TryToJoinTwoLineSegments(&lines[lastLineIndex], &lines[j], MAX_DISTANCE_BETWEEN_TWO_LINES, MAX_ERROR) == false){
+        lastLineIndex++;
+        if (lastLineIndex != j) lines[lastLineIndex] = lines[j];
+      } //end-if
+
+      count++;
+    } //end-for
+
+    // Try to join the first & last line of this edge segment
+    if (firstLineIndex != lastLineIndex){
+      if (TryToJoinTwoLineSegments(&lines[firstLineIndex], &lines[lastLineIndex], MAX_DISTANCE_BETWEEN_TWO_LINES, MAX_ERROR)) lastLineIndex--;
+    } //end-if
+
+    i += count;
+  } //end-while
+
+  ctx->noLines = lastLineIndex+1;
+} //end-JoinCollinearLines
+
+///-------------------------------------------------------------------------------
+/// Fast arctan of yy/xx in [0, PI] from a 1025 entry table of atan over [0, 1]
+///
+struct AtanLUT {
+  double LUT[1025];
+
+  AtanLUT(){
+    for (int i=0; i<=1024; i++) LUT[i] = atan(i*(1.0/1024.0));
+  } //end-AtanLUT
+};
+
+static double myAtan2(double yy, double xx){
+  static const AtanLUT atanLUT;         // Built at the first call, once for all the threads
+
+  double y = fabs(yy);
+  double x = fabs(xx);
+
+  if (x < 1e-10){
+    if (y < 1e-10) return 0.0;
+    return M_PI/2;
+  } //end-if
+
+  bool invert = false;
+  if (y > x){
+    double t = x; x = y; y = t;
+    invert = true;
+  } //end-if
+
+  double angle = atanLUT.LUT[(int)((y/x)*1024)];
+
+  if ((xx >= 0 && yy >= 0) || (xx < 0 && yy < 0)){
+    if (invert) angle = M_PI/2 - angle;
+
+  } else {
+    if (invert) angle = M_PI/2 + angle;
+    else        angle = M_PI - angle;
+  } //end-else
+
+  return angle;
+} //end-myAtan2
+
+///-------------------------------------------------------------------------------
+/// Angle of the line in [0, PI)
+///
+static double ComputeLineAngle(LineSegment *ls){
+  double lineAngle;
+  if (ls->invert) lineAngle = atan(1.0/ls->b);
+  else            lineAngle = atan(ls->b);
+
+  if (lineAngle < 0) lineAngle += M_PI;
+
+  return lineAngle;
+} //end-ComputeLineAngle
+
+///-------------------------------------------------------------------------------
+/// Is the Prewitt gradient of srcImg at (r, c) aligned with the line, i.e. within PI/8 of its angle?
+///
+static inline bool IsAligned(unsigned char *srcImg, int width, int r, int c, double lineAngle){
+  int com1 = srcImg[(r+1)*width+c+1] - srcImg[(r-1)*width+c-1];
+  int com2 = srcImg[(r-1)*width+c+1] - srcImg[(r+1)*width+c-1];
+
+  int gx = com1 + com2 + srcImg[r*width+c+1] - srcImg[r*width+c-1];
+  int gy = com1 - com2 + srcImg[(r+1)*width+c] - srcImg[(r-1)*width+c];
+
+  double pixelAngle = myAtan2((double)gx, (double)-gy);
+  double diff = fabs(lineAngle - pixelAngle);
+
+  return diff <= M_PI/8 || diff >= M_PI - M_PI/8;
+} //end-IsAligned
+
+///-------------------------------------------------------------------------------
+/// The integer points within the 2 pixel wide rectangle along the line segment (sx, sy)-(ex, ey), column by
+/// column. Returns their # in pNoPoints
+///
+static void EnumerateRectPoints(double sx, double sy, double ex, double ey, int ptsx[], int ptsy[], int *pNoPoints){
+  double vxTmp[4], vyTmp[4];
+  double vx[4], vy[4];
+  int n, offset;
+
+  double x1 = sx;
+  double y1 = sy;
+  double x2 = ex;
+  double y2 = ey;
+  double width = 2;
+
+  double dx = x2 - x1;
+  double dy = y2 - y1;
+  double vLen = sqrt(dx*dx + dy*dy);
+
+  // make unit vector
+  dx = dx/vLen;
+  dy = dy/vLen;
+
+  // Corners of the rectangle
+  vxTmp[0] = x1 - dy*width/2.0;
+  vyTmp[0] = y1 + dx*width/2.0;
+  vxTmp[1] = x2 - dy*width/2.0;
+  vyTmp[1] = y2 + dx*width/2.0;
+  vxTmp[2] = x2 + dy*width/2.0;
+  vyTmp[2] = y2 - dx*width/2.0;
+  vxTmp[3] = x1 + dy*width/2.0;
+  vyTmp[3] = y1 - dx*width/2.0;
+
+  // Start with the leftmost corner & go counter clockwise
+  if      (x1 < x2 && y1 <= y2) offset = 0;
+  else if (x1 >= x2 && y1 < y2) offset = 1;
+  else if (x1 > x2 && y1 >= y2) offset = 2;
+  else                          offset = 3;
+
+  for (n=0; n<4; n++){
+    vx[n] = vxTmp[(offset+n)%4];
+    vy[n] = vyTmp[(offset+n)%4];
+  } //end-for
+
+  // Go column by column from the leftmost corner, each column from ys up to ye
+  int x = (int)ceil(vx[0]) - 1;
+  int y = (int)ceil(vy[0]);
+  double ys = -DBL_MAX, ye = -DBL_MAX;
+
+  int noPoints = 0;
+  int maxNoOfPoints = (int)(fabs(sx-ex) + fabs(sy-ey))*4;
+
+  while (noPoints < maxNoOfPoints){
+    y++;
+
+    // Next column
+    while (y > ye && x <= vx[2]){
+      x++;
+      if (x > vx[2]) break;
+
+      // Lower end of the column
+      if ((double)x < vx[3]){
+        if (fabs(vx[0] - vx[3]) <= 0.01){
+          if      (vy[0] < vy[3]) ys = vy[0];
+          else if (vy[0] > vy[3]) ys = vy[3];
+          else                    ys = vy[0] + (x - vx[0])*(vy[3] - vy[0])/(vx[3] - vx[0]);
+
+        } else {
+          ys = vy[0] + (x - vx[0])*(vy[3] - vy[0])/(vx[3] - vx[0]);
+        } //end-else
+
+      } else {
+        if (fabs(vx[3] - vx[2]) <= 0.01){
+          if      (vy[3] < vy[2]) ys = vy[3];
+          else if (vy[3] > vy[2]) ys = vy[2];
+          else                    ys = vy[3] + (x - vx[3])*(y2 - vy[3])/(vx[2] - vx[3]);
+
+        } else {
+          ys = vy[3] + (x - vx[3])*(vy[2] - vy[3])/(vx[2] - vx[3]);
+        } //end-else
+      } //end-else
+
+      // Upper end of the column
+      if ((double)x < vx[1]){
+        if (fabs(vx[0] - vx[1]) <= 0.01){
+          if      (vy[0] < vy[1]) ye = vy[1];
+          else if (vy[0] > vy[1]) ye = vy[0];
+          else                    ye = vy[0] + (x - vx[0])*(vy[1] - vy[0])/(vx[1] - vx[0]);
+
+        } else {
+          ye = vy[0] + (x - vx[0])*(vy[1] - vy[0])/(vx[1] - vx[0]);
+        } //end-else
+
+      } else {
+        if (fabs(vx[1] - vx[2]) <= 0.01){
+          if      (vy[1] < vy[2]) ye = vy[2];
+          else if (vy[1] > vy[2]) ye = vy[1];
+          else                    ye = vy[1] + (x - vx[1])*(vy[2] - vy[1])/(vx[2] - vx[1]);
+
+        } else {
+          ye = vy[1] + (x - vx[1])*(vy[2] - vy[1])/(vx[2] - vx[1]);
+        } //end-else
+      } //end-else
+
+      y = (int)ceil(ys);
+    } //end-while
+
+    // Are we done?
+    if (x > vx[2]) break;
+
+    ptsx[noPoints] = x;
+    ptsy[noPoints] = y;
+    noPoints++;
+  } //end-while
+
+  *pNoPoints = noPoints;
+} //end-EnumerateRectPoints
+
+///-------------------------------------------------------------------------------
+/// Validates the line segment over the points of the rectangle along it
+///
+static bool ValidateLineSegmentRect(EDLinesContext *ctx, unsigned char *srcImg, LineSegment *ls){
+  int width = ctx->width;
+  int height = ctx->height;
+  int *x = ctx->rectX;
+  int *y = ctx->rectY;
+
+  double lineAngle = ComputeLineAngle(ls);
+
+  int noPoints = 0;
+  EnumerateRectPoints(ls->sx, ls->sy, ls->ex, ls->ey, x, y, &noPoints);
+
+  int count = 0;
+  int aligned = 0;
+  for (int i=0; i<noPoints; i++){
+    int r = y[i];
+    int c = x[i];
+
+    if (r <= 0 || r >= height-1) continue;
+    if (c <= 0 || c >= width-1) continue;
+
+    count++;
+    if (IsAligned(srcImg, width, r, c, lineAngle)) aligned++;
+  } //end-for
+
+  ls->noPoints = count;
+  ls->noAligned = aligned;
+
+  return checkValidationByNFA(count, aligned, ctx->LUT);
+} //end-ValidateLineSegmentRect
+
+///-------------------------------------------------------------------------------
+/// Counts the pixels of the line segment off the image border & those of them whose gradient is aligned with it
+///
+static void CountAlignedPixels(EDLinesContext *ctx, EdgeMap *map, unsigned char *srcImg, LineSegment *ls){
+  int width = ctx->width;
+  int height = ctx->height;
+
+  double lineAngle = ComputeLineAngle(ls);
+  Pixel *pixels = &map->segments[ls->segmentNo].pixels[ls->firstPixelIndex];
+
+  int count = 0;
+  int aligned = 0;
+  for (int j=0; j<ls->len; j++){
+    int r = pixels[j].r;
+    int c = pixels[j].c;
+
+    if (r <= 0 || r >= height-1) continue;
+    if (c <= 0 || c >= width-1) continue;
+
+    count++;
+    if (IsAligned(srcImg, width, r, c, lineAngle)) aligned++;
+  } //end-for
+
+  ls->noPoints = count;
+  ls->noAligned = aligned;
+} //end-CountAlignedPixels
+
+///-------------------------------------------------------------------------------
+/// Keeps the line segments whose pixels have enough gradients aligned with them by the NFA. Long lines
+/// are kept as they are. Lines that fail over their own pixels get a second chance over their rectangle
+///
+static void ValidateLineSegments(EDLinesContext *ctx, EdgeMap *map, unsigned char *srcImg){
+  PROFILE_STAGE("ValidateLineSegments");
+
+  int noValidLines = 0;
+  for (int i=0; i<ctx->noLines; i++){
+    LineSegment *ls = &ctx->lines[i];
+
+    bool valid = false;
+    if (ls->len >= LONG_LINE_LEN){
+      valid = true;
+
+    } else if (ls->len >= MIN_PIXEL_VALIDATION_LEN){
+      CountAlignedPixels(ctx, map, srcImg, ls);
+      valid = checkValidationByNFA(ls->noPoints, ls->noAligned, ctx->LUT);
+    } //end-else
+
+    if (valid == false) valid = ValidateLineSegmentRect(ctx, srcImg, ls);
+
+    if (valid){
+      if (i != noValidLines) ctx->lines[noValidLines] = *ls;
+      noValidLines++;
+    } //end-if
+  } //end-for
+
+  ctx->noLines = noValidLines;
+} //end-ValidateLineSegments
+
+///-------------------------------------------------------------------------------
+/// Detects the line segments of srcImg. Returns their #
+///
+int EDLinesContext::DetectLines(unsigned char *srcImg){
+  PROFILE_STAGE("EDLines");
+
+  this->srcImg = srcImg;
+
+  // Edge segments by ED over the LSD gradient
+  EdgeMap *map = ed->DetectEdgesByED(srcImg, LSD_OPERATOR, EDLINES_GRADIENT_THRESH, EDLINES_ANCHOR_THRESH, 1.0);
+
+  // Cut the edge segments into line segments
+  noLines = 0;
+  for (int i=0; i<map->noSegments; i++){
+    EdgeSegment *segment = &map->segments[i];
+
+    if (segment->noPixels > maxPixels){
+      delete[] x;
+      delete[] y;
+
+      maxPixels = segment->noPixels;
+      x = new double[maxPixels];
+      y = new double[maxPixels];
+    } //end-if
+
+    for (int k=0; k<segment->noPixels; k++){
+      x[k] = segment->pixels[k].c;
+      y[k] = segment->pixels[k].r;
+    } //end-for
+
+    SplitSegment2Lines(this, x, y, segment->noPixels, i);
+  } //end-for
+
+  JoinCollinearLines(this, MAX_JOIN_DISTANCE, MAX_JOIN_ERROR);
+  ValidateLineSegments(this, map, srcImg);
+
+  return noLines;
+} //end-DetectLines
+
+///-------------------------------------------------------------------------------
+/// Copies the end points of the line segments of the last call
+///
+void EDLinesContext::GetLines(LS *out){
+  for (int i=0; i<noLines; i++){
+    out[i].sx = lines[i].sx;
+    out[i].sy = lines[i].sy;
+    out[i].ex = lines[i].ex;
+    out[i].ey = lines[i].ey;
+  } //end-for
+} //end-GetLines
+
+///-------------------------------------------------------------------------------
+/// Writes the first out->maxLines line segments of the last call as floats to the arrays of out that are set.
+/// Returns the # of line segments, which may be more than out->maxLines
+///
+int EDLinesContext::GetLines(LSArrays *out){
+  int n = noLines < out->maxLines ? noLines : out->maxLines;
+
+  for (int i=0; i<n; i++){
+    LineSegment *ls = &lines[i];
+
+    out->sx[i] = (float)ls->sx;
+    out->sy[i] = (float)ls->sy;
+    out->ex[i] = (float)ls->ex;
+    out->ey[i] = (float)ls->ey;
+
+    if (out->a) out->a[i] = (float)ls->a;
+    if (out->b) out->b[i] = (float)ls->b;
+    if (out->invert) out->invert[i] = (unsigned char)ls->invert;
+
+    if (out->length){
+      double dx = ls->ex - ls->sx;
+      double dy = ls->ey - ls->sy;
+      out->length[i] = (float)sqrt(dx*dx + dy*dy);
+    } //end-if
+
+    if (out->nfa){
+      // Long lines were kept without a test: count their aligned pixels now
+      if (ls->noPoints == 0) CountAlignedPixels(this, ed->map, srcImg, ls);
+      out->nfa[i] = (float)nfa(ls->noPoints, ls->noAligned, LUT->prob, LUT->logNT);
+    } //end-if
+  } //end-for
+
+  return noLines;
+} //end-GetLines
+
+///-------------------------------------------------------------------------------
+/// Detects the line segments of srcImg & writes them to out as GetLines does. Returns their #
+///
+int EDLinesContext::DetectLines(unsigned char *srcImg, LSArrays *out){
+  DetectLines(srcImg);
+  return GetLines(out);
+} //end-DetectLines
+
+///-------------------------------------------------------------------------------
+/// No arrays & no room: set the ones wanted
+///
+LSArrays::LSArrays(){
+  sx = sy = ex = ey = NULL;
+  a = b = NULL;
+  invert = NULL;
+  length = NULL;
+  nfa = NULL;
+  maxLines = 0;
+} //end-LSArrays
+
+///===================================== Single shot API =========================================
+/// Runs a temporary context. Returns NULL if there are no line segments
+///
+LS *DetectLinesByED(unsigned char *srcImg, int width, int height, int *pNoLines){
+  EDLinesContext ctx(width, height);
+  int noLines = ctx.DetectLines(srcImg);
+
+  *pNoLines = noLines;
+  if (noLines == 0) return NULL;
+
+  LS *lines = new LS[noLines];
+  ctx.GetLines(lines);
+
+  return lines;
+} //end-DetectLinesByED
+
+int DetectLinesByED(unsigned char *srcImg, int width, int height, LSArrays *out){
+  EDLinesContext ctx(width, height);
+  return ctx.DetectLines(srcImg, out);
+} //end-DetectLinesByED
@@ -0,0 +1,95 @@
+#ifndef _EDLINES_INTERNALS_H_
+#define _EDLINES_INTERNALS_H_
+
+#include "EdgeMap.h"
+
+#define SOUTH_SOUTH 0
+#define SOUTH_EAST  1
+#define EAST_SOUTH  2
+#define EAST_EAST   3
+
+/// A line segment fitted to a run of the pixels of an edge segment. The line is y = a + bx, or x = a + by if inverted
+struct LineSegment {
+  double a, b;              // Line equation
+  int invert;               // 1 if the line is x = a + by
+
+  double sx, sy;            // Start point
+  double ex, ey;            // End point
+
+  int segmentNo;            // Edge segment the line segment comes from
+  int firstPixelIndex;      // Index of the first pixel of the line segment within the edge segment
+  int len;                  // # of pixels of the edge segment making up the line segment
+
+  int noPoints, noAligned;  // Points & aligned points of the NFA test that validated the line segment (0 if untested)
+};
+
+/// The fewest aligned points out of n that make a line segment meaningful, for the n < LUTSize
+struct NFALUT {
+  int *LUT;
+  int LUTSize;
+
+  double prob;              // Probability of a point being aligned
+  double logNT;             // log10 of the # of tests
+
+  NFALUT(int size, double prob, double logNT);
+  ~NFALUT();
+};
+
+/// -log10(NFA) of n points having k aligned ones with probability p each. Meaningful if >= 0
+double nfa(int n, int k, double p, double logNT);
+
+/// Are k aligned points out of n meaningful?
+bool checkValidationByNFA(int n, int k, NFALUT *lut);
+
+/// Running sums of the points a line is fitted to. A point is added or removed in O(1). With integer coordinates
+/// the sums are exact, so they do not depend on the order the points come & go in
+struct LineFitSums {
+  double S;                 // # of points
+  double Sx, Sy;
+  double Sxx, Sxy, Syy;
+};
+
+inline void ResetLineFitSums(LineFitSums *sums){
+  sums->S = sums->Sx = sums->Sy = sums->Sxx = sums->Sxy = sums->Syy = 0.0;
+} //end-ResetLineFitSums
+
+inline void AddLineFitPoint(LineFitSums *sums, double x, double y){
+  sums->S += 1.0;
+  sums->Sx += x;
+  sums->Sy += y;
+  sums->Sxx += x*x;
+  sums->Sxy += x*y;
+  sums->Syy += y*y;
+} //end-AddLineFitPoint
+
+inline void RemoveLineFitPoint(LineFitSums *sums, double x, double y){
+  sums->S -= 1.0;
+  sums->Sx -= x;
+  sums->Sy -= y;
+  sums->Sxx -= x*x;
+  sums->Sxy -= x*y;
+  sums->Syy -= y*y;
+} //end-RemoveLineFitPoint
+
+/// Least squares fit of the points of the sums. The second one picks the orientation of the line & returns the
+/// fitting error of the "count" points (x[i], y[i]) the sums are made of
+void LineFit(LineFitSums *sums, double *a, double *b, int invert);
+void LineFit(LineFitSums *sums, double *x, double *y, int count, double *a, double *b, double *e, int *invert);
+
+/// Distance of (x1, y1) to the line & the point of the line closest to it
+double ComputeMinDistance(double x1, double y1, double a, double b, int invert);
+void ComputeClosestPoint(double x1, double y1, double a, double b, int invert, double *xOut, double *yOut);
+
+/// The distances of n points to the line at once: d[i] = ComputeMinDistance(x[i], y[i], a, b, invert), bit for bit
+void ComputeMinDistances(const double *x, const double *y, int n, double a, double b, int invert, double *d);
+
+/// The shortest distance between the end points of 2 line segments & which end points they are
+double ComputeMinDistanceBetweenTwoLines(LineSegment *ls1, LineSegment *ls2, int *pwhich);
+
+/// Sets the line equation from the end points
+void UpdateLineParameters(LineSegment *ls);
+
+/// Joins ls2 into ls1 if they are collinear & close enough. Returns true if they are joined
+bool TryToJoinTwoLineSegments(LineSegment *ls1, LineSegment *ls2, double MAX_DISTANCE_BETWEEN_TWO_LINES, double MAX_ERROR);
+
+#endif
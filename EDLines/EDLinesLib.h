@@ -0,0 +1,139 @@
+#ifndef _EDLINESLIB_H_
+#define _EDLINESLIB_H_
+
+#include "LS.h"
+
+/// Detect line segments by EDLines. Steps of the algorithm:
+/// (1) Detect the edge segments by ED over the LSD gradient (GRADIENT_THRESH=11, ANCHOR_THRESH=3, smoothingSigma=1.0)
+/// (2) Cut the edge segments into line segments by least squares line fitting & join the collinear ones
+/// (3) Keep the line segments validated by the Helmholtz principle (NFA)
+/// Returns an array of *pNoLines line segments, which the caller must delete[], or NULL if there are none
+LS *DetectLinesByED(unsigned char *srcImg, int width, int height, int *pNoLines);
+
+///------------------------------------------------------------------------------------
+/// Line segments as float arrays, one per field, in buffers of the caller: line i is (sx[i], sy[i])-(ex[i], ey[i]).
+/// The end points are required; leave the other arrays NULL unless they are wanted. maxLines is the room in each.
+///
+struct LSArrays {
+public:
+  float *sx, *sy, *ex, *ey;   // End points
+  float *a, *b;               // Fitted line: y = a + bx, or x = a + by if invert[i]
+  unsigned char *invert;
+  float *length;              // Distance between the end points
+  float *nfa;                 // -log10(NFA) of the aligned gradients along the line: the greater the more meaningful.
+                              // >= 0 but for lines of 80+ pixels, which are kept without the test
+  int maxLines;
+
+public:
+  // constructor: all NULL, maxLines = 0
+  LSArrays();
+};
+
+/// DetectLinesByED into the arrays of out. Only the first out->maxLines line segments are written; the
+/// returned # of line segments may be more
+int DetectLinesByED(unsigned char *srcImg, int width, int height, LSArrays *out);
+
+struct EDContext;
+struct LineSegment;
+struct NFALUT;
+struct ThreadPool;
+
+///------------------------------------------------------------------------------------
+/// Working memory of EDLines for one image resolution: the ED context, the pixels of an edge segment,
+/// the line segments & the NFA table. After the first frame, detecting lines only touches the heap
+/// if a frame has more line segments or a longer edge segment than any before it.
+///
+struct EDLinesContext {
+public:
+  int width, height;
+
+  EDContext *ed;              // Edge segments
+
+  double *x, *y;              // Coordinates of the pixels of the edge segment being split
+  int maxPixels;
+
+  LineSegment *lines;         // Line segments of the last call
+  int noLines, maxLines;
+
+  int *rectX, *rectY;         // Points of the rectangle along a line segment being validated
+  NFALUT *LUT;                // Fewest aligned points for a meaningful line segment, by length
+
+  int minLineLen;             // Shortest line segment for the image size
+  double lineError;           // Farthest a pixel can be from its line segment
+
+  unsigned char *srcImg;      // Image of the last call
+
+public:
+  // constructor
+  EDLinesContext(int width, int height);
+
+  // Destructor
+  ~EDLinesContext();
+
+  // Detects the line segments of srcImg into lines. Returns their #
+  int DetectLines(unsigned char *srcImg);
+
+  // Copies the end points of the noLines line segments of the last call to out
+  void GetLines(LS *out);
+
+  // Detects the line segments of srcImg into the arrays of out. Returns their #, which may be more than out->maxLines
+  int DetectLines(unsigned char *srcImg, LSArrays *out);
+
+  // Writes the line segments of the last call to out, e.g. again after growing its arrays. The NFA scores read
+  // the image of the last call, so it must still be there. Returns their #
+  int GetLines(LSArrays *out);
+};
+
+///------------------------------------------------------------------------------------
+/// Line segments of a batch of images in one buffer: those of image k are lines[offsets[k]..offsets[k+1]).
+/// Reuse the same batch from call to call: the buffers only grow when a batch needs more room.
+///
+struct LSBatch {
+public:
+  LS *lines;
+  int *offsets;               // noImages+1 offsets into lines
+  int noImages, noLines;
+  int maxImages, maxLines;
+
+public:
+  // constructor
+  LSBatch();
+
+  // Destructor
+  ~LSBatch();
+};
+
+///------------------------------------------------------------------------------------
+/// EDLines over batches of images by numThreads persistent threads (the calling thread being one of them).
+/// The threads take the images one at a time, each with an EDLinesContext & a line buffer of its own that
+/// outlive the call, so a run of same sized frames neither spawns threads nor allocates once warmed up.
+/// A thread's context is recreated when its next image has another resolution.
+/// The result is the same as DetectLinesByED on each image, for any numThreads.
+///
+struct EDLinesPool {
+public:
+  int numThreads;
+
+  EDLinesContext **contexts;  // Per thread
+  LS **arenas;                // Per thread: line segments of the images it detected in the current batch
+  int *arenaLines, *maxArenaLines;
+
+  int *imageThreads;          // Per image of the current batch: thread that detected it & where its lines are in the thread's arena
+  int *imageStarts;
+  int maxImages;
+
+  ThreadPool *threads;        // Threads 1..numThreads-1
+
+public:
+  // constructor
+  EDLinesPool(int numThreads);
+
+  // Destructor
+  ~EDLinesPool();
+
+  // Detects the line segments of the noImages images srcImgs[k] of widths[k] x heights[k] pixels into batch.
+  // Returns the total # of line segments
+  int DetectLines(unsigned char **srcImgs, int *widths, int *heights, int noImages, LSBatch *batch);
+};
+
+#endif
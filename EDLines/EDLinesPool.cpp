@@ -0,0 +1,200 @@
+/**************************************************************************************************************
+ * EDLines over batches of images by a pool of persistent threads
+ **************************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "EDLinesLib.h"
+#include "EDInternals.h"
+
+///-------------------------------------------------------------------------------
+/// The images of a batch & where they are at
+///
+struct BatchJob {
+  EDLinesPool *pool;
+  unsigned char **srcImgs;
+  int *widths, *heights;
+  int noImages;
+  int next;                   // Next image to detect
+  LSBatch *batch;
+};
+
+///-------------------------------------------------------------------------------
+/// Step 1: thread t detects the next image until there are none left & appends its line segments to its arena.
+/// batch->offsets[k+1] gets image k's # of line segments
+///
+static void DetectJob(int t, void *arg){
+  BatchJob *job = (BatchJob *)arg;
+  EDLinesPool *pool = job->pool;
+
+  int k;
+  while ((k = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->noImages){
+    int width = job->widths[k];
+    int height = job->heights[k];
+
+    EDLinesContext *ctx = pool->contexts[t];
+    if (ctx == NULL || ctx->width != width || ctx->height != height){
+      delete ctx;
+      ctx = pool->contexts[t] = new EDLinesContext(width, height);
+    } //end-if
+
+    int noLines = ctx->DetectLines(job->srcImgs[k]);
+
+    // Room in the arena
+    int used = pool->arenaLines[t];
+    if (used + noLines > pool->maxArenaLines[t]){
+      int size = pool->maxArenaLines[t]*2;
+      if (size < used + noLines) size = used + noLines;
+
+      LS *arena = new LS[size];
+      if (used > 0) memcpy(arena, pool->arenas[t], sizeof(LS)*used);
+      delete[] pool->arenas[t];
+
+      pool->arenas[t] = arena;
+      pool->maxArenaLines[t] = size;
+    } //end-if
+
+    ctx->GetLines(pool->arenas[t] + used);
+    pool->arenaLines[t] = used + noLines;
+
+    pool->imageThreads[k] = t;
+    pool->imageStarts[k] = used;
+    job->batch->offsets[k+1] = noLines;
+  } //end-while
+} //end-DetectJob
+
+///-------------------------------------------------------------------------------
+/// Step 2: thread t copies the line segments of its share of the images from the arenas to the batch
+///
+static void GatherJob(int t, void *arg){
+  BatchJob *job = (BatchJob *)arg;
+  EDLinesPool *pool = job->pool;
+  LSBatch *batch = job->batch;
+
+  int first = (int)((long long)t*job->noImages/pool->numThreads);
+  int last = (int)((long long)(t+1)*job->noImages/pool->numThreads);
+
+  for (int k=first; k<last; k++){
+    int noLines = batch->offsets[k+1] - batch->offsets[k];
+    memcpy(batch->lines + batch->offsets[k], pool->arenas[pool->imageThreads[k]] + pool->imageStarts[k], sizeof(LS)*noLines);
+  } //end-for
+} //end-GatherJob
+
+///-------------------------------------------------------------------------------
+/// Starts the numThreads-1 workers. The contexts are created by the first images
+///
+EDLinesPool::EDLinesPool(int numThreads){
+  if (numThreads < 1) numThreads = 1;
+  this->numThreads = numThreads;
+
+  contexts = new EDLinesContext *[numThreads];
+  arenas = new LS *[numThreads];
+  arenaLines = new int[numThreads];
+  maxArenaLines = new int[numThreads];
+  for (int t=0; t<numThreads; t++){
+    contexts[t] = NULL;
+    arenas[t] = NULL;
+    arenaLines[t] = 0;
+    maxArenaLines[t] = 0;
+  } //end-for
+
+  imageThreads = NULL;
+  imageStarts = NULL;
+  maxImages = 0;
+
+  threads = new ThreadPool(numThreads);
+} //end-EDLinesPool
+
+///-------------------------------------------------------------------------------
+/// Destructor. Stops the workers
+///
+EDLinesPool::~EDLinesPool(){
+  delete threads;
+
+  for (int t=0; t<numThreads; t++){
+    delete contexts[t];
+    delete[] arenas[t];
+  } //end-for
+
+  delete[] contexts;
+  delete[] arenas;
+  delete[] arenaLines;
+  delete[] maxArenaLines;
+  delete[] imageThreads;
+  delete[] imageStarts;
+} //end-~EDLinesPool
+
+///-------------------------------------------------------------------------------
+/// Detects the images by the threads of the pool, then lays their line segments out in image order
+///
+int EDLinesPool::DetectLines(unsigned char **srcImgs, int *widths, int *heights, int noImages, LSBatch *batch){
+  if (noImages < 0) noImages = 0;
+
+  if (noImages > maxImages){
+    delete[] imageThreads;
+    delete[] imageStarts;
+
+    maxImages = noImages;
+    imageThreads = new int[maxImages];
+    imageStarts = new int[maxImages];
+  } //end-if
+
+  if (noImages > batch->maxImages){
+    delete[] batch->offsets;
+
+    batch->maxImages = noImages;
+    batch->offsets = new int[batch->maxImages+1];
+  } //end-if
+
+  for (int t=0; t<numThreads; t++) arenaLines[t] = 0;
+
+  BatchJob job;
+  job.pool = this;
+  job.srcImgs = srcImgs;
+  job.widths = widths;
+  job.heights = heights;
+  job.noImages = noImages;
+  job.next = 0;
+  job.batch = batch;
+
+  RunThreads(threads, numThreads, DetectJob, &job);
+
+  // Offsets of the images in the batch
+  batch->offsets[0] = 0;
+  for (int k=0; k<noImages; k++) batch->offsets[k+1] += batch->offsets[k];
+
+  batch->noImages = noImages;
+  batch->noLines = batch->offsets[noImages];
+
+  if (batch->noLines > batch->maxLines){
+    delete[] batch->lines;
+
+    batch->maxLines = batch->noLines;
+    batch->lines = new LS[batch->maxLines];
+  } //end-if
+
+  RunThreads(threads, numThreads, GatherJob, &job);
+
+  return batch->noLines;
+} //end-DetectLines
+
+///-------------------------------------------------------------------------------
+/// An empty batch. The pool sizes it
+///
+LSBatch::LSBatch(){
+  lines = NULL;
+  offsets = new int[1];
+  offsets[0] = 0;
+
+  noImages = noLines = 0;
+  maxImages = maxLines = 0;
+} //end-LSBatch
+
+///-------------------------------------------------------------------------------
+/// Destructor
+///
+LSBatch::~LSBatch(){
+  delete[] lines;
+  delete[] offsets;
+} //end-~LSBatch
@@ -0,0 +1,229 @@
+#ifndef _IMAGE_IO_H_
+#define _IMAGE_IO_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// The P6 de-interleaving uses SSSE3 when the CPU has it. Build with -DIMAGEIO_NO_SIMD to get the scalar code only
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(IMAGEIO_NO_SIMD)
+#define IMAGEIO_SIMD 1
+#include <immintrin.h>
+#else
+#define IMAGEIO_SIMD 0
+#endif
+
+///------------------------------------------------------------------------------------
+/// A PGM (P2/P5) or PPM (P3/P6) image read from a file. The file is mapped into memory
+/// rather than read: the gray plane of a P5 image points right into the mapping, so its
+/// pixels are never copied. The pixels of a P6 image are de-interleaved into R, G & B
+/// planes, those of P2/P3 images are parsed into planes. The planes stay valid until the
+/// image is destroyed or reads another file. The mapping is private, so writing into
+/// the planes never changes the file. Only 8 bit images (max value <= 255) are read.
+///
+struct PNMImage {
+  int width, height;
+  int noChannels;               // 1 for a PGM, 3 for a PPM image
+  unsigned char *planes[3];     // Gray, or R, G & B. width*height pixels each, row after row
+
+  unsigned char *file;          // Mapping of the file
+  size_t fileSize;
+  unsigned char *buffer;        // Planes that do not point into the mapping
+
+public:
+  // constructor
+  PNMImage(){
+    width = height = noChannels = 0;
+    planes[0] = planes[1] = planes[2] = NULL;
+
+    file = NULL;
+    fileSize = 0;
+    buffer = NULL;
+  } //end-PNMImage
+
+  // Destructor
+  ~PNMImage(){
+    Close();
+  } //end-~PNMImage
+
+  // Not copyable: a copy would unmap & free the planes of the original a second time
+  PNMImage(const PNMImage &) = delete;
+  PNMImage &operator=(const PNMImage &) = delete;
+
+  // Gray plane of a PGM image
+  unsigned char *Gray(){return planes[0];}
+
+  unsigned char *Red(){return planes[0];}
+  unsigned char *Green(){return planes[1];}
+  unsigned char *Blue(){return planes[2];}
+
+  // Returns false if the file can not be opened, is not an 8 bit PGM/PPM image or is truncated, or if a
+  // sample of a P2/P3 image is greater than the max value
+  bool Read(const char *filename){
+    Close();
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0){
+      fprintf(stderr, "Error reading the file %s in PNMImage::Read().\n", filename);
+      return false;
+    } //end-if
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < 3){close(fd); return Fail(filename);}
+
+    void *p = mmap(NULL, st.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return Fail(filename);
+
+    file = (unsigned char *)p;
+    fileSize = st.st_size;
+    madvise(file, fileSize, MADV_SEQUENTIAL);
+
+    const unsigned char *end = file + fileSize;
+    if (file[0] != 'P' || file[1] < '2' || file[1] > '6' || file[1] == '4') return Fail(filename);
+
+    bool binary = file[1] >= '5';
+    noChannels = (file[1] == '3' || file[1] == '6') ? 3 : 1;
+
+    // Header: width, height & max value, each after white space and/or comments
+    int maxValue = 0;
+    const unsigned char *s = file+2;
+    if ((s = ParseInt(s, end, &width)) == NULL) return Fail(filename);
+    if ((s = ParseInt(s, end, &height)) == NULL) return Fail(filename);
+    if ((s = ParseInt(s, end, &maxValue)) == NULL) return Fail(filename);
+    if (width <= 0 || height <= 0 || maxValue <= 0 || maxValue > 255) return Fail(filename);
+
+    size_t noPixels = (size_t)width*height;
+
+    if (binary){
+      s++;   // A single white space ends the header
+      if (s > end || (size_t)(end-s) < noPixels*noChannels) return Fail(filename);
+
+      if (noChannels == 1){
+        planes[0] = (unsigned char *)s;
+        return true;
+      } //end-if
+
+      buffer = (unsigned char *)malloc(3*noPixels);
+      for (int k=0; k<3; k++) planes[k] = buffer + k*noPixels;
+      Deinterleave(s, planes[0], planes[1], planes[2], noPixels);
+      return true;
+    } //end-if
+
+    buffer = (unsigned char *)malloc(noChannels*noPixels);
+    for (int k=0; k<noChannels; k++) planes[k] = buffer + k*noPixels;
+
+    for (size_t i=0; i<noPixels; i++){
+      for (int k=0; k<noChannels; k++){
+        int value;
+        if ((s = ParseInt(s, end, &value)) == NULL || value > maxValue) return Fail(filename);
+        planes[k][i] = (unsigned char)value;
+      } //end-for
+    } //end-for
+
+    return true;
+  } //end-Read
+
+  // Releases the planes & the mapping
+  void Close(){
+    if (file) munmap(file, fileSize);
+    free(buffer);
+
+    file = NULL;
+    fileSize = 0;
+    buffer = NULL;
+    planes[0] = planes[1] = planes[2] = NULL;
+    width = height = noChannels = 0;
+  } //end-Close
+
+private:
+  bool Fail(const char *filename){
+    fprintf(stderr, "The file %s is not a valid 8 bit PGM/PPM image or is truncated in PNMImage::Read().\n", filename);
+    Close();
+    return false;
+  } //end-Fail
+
+  // Reads the unsigned integer after the white space & comments at s. Returns the character after it, NULL if there is none
+  static const unsigned char *ParseInt(const unsigned char *s, const unsigned char *end, int *value){
+    while (s < end){
+      if (*s == '#'){
+        while (s < end && *s != '\n') s++;
+      } else if (*s == ' ' || (*s >= '\t' && *s <= '\r')){
+        s++;
+      } else {
+        break;
+      } //end-else
+    } //end-while
+
+    if (s == end || *s < '0' || *s > '9') return NULL;
+
+    int v = 0;
+    while (s < end && *s >= '0' && *s <= '9'){
+      if (v < 100000000) v = v*10 + (*s - '0');
+      s++;
+    } //end-while
+
+    *value = v;
+    return s;
+  } //end-ParseInt
+
+  static void DeinterleaveScalar(const unsigned char *rgb, unsigned char *r, unsigned char *g, unsigned char *b, size_t n){
+    for (size_t i=0; i<n; i++){
+      r[i] = rgb[3*i];
+      g[i] = rgb[3*i+1];
+      b[i] = rgb[3*i+2];
+    } //end-for
+  } //end-DeinterleaveScalar
+
+#if IMAGEIO_SIMD
+  // 16 pixels (48 bytes) at a time: each plane gathers its bytes from the 3 loads with a shuffle & ORs them together
+  __attribute__((target("ssse3")))
+  static void DeinterleaveSSSE3(const unsigned char *rgb, unsigned char *r, unsigned char *g, unsigned char *b, size_t n){
+    // masks[k][m]: bytes of plane k in load m. Bit 7 set zeroes the byte
+    char masks[3][3][16];
+    for (int k=0; k<3; k++){
+      for (int m=0; m<3; m++){
+        for (int p=0; p<16; p++){
+          int src = 3*p + k - 16*m;
+          masks[k][m][p] = (src >= 0 && src < 16) ? src : -128;
+        } //end-for
+      } //end-for
+    } //end-for
+
+    __m128i shuffle[3][3];
+    for (int k=0; k<3; k++){
+      for (int m=0; m<3; m++) shuffle[k][m] = _mm_loadu_si128((const __m128i *)masks[k][m]);
+    } //end-for
+
+    unsigned char *planes[3] = {r, g, b};
+    size_t i = 0;
+    for (; i+16<=n; i+=16){
+      __m128i v0 = _mm_loadu_si128((const __m128i *)(rgb + 3*i));
+      __m128i v1 = _mm_loadu_si128((const __m128i *)(rgb + 3*i + 16));
+      __m128i v2 = _mm_loadu_si128((const __m128i *)(rgb + 3*i + 32));
+
+      for (int k=0; k<3; k++){
+        __m128i plane = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, shuffle[k][0]), _mm_shuffle_epi8(v1, shuffle[k][1])), _mm_shuffle_epi8(v2, shuffle[k][2]));
+        _mm_storeu_si128((__m128i *)(planes[k] + i), plane);
+      } //end-for
+    } //end-for
+
+    DeinterleaveScalar(rgb + 3*i, r+i, g+i, b+i, n-i);
+  } //end-DeinterleaveSSSE3
+#endif
+
+  static void Deinterleave(const unsigned char *rgb, unsigned char *r, unsigned char *g, unsigned char *b, size_t n){
+#if IMAGEIO_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3")){DeinterleaveSSSE3(rgb, r, g, b, n); return;}
+#endif
+
+    DeinterleaveScalar(rgb, r, g, b, n);
+  } //end-Deinterleave
+};
+
+#endif
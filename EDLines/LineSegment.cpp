@@ -0,0 +1,354 @@
+/**************************************************************************************************************
+ * Line fitting & the geometry of the line segments
+ *
+ * A line is y = a + bx, or x = a + by if it is inverted (closer to vertical than to horizontal).
+ **************************************************************************************************************/
+#include <math.h>
+
+#include "EDLinesInternals.h"
+
+// SSE2/AVX2 kernels of ComputeMinDistances are picked at run time on x86. Build with -DLINEFIT_NO_SIMD to get the
+// scalar reference code only
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(LINEFIT_NO_SIMD)
+#define LINEFIT_SIMD 1
+#include <immintrin.h>
+#else
+#define LINEFIT_SIMD 0
+#endif
+
+///-------------------------------------------------------------------------------
+/// Least squares fit of the points of the sums, x = a + by if invert is set. O(1)
+///
+void LineFit(LineFitSums *sums, double *a, double *b, int invert){
+  double S = sums->S;
+  double Sx = sums->Sx, Sy = sums->Sy, Sxx = sums->Sxx;
+
+  if (invert){
+    // Vertical line. Swap x & y
+    Sx = sums->Sy;
+    Sy = sums->Sx;
+    Sxx = sums->Syy;
+  } //end-if
+
+  double D = S*Sxx - Sx*Sx;
+  *a = (Sxx*Sy - Sx*sums->Sxy)/D;
+  *b = (sums->Sxy*S - Sx*Sy)/D;
+} //end-LineFit
+
+///-------------------------------------------------------------------------------
+/// Least squares fit of the "count" points (x[i], y[i]) whose sums are given. The line is inverted if the points
+/// spread more along y than along x. e is the root mean square distance of the points to the line (their mean
+/// distance along y for a horizontal line)
+///
+void LineFit(LineFitSums *sums, double *x, double *y, int count, double *a, double *b, double *e, int *invert){
+  if (count < 2) return;
+
+  // The spread along x & y around the mean. Not from the sums: the 2 are equal on 45 degree runs of pixels & the
+  // rounding of these loops has always picked the orientation there. The window is only minLineLen pixels
+  double S = sums->S;
+  double mx = sums->Sx/S;
+  double my = sums->Sy/S;
+
+  double dx = 0.0, dy = 0.0;
+  for (int i=0; i<count; i++){
+    dx += (x[i] - mx)*(x[i] - mx);
+    dy += (y[i] - my)*(y[i] - my);
+  } //end-for
+
+  *invert = dx < dy ? 1 : 0;
+  LineFit(sums, a, b, *invert);
+
+  if (*invert){
+    // Vertical line. Swap x & y
+    double *t = x; x = y; y = t;
+  } //end-if
+
+  if (*b == 0.0){
+    // Vertical or horizontal line
+    double error = 0.0;
+    for (int i=0; i<count; i++) error += fabs((*a) - y[i]);
+    error /= S;
+    *e = error;
+
+  } else {
+    // Let the line be y = a + bx & the perpendicular through (x[i], y[i]) y = c + mx: they meet at (xp, yp)
+    double m = -1.0/(*b);
+
+    double error = 0.0;
+    for (int i=0; i<count; i++){
+      double xp = ((*a) - (y[i] - m*x[i]))/(m - (*b));
+      double yp = xp*(*b) + (*a);
+
+      error += (x[i] - xp)*(x[i] - xp) + (y[i] - yp)*(y[i] - yp);
+    } //end-for
+
+    error /= S;
+    *e = sqrt(error);
+  } //end-else
+} //end-LineFit
+
+///-------------------------------------------------------------------------------
+/// The point of the line closest to (x1, y1)
+///
+void ComputeClosestPoint(double x1, double y1, double a, double b, int invert, double *xOut, double *yOut){
+  double x2, y2;
+
+  if (invert == 0){
+    if (b == 0){
+      x2 = x1;
+      y2 = a;
+
+    } else {
+      // Let the perpendicular through (x1, y1) be y = c + mx
+      double m = -1.0/b;
+      x2 = (a - (y1 - m*x1))/(m - b);
+      y2 = b*x2 + a;
+    } //end-else
+
+  } else {
+    if (b == 0){
+      x2 = a;
+      y2 = y1;
+
+    } else {
+      // Let the perpendicular through (x1, y1) be x = c + my
+      double m = -1.0/b;
+      y2 = (a - (x1 - m*y1))/(m - b);
+      x2 = b*y2 + a;
+    } //end-else
+  } //end-else
+
+  *xOut = x2;
+  *yOut = y2;
+} //end-ComputeClosestPoint
+
+///-------------------------------------------------------------------------------
+/// Distance of (x1, y1) to the line
+///
+double ComputeMinDistance(double x1, double y1, double a, double b, int invert){
+  double x2, y2;
+  ComputeClosestPoint(x1, y1, a, b, invert, &x2, &y2);
+
+  double dx = x1 - x2;
+  double dy = y1 - y2;
+
+  return sqrt(dx*dx + dy*dy);
+} //end-ComputeMinDistance
+
+#if LINEFIT_SIMD
+///-------------------------------------------------------------------------------
+/// 2: AVX2, 1: SSE2, 0: none
+///
+static int SimdLevel(){
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx2")) return 2;
+  if (__builtin_cpu_supports("sse2")) return 1;
+  return 0;
+} //end-SimdLevel
+
+///-------------------------------------------------------------------------------
+/// ComputeMinDistances of a line with b != 0, 2 points at a time. u is the coordinate the line is a function of
+/// (x, or y for an inverted line) & v the other one. The operations are those of ComputeClosestPoint, so the
+/// distances are the scalar ones bit for bit. Returns the # of points done
+///
+__attribute__((target("sse2")))
+static int ComputeMinDistancesSSE2(const double *u, const double *v, int n, double a, double b, double *d){
+  const __m128d A = _mm_set1_pd(a);
+  const __m128d B = _mm_set1_pd(b);
+  const __m128d M = _mm_set1_pd(-1.0/b);
+  const __m128d MB = _mm_set1_pd(-1.0/b - b);
+
+  int i = 0;
+  for (; i+2<=n; i+=2){
+    __m128d u1 = _mm_loadu_pd(u+i);
+    __m128d v1 = _mm_loadu_pd(v+i);
+
+    __m128d u2 = _mm_div_pd(_mm_sub_pd(A, _mm_sub_pd(v1, _mm_mul_pd(M, u1))), MB);
+    __m128d v2 = _mm_add_pd(_mm_mul_pd(B, u2), A);
+
+    __m128d du = _mm_sub_pd(u1, u2);
+    __m128d dv = _mm_sub_pd(v1, v2);
+    _mm_storeu_pd(d+i, _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(du, du), _mm_mul_pd(dv, dv))));
+  } //end-for
+
+  return i;
+} //end-ComputeMinDistancesSSE2
+
+///-------------------------------------------------------------------------------
+/// Same, 4 points at a time
+///
+__attribute__((target("avx2")))
+static int ComputeMinDistancesAVX2(const double *u, const double *v, int n, double a, double b, double *d){
+  const __m256d A = _mm256_set1_pd(a);
+  const __m256d B = _mm256_set1_pd(b);
+  const __m256d M = _mm256_set1_pd(-1.0/b);
+  const __m256d MB = _mm256_set1_pd(-1.0/b - b);
+
+  int i = 0;
+  for (; i+4<=n; i+=4){
+    __m256d u1 = _mm256_loadu_pd(u+i);
+    __m256d v1 = _mm256_loadu_pd(v+i);
+
+    __m256d u2 = _mm256_div_pd(_mm256_sub_pd(A, _mm256_sub_pd(v1, _mm256_mul_pd(M, u1))), MB);
+    __m256d v2 = _mm256_add_pd(_mm256_mul_pd(B, u2), A);
+
+    __m256d du = _mm256_sub_pd(u1, u2);
+    __m256d dv = _mm256_sub_pd(v1, v2);
+    _mm256_storeu_pd(d+i, _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(du, du), _mm256_mul_pd(dv, dv))));
+  } //end-for
+
+  return i;
+} //end-ComputeMinDistancesAVX2
+#endif
+
+///-------------------------------------------------------------------------------
+/// d[i] = ComputeMinDistance(x[i], y[i], a, b, invert) for the n points, several at a time where SIMD is available
+///
+void ComputeMinDistances(const double *x, const double *y, int n, double a, double b, int invert, double *d){
+  int i = 0;
+
+#if LINEFIT_SIMD
+  static const int level = SimdLevel();
+
+  if (b != 0){
+    const double *u = invert ? y : x;
+    const double *v = invert ? x : y;
+
+    if (level == 2)      i = ComputeMinDistancesAVX2(u, v, n, a, b, d);
+    else if (level == 1) i = ComputeMinDistancesSSE2(u, v, n, a, b, d);
+  } //end-if
+#endif
+
+  for (; i<n; i++) d[i] = ComputeMinDistance(x[i], y[i], a, b, invert);
+} //end-ComputeMinDistances
+
+///-------------------------------------------------------------------------------
+/// The shortest of the distances between the end points of the 2 segments. *pwhich tells which end points:
+/// SOUTH_SOUTH (0), SOUTH_EAST (1), EAST_SOUTH (2) or EAST_EAST (3), start being south & end east
+///
+double ComputeMinDistanceBetweenTwoLines(LineSegment *ls1, LineSegment *ls2, int *pwhich){
+  double dx = ls1->sx - ls2->sx;
+  double dy = ls1->sy - ls2->sy;
+  double d = sqrt(dx*dx + dy*dy);
+  double min = d;
+  int which = SOUTH_SOUTH;
+
+  dx = ls1->sx - ls2->ex;
+  dy = ls1->sy - ls2->ey;
+  d = sqrt(dx*dx + dy*dy);
+  if (d < min){min = d; which = SOUTH_EAST;}
+
+  dx = ls1->ex - ls2->sx;
+  dy = ls1->ey - ls2->sy;
+  d = sqrt(dx*dx + dy*dy);
+  if (d < min){min = d; which = EAST_SOUTH;}
+
+  dx = ls1->ex - ls2->ex;
+  dy = ls1->ey - ls2->ey;
+  d = sqrt(dx*dx + dy*dy);
+  if (d < min){min = d; which = EAST_EAST;}
+
+  if (pwhich) *pwhich = which;
+  return min;
+} //end-ComputeMinDistanceBetweenTwoLines
+
+///-------------------------------------------------------------------------------
+/// Recomputes the line through the end points of the segment
+///
+void UpdateLineParameters(LineSegment *ls){
+  double dx = ls->ex - ls->sx;
+  double dy = ls->ey - ls->sy;
+
+  if (fabs(dx) >= fabs(dy)){
+    // Line will be of the form y = a + bx
+    ls->invert = 0;
+    if (fabs(dy) < 1e-3){ls->b = 0; ls->a = (ls->sy + ls->ey)/2;}
+    else                {ls->b = dy/dx; ls->a = ls->sy - (ls->b)*ls->sx;}
+
+  } else {
+    // Line will be of the form x = a + by
+    ls->invert = 1;
+    if (fabs(dx) < 1e-3){ls->b = 0; ls->a = (ls->sx + ls->ex)/2;}
+    else                {ls->b = dx/dy; ls->a = ls->sx - (ls->b)*ls->sy;}
+  } //end-else
+} //end-UpdateLineParameters
+
+///-------------------------------------------------------------------------------
+/// Joins ls2 into ls1 if their closest end points are at most MAX_DISTANCE_BETWEEN_TWO_LINES apart & the shorter
+/// one is on average at most MAX_ERROR away from the longer one's line. ls1 then spans the 2 end points farthest
+/// apart. Returns true if they are joined
+///
+bool TryToJoinTwoLineSegments(LineSegment *ls1, LineSegment *ls2, double MAX_DISTANCE_BETWEEN_TWO_LINES, double MAX_ERROR){
+  int which;
+  double dist = ComputeMinDistanceBetweenTwoLines(ls1, ls2, &which);
+  if (dist > MAX_DISTANCE_BETWEEN_TWO_LINES) return false;
+
+  // Fit the shorter segment's end points & midpoint to the longer one's line
+  double dx = ls1->sx - ls1->ex;
+  double dy = ls1->sy - ls1->ey;
+  double prevLen = sqrt(dx*dx + dy*dy);
+
+  dx = ls2->sx - ls2->ex;
+  dy = ls2->sy - ls2->ey;
+  double nextLen = sqrt(dx*dx + dy*dy);
+
+  LineSegment *shorter = ls1;
+  LineSegment *longer = ls2;
+  if (prevLen > nextLen){shorter = ls2; longer = ls1;}
+
+  dist = ComputeMinDistance(shorter->sx, shorter->sy, longer->a, longer->b, longer->invert);
+  dist += ComputeMinDistance((shorter->sx + shorter->ex)/2.0, (shorter->sy + shorter->ey)/2.0, longer->a, longer->b, longer->invert);
+  dist += ComputeMinDistance(shorter->ex, shorter->ey, longer->a, longer->b, longer->invert);
+
+  dist /= 3.0;
+  if (dist > MAX_ERROR) return false;
+
+  // Join the 2 segments: find the end points farthest apart (by city block distance)
+  double max = fabs(ls1->sx - ls2->sx) + fabs(ls1->sy - ls2->sy);
+  which = 1;
+
+  double d = fabs(ls1->sx - ls2->ex) + fabs(ls1->sy - ls2->ey);
+  if (d > max){max = d; which = 2;}
+
+  d = fabs(ls1->ex - ls2->sx) + fabs(ls1->ey - ls2->sy);
+  if (d > max){max = d; which = 3;}
+
+  d = fabs(ls1->ex - ls2->ex) + fabs(ls1->ey - ls2->ey);
+  if (d > max){max = d; which = 4;}
+
+  if (which == 1){
+    // (sx1, sy1)-(sx2, sy2)
+    ls1->ex = ls2->sx;
+    ls1->ey = ls2->sy;
+
+  } else if (which == 2){
+    // (sx1, sy1)-(ex2, ey2)
+    ls1->ex = ls2->ex;
+    ls1->ey = ls2->ey;
+
+  } else if (which == 3){
+    // (ex1, ey1)-(sx2, sy2)
+    ls1->sx = ls2->sx;
+    ls1->sy = ls2->sy;
+
+  } else {
+    // (ex1, ey1)-(ex2, ey2)
+    ls1->sx = ls1->ex;
+    ls1->sy = ls1->ey;
+
+    ls1->ex = ls2->ex;
+    ls1->ey = ls2->ey;
+  } //end-else
+
+  // The pixels: a segment next to ls1 along the edge segment extends its run, else the longer run is kept
+  if (ls1->firstPixelIndex + ls1->len + 5 >= ls2->firstPixelIndex) ls1->len += ls2->len;
+  else if (ls2->len > ls1->len){
+    ls1->firstPixelIndex = ls2->firstPixelIndex;
+    ls1->len = ls2->len;
+  } //end-else
+
+  UpdateLineParameters(ls1);
+
+  return true;
+} //end-TryToJoinTwoLineSegments
@@ -0,0 +1,145 @@
+/**************************************************************************************************************
+ * Number of False Alarms (NFA) of the line segments, as in LSD, & its LUT
+ **************************************************************************************************************/
+#include <math.h>
+#include <float.h>
+
+#include "EDLinesInternals.h"
+
+#define RELATIVE_ERROR_FACTOR 100.0
+#define LN10 2.30258509299404568402
+
+///-------------------------------------------------------------------------------
+/// Are a & b equal up to a relative error of RELATIVE_ERROR_FACTOR*DBL_EPSILON?
+///
+static bool double_equal(double a, double b){
+  if (a == b) return true;
+
+  double abs_diff = fabs(a-b);
+  double aa = fabs(a);
+  double bb = fabs(b);
+  double abs_max = aa > bb ? aa : bb;
+
+  // DBL_MIN is the smallest normalized number, the granularity of the floating point numbers near 0
+  if (abs_max < DBL_MIN) abs_max = DBL_MIN;
+
+  return (abs_diff / abs_max) <= (RELATIVE_ERROR_FACTOR * DBL_EPSILON);
+} //end-double_equal
+
+///-------------------------------------------------------------------------------
+/// log(gamma(x)) by the Lanczos approximation, good for small x
+///
+static double log_gamma_lanczos(double x){
+  static double q[7] = {75122.6331530, 80916.6278952, 36308.2951477, 8687.24529705, 1168.92649479, 83.8676043424, 2.50662827511};
+
+  double a = (x+0.5) * log(x+5.5) - (x+5.5);
+  double b = 0.0;
+
+  for (int n=0; n<7; n++){
+    a -= log(x + (double)n);
+    b += q[n] * pow(x, (double)n);
+  } //end-for
+
+  return a + log(b);
+} //end-log_gamma_lanczos
+
+///-------------------------------------------------------------------------------
+/// log(gamma(x)) by Windschitl's approximation, good for large x
+///
+static double log_gamma_windschitl(double x){
+  return 0.918938533204673 + (x-0.5)*log(x) - x + 0.5*x*log(x*sinh(1/x) + 1/(810.0*pow(x, 6.0)));
+} //end-log_gamma_windschitl
+
+#define log_gamma(x) ((x) > 15.0 ? log_gamma_windschitl(x) : log_gamma_lanczos(x))
+
+///-------------------------------------------------------------------------------
+/// -log10(NFA) of n points having k aligned ones with probability p each, given logNT = log10(# of tests).
+/// The binomial tail is summed until the rest is below 10% of it. A line is meaningful if the result is >= 0.
+/// Returns -1 for invalid parameters
+///
+double nfa(int n, int k, double p, double logNT){
+  double tolerance = 0.1;       // an error of 10% in the result is accepted
+
+  // check parameters
+  if (n < 0 || k < 0 || k > n || p <= 0.0 || p >= 1.0) return -1.0;
+
+  // trivial cases
+  if (n == 0 || k == 0) return -logNT;
+  if (n == k) return -logNT - (double)n * log10(p);
+
+  // probability term
+  double p_term = p / (1.0-p);
+
+  // compute the first term of the series
+  double log1term = log_gamma((double)n + 1.0) - log_gamma((double)k + 1.0) - log_gamma((double)(n-k) + 1.0)
+                    + (double)k * log(p) + (double)(n-k) * log(1.0-p);
+  double term = exp(log1term);
+
+  // in some cases no more computations are needed
+  if (double_equal(term, 0.0)){
+    if ((double)k > (double)n * p) return -log1term / LN10 - logNT;   // end of the tail: use just the first term
+    else                           return -logNT;                     // begin: the tail is roughly 1
+  } //end-if
+
+  // compute more terms if needed
+  double bin_tail = term;
+  for (int i=k+1; i<=n; i++){
+    double bin_term = (double)(n-i+1) * (1.0 / (double)i);
+    double mult_term = bin_term * p_term;
+    term *= mult_term;
+    bin_tail += term;
+
+    if (bin_term < 1.0){
+      double err = term * ((1.0 - pow(mult_term, (double)(n-i+1))) / (1.0-mult_term) - 1.0);
+      if (err < tolerance * fabs(-log10(bin_tail)-logNT) * bin_tail) break;
+    } //end-if
+  } //end-for
+
+  return -log10(bin_tail) - logNT;
+} //end-nfa
+
+///-------------------------------------------------------------------------------
+/// LUT[n]: the fewest aligned points out of n that make a line meaningful, LUTSize+1 if there is none
+///
+NFALUT::NFALUT(int size, double prob, double logNT){
+  LUTSize = size;
+  LUT = new int[LUTSize];
+
+  this->prob = prob;
+  this->logNT = logNT;
+
+  LUT[0] = 1;
+  int j = 1;
+  for (int i=1; i<LUTSize; i++){
+    LUT[i] = LUTSize + 1;
+
+    // The LUT is non decreasing: start with the previous length's count
+    double ret = nfa(i, j, prob, logNT);
+    if (ret < 0){
+      while (j < i){
+        j++;
+        ret = nfa(i, j, prob, logNT);
+        if (ret >= 0) break;
+      } //end-while
+
+      if (ret < 0) continue;
+    } //end-if
+
+    LUT[i] = j;
+  } //end-for
+} //end-NFALUT
+
+///-------------------------------------------------------------------------------
+/// Destructor
+///
+NFALUT::~NFALUT(){
+  delete[] LUT;
+} //end-~NFALUT
+
+///-------------------------------------------------------------------------------
+/// Are k aligned points out of n meaningful? Through the LUT if n is in there
+///
+bool checkValidationByNFA(int n, int k, NFALUT *lut){
+  if (n >= lut->LUTSize) return nfa(n, k, lut->prob, lut->logNT) >= 0.0;
+  else                   return k >= lut->LUT[n];
+} //end-checkValidationByNFA
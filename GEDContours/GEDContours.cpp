@@ -0,0 +1,93 @@
+/**************************************************************************************************************
+ * GEDContours: contours of a gray image by validating the ED edge segments over the L*a*b* image at 12 scales
+ * & combining the surviving pixels into a soft contour map
+ **************************************************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+
+#include "GEDContours.h"
+#include "EDInternals.h"
+
+#define NO_SCALES          12
+#define SIGMA_STEP         0.25
+#define VALIDATION_SIGMA   2.3     // Validation smoothing relative to the detection sigma
+
+///-------------------------------------------------------------------------------
+/// The contour detectors need no LUTs. Kept for compatibility with the other ED libraries
+///
+void InitEDLib(){
+} //end-InitEDLib
+
+///-------------------------------------------------------------------------------
+/// Detects the contours by combining the GrayEDV results at multiple scales. Returns a soft contour map
+///
+EdgeMap *GEDContours(unsigned char *srcImg, int width, int height, int GRADIENT_THRESH){
+  PROFILE_STAGE("GEDContours");
+
+  int n = width*height;
+
+  unsigned char *grayImg = new unsigned char[n];
+  unsigned char *LImg = new unsigned char[n];
+  unsigned char *aImg = new unsigned char[n];
+  unsigned char *bImg = new unsigned char[n];
+
+  StretchHistogram(srcImg, grayImg, n);
+  StdRGB2Lab(grayImg, grayImg, grayImg, LImg, aImg, bImg, width, height);
+
+  unsigned char *smoothLImg = new unsigned char[n];
+  unsigned char *smoothAImg = new unsigned char[n];
+  unsigned char *smoothBImg = new unsigned char[n];
+  unsigned char *dirImg = new unsigned char[n];
+  short *gradImg = new short[n];
+  EDContext ctx(width, height);            // Linking memory, shared by the scales
+
+  unsigned char *levels[MAX_DIV_LEVELS];    // Validation counts, shared by the scales
+  memset(levels, 0, sizeof(levels));
+  int noLevels = 0;
+
+  double sigma = SIGMA_STEP;
+  for (int s=0; s<NO_SCALES; s++){
+    SmoothImage(LImg, smoothLImg, width, height, sigma, NULL, true);
+    SmoothImage(aImg, smoothAImg, width, height, sigma, NULL, true);
+    SmoothImage(bImg, smoothBImg, width, height, sigma, NULL, true);
+
+    ComputeGradientMapByPrewitt(smoothLImg, smoothAImg, smoothBImg, gradImg, dirImg, width, height);
+    EdgeMap *map = DoDetectEdgesByED(&ctx, gradImg, dirImg, GRADIENT_THRESH, 0, false);
+
+    double validationSigma = sigma*VALIDATION_SIGMA;
+    SmoothImage(LImg, smoothLImg, width, height, validationSigma, NULL, true);
+    SmoothImage(aImg, smoothAImg, width, height, validationSigma, NULL, true);
+    SmoothImage(bImg, smoothBImg, width, height, validationSigma, NULL, true);
+
+    noLevels = ValidateEdgeSegmentsMultipleDiv(map, smoothLImg, smoothAImg, smoothBImg, levels, noLevels);
+    delete map;
+
+    sigma += SIGMA_STEP;
+  } //end-for
+
+  EdgeMap *map = EDContoursPostprocess(levels, noLevels, grayImg, width, height, 4, 4);
+
+  for (int i=0; i<noLevels; i++) delete[] levels[i];
+
+  delete[] grayImg;
+  delete[] LImg;
+  delete[] aImg;
+  delete[] bImg;
+  delete[] smoothLImg;
+  delete[] smoothAImg;
+  delete[] smoothBImg;
+  delete[] dirImg;
+  delete[] gradImg;
+
+  return map;
+} //end-GEDContours
+
+///-------------------------------------------------------------------------------
+/// GEDContours thresholded at cutoffThresh into a binary contour map
+///
+EdgeMap *GEDContours_BW(unsigned char *srcImg, int width, int height, int GRADIENT_THRESH, int cutoffThresh){
+  EdgeMap *map = GEDContours(srcImg, width, height, GRADIENT_THRESH);
+  EDContoursThreshold(map, cutoffThresh);
+
+  return map;
+} //end-GEDContours_BW
@@ -20,6 +20,12 @@
 #define _PEL_H_
 
 // Link edges and return an edgemap (Predictive edge linking)
-EdgeMap *PEL(unsigned char *edgeImg, int width, int height, int MIN_SEGMENT_LEN=10);
+// If a pool is given, the edgemap is carved from it & stays valid until pool->Reset(); reset it between frames
+// numThreads > 1 splits the image into horizontal bands linked in parallel. The result is the same as with 1 thread
+// edgeImg is only read, so several threads may link the same edge image at once
+EdgeMap *PEL(const unsigned char *edgeImg, int width, int height, int MIN_SEGMENT_LEN=10, EdgeMapPool *pool=NULL, int numThreads=1);
+
+// Same as above for a 1 bit per pixel edge map. Gives the same edge segments as the 0/255 byte map it was packed from
+EdgeMap *PEL(const BitEdgeImg *edgeImg, int MIN_SEGMENT_LEN=10, EdgeMapPool *pool=NULL, int numThreads=1);
 
 #endif
\ No newline at end of file
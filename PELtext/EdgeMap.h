@@ -19,7 +19,9 @@
 #ifndef _EDGE_MAP_H_
 #define _EDGE_MAP_H_
 
+#include <stdlib.h>
 #include <memory.h>
+#include <new>
 
 enum GradientOperator {PREWITT_OPERATOR=101, SOBEL_OPERATOR=102, SCHARR_OPERATOR=103};
 
@@ -30,6 +32,231 @@ struct EdgeSegment {
   int noPixels;        // # of pixels in the edge map
 };
 
+///------------------------------------------------------------------------------------
+/// Memory arena the edge maps are carved from. Nothing is freed piece by piece: Reset()
+/// hands all the memory back at once so that it can be reused for the next frame.
+/// When the arena runs out, a new block is chained in front of the old ones; Reset()
+/// then merges the blocks into a single block, so a pool that is reset between frames
+/// stops allocating once it has seen its largest frame.
+///
+struct EdgeMapPool {
+  struct Block {
+    Block *next;         // Older block
+    size_t size;         // # of usable bytes in this block
+    size_t used;         // # of bytes handed out from this block
+  };
+
+  Block *blocks;         // Current block (newest first)
+  size_t totalSize;      // Sum of the sizes of all blocks
+
+public:
+  // constructor
+  EdgeMapPool(size_t initialSize=0){
+    blocks = NULL;
+    totalSize = 0;
+    if (initialSize > 0) AddBlock(initialSize);
+  } //end-EdgeMapPool
+
+  // Destructor
+  ~EdgeMapPool(){
+    FreeBlocks();
+  } //end-~EdgeMapPool
+
+  // Returns a 64 byte aligned chunk of "size" bytes. The chunk is valid until the next Reset()
+  void *Alloc(size_t size){
+    size = (size + 63) & ~(size_t)63;
+
+    if (blocks == NULL || blocks->used + size > blocks->size){
+      size_t blockSize = totalSize;                 // Grow geometrically
+      if (blockSize < size) blockSize = size;
+      if (blockSize < 64*1024) blockSize = 64*1024;
+      AddBlock(blockSize);
+    } //end-if
+
+    // Chunks start at the first 64 byte boundary past the block header
+    char *data = (char *)(blocks+1) + 64 - ((size_t)(blocks+1) & 63);
+    void *p = data + blocks->used;
+    blocks->used += size;
+    return p;
+  } //end-Alloc
+
+  // Releases everything handed out so far. Chained blocks are merged into one
+  void Reset(){
+    if (blocks && blocks->next){
+      size_t size = totalSize;
+      FreeBlocks();
+      AddBlock(size);
+
+    } else if (blocks){
+      blocks->used = 0;
+    } //end-else
+  } //end-Reset
+
+private:
+  void AddBlock(size_t size){
+    // Reserve 64 extra bytes so that the first chunk can be aligned
+    Block *block = (Block *)malloc(sizeof(Block) + 64 + size);
+    if (block == NULL) throw std::bad_alloc();
+
+    block->next = blocks;
+    block->size = size;
+    block->used = 0;
+
+    blocks = block;
+    totalSize += size;
+  } //end-AddBlock
+
+  void FreeBlocks(){
+    while (blocks){
+      Block *next = blocks->next;
+      free(blocks);
+      blocks = next;
+    } //end-while
+
+    totalSize = 0;
+  } //end-FreeBlocks
+};
+
+///------------------------------------------------------------------------------------
+/// Binary edge map with 1 bit per pixel: pixel (r, c) is bit c&63 of word r*stride + c/64.
+/// Every row starts at a new 64 bit word & the bits past the end of a row are always 0,
+/// so the neighbors of 64 pixels can be tested with a few shifts & ANDs.
+///
+struct BitEdgeImg {
+public:
+  int width, height;
+  int stride;                     // # of 64 bit words per row
+  unsigned long long *bits;
+
+  bool ownsBits;                  // Did we allocate the bits ourselves?
+
+public:
+  // constructor. If a pool is given, the bits are carved from it & stay valid until pool->Reset()
+  BitEdgeImg(int w, int h, EdgeMapPool *pool=NULL){
+    width = w;
+    height = h;
+    stride = (width+63)/64;
+
+    ownsBits = (pool == NULL);
+    if (ownsBits) bits = new unsigned long long[stride*height];
+    else          bits = (unsigned long long *)pool->Alloc(sizeof(unsigned long long)*stride*height);
+
+    Clear();
+  } //end-BitEdgeImg
+
+  // Destructor
+  ~BitEdgeImg(){
+    if (ownsBits) delete[] bits;
+  } //end-~BitEdgeImg
+
+  // Is (r, c) an edgel?
+  bool operator()(int r, int c) const {return (bits[r*stride+(c>>6)] >> (c&63)) & 1;}
+
+  void Set(int r, int c){bits[r*stride+(c>>6)] |= 1ULL << (c&63);}
+  void Clear(){memset(bits, 0, sizeof(unsigned long long)*stride*height);}
+
+  // Byte edge map -> bits: the nonzero pixels are the edgels
+  void Pack(const unsigned char *edgeImg){
+    for (int r=0; r<height; r++){
+      for (int w=0; w<stride; w++){
+        unsigned long long word = 0;
+
+        int last = w*64+64 < width ? w*64+64 : width;
+        for (int c=last-1; c>=w*64; c--) word = (word << 1) | (edgeImg[r*width+c] != 0);
+
+        bits[r*stride+w] = word;
+      } //end-for
+    } //end-for
+  } //end-Pack
+
+  // Bits -> byte edge map: 255 for the edgels, 0 elsewhere
+  void Unpack(unsigned char *edgeImg) const {
+    for (int r=0; r<height; r++){
+      for (int c=0; c<width; c++) edgeImg[r*width+c] = (*this)(r, c) ? 255 : 0;
+    } //end-for
+  } //end-Unpack
+};
+
+///------------------------------------------------------------------------------------
+/// Pixel -> segment # map. Labeling writes just the pixels of the segments & Unlabel()
+/// puts just those back to -1, so the map is only cleared when it grows & is otherwise
+/// reused from frame to frame. Segment #s go up to 2^29-1, which leaves 2 bits per pixel
+/// for flags that the users of the map may set on labeled pixels.
+///
+#define LABEL_MASK 0x1FFFFFFF
+
+struct LabelMap {
+  int *labels;
+  int size;                 // # of pixels there is room for
+  int width;                // Width of the image labeled last
+
+  EdgeSegment *labeled;     // Copy of the segments labeled last, so that Unlabel() finds their pixels
+  int noLabeled;
+  int maxLabeled;
+
+public:
+  // constructor
+  LabelMap(){
+    labels = NULL;
+    size = width = 0;
+
+    labeled = NULL;
+    noLabeled = maxLabeled = 0;
+  } //end-LabelMap
+
+  // Destructor
+  ~LabelMap(){
+    free(labels);
+    free(labeled);
+  } //end-~LabelMap
+
+  // Labels the pixels of segment i with i
+  void Label(EdgeSegment *segments, int noSegments, int w, int h){
+    if (size < w*h){
+      free(labels);
+      size = w*h;
+      labels = (int *)malloc(sizeof(int)*size);
+      if (labels == NULL){size = 0; throw std::bad_alloc();}
+      memset(labels, -1, sizeof(int)*size);
+    } //end-if
+
+    if (maxLabeled < noSegments){
+      free(labeled);
+      maxLabeled = noSegments;
+      labeled = (EdgeSegment *)malloc(sizeof(EdgeSegment)*maxLabeled);
+      if (labeled == NULL){maxLabeled = 0; throw std::bad_alloc();}
+    } //end-if
+
+    width = w;
+    noLabeled = noSegments;
+    memcpy(labeled, segments, sizeof(EdgeSegment)*noSegments);
+
+    for (int i=0; i<noSegments; i++){
+      for (int j=0; j<segments[i].noPixels; j++) labels[segments[i].pixels[j].r*width + segments[i].pixels[j].c] = i;
+    } //end-for
+  } //end-Label
+
+  // Puts the pixels labeled last back to -1
+  void Unlabel(){
+    for (int i=0; i<noLabeled; i++){
+      for (int j=0; j<labeled[i].noPixels; j++) labels[labeled[i].pixels[j].r*width + labeled[i].pixels[j].c] = -1;
+    } //end-for
+
+    noLabeled = 0;
+  } //end-Unlabel
+
+  // Segment # of (r, c), -1 if it is on no segment
+  int operator()(int r, int c) const {
+    int label = labels[r*width+c];
+    return label < 0 ? -1 : label & LABEL_MASK;
+  } //end-operator()
+
+  // flag is 1<<29 or 1<<30. Unlabeled pixels have the sign bit set & are never flagged
+  bool Flagged(int r, int c, int flag) const {return (labels[r*width+c] & (flag | ~0x7FFFFFFF)) == flag;}
+  void SetFlag(int r, int c, int flag){labels[r*width+c] |= flag;}
+  void ClearFlag(int r, int c, int flag){labels[r*width+c] &= ~flag;}
+};
+
 struct EdgeMap {
 public:
   int width, height;        // Width & height of the image
@@ -39,27 +266,83 @@ public:
   Pixel *pixels;            // Edge map in edge segment form
   EdgeSegment *segments;     
   int noSegments;
+  int maxPixels, maxSegments;   // Room in pixels & segments
+
+  EdgeMapPool *pool;        // Arena the edge image, pixels & segments are carved from
+  bool ownsPool;            // Did we create the pool ourselves?
+
+  LabelMap *labels;         // Labels of the segments' pixels while attached, NULL otherwise
       
 public:
-  // constructor
-  EdgeMap(int w, int h){
+  // constructor. maxPixels & maxSegments bound the size of the edge segment form (defaults to width*height).
+  // If a pool is given, all memory comes from it & stays valid until pool->Reset(); otherwise the map owns its memory
+  EdgeMap(int w, int h, int maxPixels=-1, int maxSegments=-1, EdgeMapPool *pool=NULL){
     width = w;
     height = h;
 
-    edgeImg = new unsigned char[width*height];
+    if (maxPixels < 0) maxPixels = width*height;
+    if (maxSegments < 0) maxSegments = width*height;
+
+    ownsPool = (pool == NULL);
+    if (ownsPool) pool = new EdgeMapPool(width*height + sizeof(Pixel)*maxPixels + sizeof(EdgeSegment)*maxSegments + 3*64);
+    this->pool = pool;
 
-    pixels = new Pixel[width*height];
-    segments = new EdgeSegment[width*height];
+    edgeImg = (unsigned char *)pool->Alloc(width*height);
+
+    pixels = AllocPixels(maxPixels);
+    segments = AllocSegments(maxSegments);
     noSegments = 0;
+    this->maxPixels = maxPixels;
+    this->maxSegments = maxSegments;
+
+    labels = NULL;
   } //end-EdgeMap
 
   // Destructor
   ~EdgeMap(){
-    delete edgeImg;
-    delete pixels;
-    delete segments;
+    if (ownsPool) delete pool;
   } //end-~EdgeMap
 
+  // Grab more room for pixels & segments from the map's pool, e.g., when the segments are rearranged
+  Pixel *AllocPixels(int n){return (Pixel *)pool->Alloc(sizeof(Pixel)*n);}
+  EdgeSegment *AllocSegments(int n){return (EdgeSegment *)pool->Alloc(sizeof(EdgeSegment)*n);}
+
+  // Makes room for n pixels, keeping the first "used" ones: moves them to a larger chunk of the pool if need be,
+  // along with the first noSegs segments, which point to them
+  void ReservePixels(int n, int used, int noSegs){
+    if (n <= maxPixels) return;
+
+    int size = 2*maxPixels > n ? 2*maxPixels : n;
+    Pixel *p = AllocPixels(size);
+    if (used > 0) memcpy(p, pixels, sizeof(Pixel)*used);
+    for (int i=0; i<noSegs; i++) segments[i].pixels = p + (segments[i].pixels - pixels);
+
+    pixels = p;
+    maxPixels = size;
+  } //end-ReservePixels
+
+  // Makes room for n segments, keeping the first "used" ones
+  void ReserveSegments(int n, int used){
+    if (n <= maxSegments) return;
+
+    int size = 2*maxSegments > n ? 2*maxSegments : n;
+    EdgeSegment *s = AllocSegments(size);
+    if (used > 0) memcpy(s, segments, sizeof(EdgeSegment)*used);
+
+    segments = s;
+    maxSegments = size;
+  } //end-ReserveSegments
+
+  // Labels the pixels of the current segments in labelMap & keeps it at hand in "labels" until DetachLabels()
+  void AttachLabels(LabelMap *labelMap){
+    labelMap->Label(segments, noSegments, width, height);
+    labels = labelMap;
+  } //end-AttachLabels
+
+  void DetachLabels(){
+    labels->Unlabel();
+    labels = NULL;
+  } //end-DetachLabels
 
   void ConvertEdgeSegments2EdgeImg(){
     memset(edgeImg, 0, width*height);
@@ -73,6 +356,15 @@ public:
       } //end-for
     } //end-for
   } //end-ConvertEdgeSegments2EdgeImg
+
+  // Same as above, but into a 1 bit per pixel edge map of the same size
+  void ConvertEdgeSegments2EdgeImg(BitEdgeImg *img){
+    img->Clear();
+
+    for (int i=0; i<noSegments; i++){
+      for (int j=0; j<segments[i].noPixels; j++) img->Set(segments[i].pixels[j].r, segments[i].pixels[j].c);
+    } //end-for
+  } //end-ConvertEdgeSegments2EdgeImg
 };
 
 
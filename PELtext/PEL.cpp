@@ -18,42 +18,284 @@
  ******************************************************************************/
 #include <stdio.h>
 #include <stdlib.h>
+#include <thread>
 
 #include "EdgeMap.h"
 #include "PEL.h"
+#include "Profiler.h"
+
+// SSE2/AVX2 kernels are picked at run time on x86. Build with -DPEL_NO_SIMD to get the scalar reference code only
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(PEL_NO_SIMD)
+#define PEL_SIMD 1
+#include <immintrin.h>
+#else
+#define PEL_SIMD 0
+#endif
+
+///-------------------------------------------------------------------------------
+/// Memory PEL keeps between calls, so that linking a stream of frames does not go to the heap for it
+///
+struct PELScratch {
+  unsigned long long *words;
+  size_t noWords;
+
+public:
+  PELScratch(){words = NULL; noWords = 0;}
+  ~PELScratch(){free(words);}
+
+  // Returns room for at least n words. The contents are not kept when the room grows
+  unsigned long long *Words(size_t n){
+    if (n > noWords){
+      free(words);
+      words = (unsigned long long *)malloc(sizeof(unsigned long long)*n);
+      noWords = n;
+    } //end-if
+
+    return words;
+  } //end-Words
+};
+
+///-------------------------------------------------------------------------------
+/// The edge map PEL works on: 1 bit per pixel, set for the edgels (incl. the filled gaps) that no walk has taken yet.
+/// The caller's edge image is only read. Every row starts at a new 64 bit word & is written by one thread only,
+/// while the walks of the bands next to it may read it. The words are therefore accessed with relaxed atomics,
+/// which are plain loads & stores on x86
+///
+struct EdgelMap {
+  int width, height;
+
+  unsigned long long *bits;
+  int stride;                  // # of words per row
+
+public:
+  EdgelMap(int width, int height, PELScratch &scratch){
+    this->width = width;
+    this->height = height;
+
+    stride = (width+63)/64;
+    bits = scratch.Words((size_t)stride*height);
+  } //end-EdgelMap
+
+  // Is (r, c) an edgel that is not taken yet?
+  bool operator()(int r, int c) const {
+    return (Load(r*stride+(c>>6)) >> (c&63)) & 1;
+  } //end-operator()
+
+  void Put(int r, int c){Store(r*stride+(c>>6), Load(r*stride+(c>>6)) | (1ULL << (c&63)));}
+  void Take(int r, int c){Store(r*stride+(c>>6), Load(r*stride+(c>>6)) & ~(1ULL << (c&63)));}
+
+private:
+  unsigned long long Load(int k) const {return __atomic_load_n(&bits[k], __ATOMIC_RELAXED);}
+  void Store(int k, unsigned long long word){__atomic_store_n(&bits[k], word, __ATOMIC_RELAXED);}
+};
 
 // Helper function prototypes
 static void FillGaps1(unsigned char *edgeImg, int width, int height);
-static void FillGaps2(unsigned char *edgeImg, int width, int height);
+static int FillGaps2(const unsigned char *edgeImg, const BitEdgeImg *bitImg, EdgelMap &E, int numThreads=1);
 
-EdgeMap *PELWalk8Dirs(unsigned char *edgeImg, int width, int height, int MIN_SEGMENT_LEN);
+static EdgeMap *PELWalk8Dirs(EdgelMap &E, int MIN_SEGMENT_LEN, int noEdgels=-1, EdgeMapPool *pool=NULL, int numThreads=1);
 static void JoinNeighborEdgeSegments(EdgeMap *map);
-static void ThinEdgeSegments(EdgeMap *map, int MIN_SEGMENT_LEN);
-static void FixEdgeSegments(EdgeMap *map);
+static void ThinEdgeSegments(EdgeMap *map, int MIN_SEGMENT_LEN, int numThreads=1);
+static void FixEdgeSegments(EdgeMap *map, int numThreads=1);
+
+// The filled-up edge map is worked on as a bitset in scratch memory that each calling thread keeps from call to call
+static thread_local PELScratch scratch;
+
+// Pixel -> segment map of the join step, likewise kept per thread
+static thread_local LabelMap labelMap;
+
+// Flags of the labeled pixels while joining
+#define JOINT_POINT 0x40000000
+#define END_POINT   0x20000000
 
 ///-------------------------------------------------------------------------------
-/// Predictive Edge Linking (PEL)
+/// Predictive Edge Linking (PEL) of a byte (edgeImg) or bit (bitImg) edge map; the other one is NULL
 ///
-EdgeMap *PEL(unsigned char *edgeImg, int width, int height, int MIN_SEGMENT_LEN){
+static EdgeMap *LinkEdges(const unsigned char *edgeImg, const BitEdgeImg *bitImg, int width, int height, int MIN_SEGMENT_LEN, EdgeMapPool *pool, int numThreads){
+  PROFILE_STAGE("PEL");
+
+  EdgelMap E(width, height, scratch);
+
   // Close gaps of 1 pixel wide
 //  FillGaps1(edgeImg, width, height);
-  FillGaps2(edgeImg, width, height);
+  int noEdgels = FillGaps2(edgeImg, bitImg, E, numThreads);
 
   // Convert the filled-up edge map to edge segments using 8 directional predictive edge linking
-  EdgeMap *map = PELWalk8Dirs(edgeImg, width, height, 7); 
+  EdgeMap *map = PELWalk8Dirs(E, 7, noEdgels, pool, numThreads); 
 
   // Extend the edge segments
   JoinNeighborEdgeSegments(map);
 
   // Thin down edge segments
-  ThinEdgeSegments(map, MIN_SEGMENT_LEN);
+  ThinEdgeSegments(map, MIN_SEGMENT_LEN, numThreads);
 
   // Fix jitters of 1 pixel within an edge segment
-  FixEdgeSegments(map);
+  FixEdgeSegments(map, numThreads);
 
   return map;
+} //end-LinkEdges
+
+///-------------------------------------------------------------------------------
+/// Predictive Edge Linking (PEL)
+///
+EdgeMap *PEL(const unsigned char *edgeImg, int width, int height, int MIN_SEGMENT_LEN, EdgeMapPool *pool, int numThreads){
+  return LinkEdges(edgeImg, NULL, width, height, MIN_SEGMENT_LEN, pool, numThreads);
+} //end-PEL
+
+EdgeMap *PEL(const BitEdgeImg *edgeImg, int MIN_SEGMENT_LEN, EdgeMapPool *pool, int numThreads){
+  return LinkEdges(NULL, edgeImg, edgeImg->width, edgeImg->height, MIN_SEGMENT_LEN, pool, numThreads);
 } //end-PEL
 
+///======================================= Threads ======================================
+///-------------------------------------------------------------------------------
+/// Runs job(t, arg) for t = 0..numThreads-1 in parallel (t = 0 on the calling thread) & waits for all of them to finish
+///
+static void RunThreads(int numThreads, void (*job)(int t, void *arg), void *arg){
+  if (numThreads <= 1){job(0, arg); return;}
+
+  std::thread *threads = new std::thread[numThreads];
+  for (int t=1; t<numThreads; t++) threads[t] = std::thread(job, t, arg);
+
+  job(0, arg);
+
+  for (int t=1; t<numThreads; t++) threads[t].join();
+  delete[] threads;
+} //end-RunThreads
+
+#if PEL_SIMD
+///-------------------------------------------------------------------------------
+/// 2: AVX2, 1: SSE2, 0: none
+///
+static int SimdLevel(){
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx2")) return 2;
+  if (__builtin_cpu_supports("sse2")) return 1;
+  return 0;
+} //end-SimdLevel
+#endif
+
+///-------------------------------------------------------------------------------
+/// The rows of the image are split into numThreads horizontal bands. Band t is rows [BandStart(t), BandStart(t+1))
+///
+static inline int BandStart(int t, int numThreads, int height){
+  return (int)((long long)t*height/numThreads);
+} //end-BandStart
+
+///-------------------------------------------------------------------------------
+/// The bands must be a few rows high for the threads to pay off
+///
+static int ClampNumThreads(int numThreads, int height){
+  if (numThreads > height/16) numThreads = height/16;
+  if (numThreads < 1) numThreads = 1;
+
+  return numThreads;
+} //end-ClampNumThreads
+
+///======================================= Working edge map ======================================
+///-------------------------------------------------------------------------------
+/// Sets the bits of the nonzero pixels of rows [firstRow, lastRow) of edgeImg & clears the rest
+///
+static void PackEdgelsScalar(const unsigned char *edgeImg, EdgelMap &E, int firstRow, int lastRow, int firstWord=0){
+  int width = E.width;
+
+  for (int i=firstRow; i<lastRow; i++){
+    for (int w=firstWord; w<E.stride; w++){
+      unsigned long long word = 0;
+
+      int last = w*64+64 < width ? w*64+64 : width;
+      for (int c=last-1; c>=w*64; c--) word = (word << 1) | (edgeImg[i*width+c] != 0);
+
+      E.bits[i*E.stride+w] = word;
+    } //end-for
+  } //end-for
+} //end-PackEdgelsScalar
+
+#if PEL_SIMD
+__attribute__((target("sse2")))
+static void PackEdgelsSSE2(const unsigned char *edgeImg, EdgelMap &E, int firstRow, int lastRow){
+  const __m128i zero = _mm_setzero_si128();
+  int width = E.width;
+  int fullWords = width/64;
+
+  for (int i=firstRow; i<lastRow; i++){
+    const unsigned char *p = edgeImg + i*width;
+
+    for (int w=0; w<fullWords; w++){
+      unsigned long long zeros = 0;
+      for (int k=3; k>=0; k--){
+        zeros = (zeros << 16) | (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p+w*64+k*16)), zero));
+      } //end-for
+
+      E.bits[i*E.stride+w] = ~zeros;
+    } //end-for
+
+    if (fullWords < E.stride) PackEdgelsScalar(edgeImg, E, i, i+1, fullWords);
+  } //end-for
+} //end-PackEdgelsSSE2
+
+__attribute__((target("avx2")))
+static void PackEdgelsAVX2(const unsigned char *edgeImg, EdgelMap &E, int firstRow, int lastRow){
+  const __m256i zero = _mm256_setzero_si256();
+  int width = E.width;
+  int fullWords = width/64;
+
+  for (int i=firstRow; i<lastRow; i++){
+    const unsigned char *p = edgeImg + i*width;
+
+    for (int w=0; w<fullWords; w++){
+      unsigned int lo = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p+w*64)), zero));
+      unsigned int hi = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p+w*64+32)), zero));
+
+      E.bits[i*E.stride+w] = ~(((unsigned long long)hi << 32) | lo);
+    } //end-for
+
+    if (fullWords < E.stride) PackEdgelsScalar(edgeImg, E, i, i+1, fullWords);
+  } //end-for
+} //end-PackEdgelsAVX2
+#endif
+
+static void PackEdgels(const unsigned char *edgeImg, EdgelMap &E, int firstRow, int lastRow){
+#if PEL_SIMD
+  static const int level = SimdLevel();
+
+  if (level >= 2){PackEdgelsAVX2(edgeImg, E, firstRow, lastRow); return;}
+  if (level >= 1){PackEdgelsSSE2(edgeImg, E, firstRow, lastRow); return;}
+#endif
+
+  PackEdgelsScalar(edgeImg, E, firstRow, lastRow);
+} //end-PackEdgels
+
+///-------------------------------------------------------------------------------
+/// Returns the # of edgels left in rows [firstRow, lastRow)
+///
+static int CountEdgels(EdgelMap &E, int firstRow, int lastRow){
+  int noEdgels = 0;
+  for (int k=firstRow*E.stride; k<lastRow*E.stride; k++) noEdgels += __builtin_popcountll(E.bits[k]);
+
+  return noEdgels;
+} //end-CountEdgels
+
+///-------------------------------------------------------------------------------
+/// Collects the offsets (r*width+c) of the edgels left in rows [firstRow, lastRow) in raster order
+///
+static int IndexEdgels(EdgelMap &E, int firstRow, int lastRow, int *edgels){
+  int noEdgels = 0;
+
+  for (int i=firstRow; i<lastRow; i++){
+    for (int w=0; w<E.stride; w++){
+      unsigned long long word = E.bits[i*E.stride+w];
+
+      while (word){
+        edgels[noEdgels++] = i*E.width + w*64 + __builtin_ctzll(word);
+        word &= word-1;
+      } //end-while
+    } //end-for
+  } //end-for
+
+  return noEdgels;
+} //end-IndexEdgels
+
 ///======================================= STEP 1: FillGaps ======================================
 ///------------------------------------------------------------------------
 /// Close gaps of 1 pixel wide between the end points of an edge map
@@ -160,115 +402,391 @@ static void FillGaps1(unsigned char *edgeImg, int width, int height){
   } //end-for
 } //end-FillGaps1
 
+///---------------------------------------------------------------------------------
+/// The edgels of a byte edge map, as FillGapAt sees them. A bit edge map (BitEdgeImg) is tested directly
+///
+struct ByteEdgels {
+  const unsigned char *edgeImg;
+  int width;
+
+  bool operator()(int r, int c) const {return edgeImg[r*width+c] == 255;}
+};
+
 ///---------------------------------------------------------------------------------
 /// Close gaps of 1 pixel wide: This joins the tip of an edge group to ANY neighbouring edgel
+/// The gap is set in E only, which the tests on the caller's edge map do not see, so the pixels can be processed in any order
 ///
-static void FillGaps2(unsigned char *edgeImg, int width, int height){
-  for (int i=2; i<height-2; i++){
-    for (int j=2; j<width-2; j++){
-      if (edgeImg[i*width+j] != 255) continue;
+template <class Edgels>
+static inline void FillGapAt(const Edgels &img, int i, int j, EdgelMap &E){
+  if (!img(i, j)) return;
 
-      int count = 0;
-      int loc = 1;
-      if (edgeImg[(i-1)*width+j] == 255) count++;
-      if (edgeImg[(i+1)*width+j] == 255){count++; loc = 2;}
-      if (edgeImg[i*width+j-1] == 255){count++; loc = 3;}
-      if (edgeImg[i*width+j+1] == 255){count++; loc = 4;}
-
-      if (edgeImg[(i-1)*width+j-1] == 255 && edgeImg[(i-1)*width+j] != 255 && edgeImg[i*width+j-1] != 255){count++; loc = 5;}
-      if (edgeImg[(i-1)*width+j+1] == 255 && edgeImg[(i-1)*width+j] != 255 && edgeImg[i*width+j+1] != 255){count++; loc = 6;}
-      if (edgeImg[(i+1)*width+j+1] == 255 && edgeImg[(i+1)*width+j] != 255 && edgeImg[i*width+j+1] != 255){count++; loc = 7;}
-      if (edgeImg[(i+1)*width+j-1] == 255 && edgeImg[(i+1)*width+j] != 255 && edgeImg[i*width+j-1] != 255){count++; loc = 8;}
-
-      if (count == 0 || count > 1) continue;
+  int count = 0;
+  int loc = 1;
+  if (img(i-1, j)) count++;
+  if (img(i+1, j)){count++; loc = 2;}
+  if (img(i, j-1)){count++; loc = 3;}
+  if (img(i, j+1)){count++; loc = 4;}
+
+  if (img(i-1, j-1) && !img(i-1, j) && !img(i, j-1)){count++; loc = 5;}
+  if (img(i-1, j+1) && !img(i-1, j) && !img(i, j+1)){count++; loc = 6;}
+  if (img(i+1, j+1) && !img(i+1, j) && !img(i, j+1)){count++; loc = 7;}
+  if (img(i+1, j-1) && !img(i+1, j) && !img(i, j-1)){count++; loc = 8;}
+
+  if (count == 0 || count > 1) return;
   
-      // Pixel at the tip of an edge group
-      if (loc == 1){
-        // Going Down
-        // P
-        // x
-        if (edgeImg[(i+2)*width+j] == 255){edgeImg[(i+1)*width+j] = 128; continue;} // Down
-
-        if (edgeImg[(i+2)*width+j+1] == 255 || edgeImg[(i+2)*width+j+2] == 255 || edgeImg[(i+1)*width+j+2] == 255){edgeImg[(i+1)*width+j+1] = 128; continue;} // Down-Right
-        if (edgeImg[(i+2)*width+j-1] == 255 || edgeImg[(i+2)*width+j-2] == 255 || edgeImg[(i+1)*width+j-2] == 255){edgeImg[(i+1)*width+j-1] = 128; continue;} // Down-Left
-
-      } else if (loc == 2){
-        // Going Up
-        // x
-        // P
-        if (edgeImg[(i-2)*width+j] == 255){edgeImg[(i-1)*width+j] = 128; continue;} // Up
-
-        if (edgeImg[(i-2)*width+j+1] == 255 || edgeImg[(i-2)*width+j+2] == 255 || edgeImg[(i-1)*width+j+2] == 255){edgeImg[(i-1)*width+j+1] = 128; continue;} // Up-Right
-        if (edgeImg[(i-2)*width+j-1] == 255 || edgeImg[(i-2)*width+j-2] == 255 || edgeImg[(i-1)*width+j-2] == 255){edgeImg[(i-1)*width+j-1] = 128; continue;} // Up-Left
-
-      } else if (loc == 3){
-        // Going Right
-        // Px
-        if (edgeImg[i*width+j+2] == 255){edgeImg[i*width+j+1] = 128; continue;} // Right
-
-        if (edgeImg[(i-2)*width+j+1] == 255 || edgeImg[(i-2)*width+j+2] == 255 || edgeImg[(i-1)*width+j+2] == 255){edgeImg[(i-1)*width+j+1] = 128; continue;} // Up-Right
-        if (edgeImg[(i+2)*width+j+1] == 255 || edgeImg[(i+2)*width+j+2] == 255 || edgeImg[(i+1)*width+j+2] == 255){edgeImg[(i+1)*width+j+1] = 128; continue;} // Down-Right
-
-      } else if (loc == 4){
-        // Going Left
-        // xP
-        if (edgeImg[i*width+j-2] == 255){edgeImg[i*width+j-1] = 128; continue;} // Left
-
-        if (edgeImg[(i-2)*width+j-1] == 255 || edgeImg[(i-2)*width+j-2] == 255 || edgeImg[(i-1)*width+j-2] == 255){edgeImg[(i-1)*width+j-1] = 128; continue;} // Up-Left
-        if (edgeImg[(i+2)*width+j-1] == 255 || edgeImg[(i+2)*width+j-2] == 255 || edgeImg[(i+1)*width+j-2] == 255){edgeImg[(i+1)*width+j-1] = 128; continue;} // Down-Left
-
-      } else if (loc == 5){
-        // Going Down-Right
-        // P
-        //  x
-        if (edgeImg[(i+2)*width+j+1] == 255 || edgeImg[(i+2)*width+j+2] == 255 || edgeImg[(i+1)*width+j+2] == 255){edgeImg[(i+1)*width+j+1] = 128; continue;} // Down-Right
-
-        if (edgeImg[i*width+j+2] == 255){edgeImg[i*width+j+1] = 128; continue;} // Down
-        if (edgeImg[i*width+j+2] == 255){edgeImg[i*width+j+1] = 128; continue;} // Right
-
-        if (edgeImg[(i+2)*width+j-1] == 255 || edgeImg[(i+2)*width+j-2] == 255 || edgeImg[(i+1)*width+j-2] == 255){edgeImg[(i+1)*width+j-1] = 128; continue;} // Down-Left
-        if (edgeImg[(i-2)*width+j+1] == 255 || edgeImg[(i-2)*width+j+2] == 255 || edgeImg[(i-1)*width+j+2] == 255){edgeImg[(i-1)*width+j+1] = 128; continue;} // Up-Right
-
-      } else if (loc == 6){
-        // Going Down-Left
-        //  P
-        // x
-        if (edgeImg[(i+2)*width+j-1] == 255 || edgeImg[(i+2)*width+j-2] == 255 || edgeImg[(i+1)*width+j-2] == 255){edgeImg[(i+1)*width+j-1] = 128; continue;} // Down-Left
-
-        if (edgeImg[i*width+j+2] == 255){edgeImg[i*width+j+1] = 128; continue;} // Down
-        if (edgeImg[i*width+j-2] == 255){edgeImg[i*width+j-1] = 128; continue;} // Left
-
-        if (edgeImg[(i+2)*width+j+1] == 255 || edgeImg[(i+2)*width+j+2] == 255 || edgeImg[(i+1)*width+j+2] == 255){edgeImg[(i+1)*width+j+1] = 128; continue;} // Down-Right
-        if (edgeImg[(i-2)*width+j-1] == 255 || edgeImg[(i-2)*width+j-2] == 255 || edgeImg[(i-1)*width+j-2] == 255){edgeImg[(i-1)*width+j-1] = 128; continue;} // Up-Left
-
-      } else if (loc == 7){
-        // Going Up-Left
-        // x
-        //  P
-        if (edgeImg[(i-2)*width+j-1] == 255 || edgeImg[(i-2)*width+j-2] == 255 || edgeImg[(i-1)*width+j-2] == 255){edgeImg[(i-1)*width+j-1] = 128; continue;} // Up-Left
-
-        if (edgeImg[(i-2)*width+j] == 255){edgeImg[(i-1)*width+j] = 128; continue;} // Up
-        if (edgeImg[i*width+j-2] == 255){edgeImg[i*width+j-1] = 128; continue;} // Left
-
-        if (edgeImg[(i-2)*width+j+1] == 255 || edgeImg[(i-2)*width+j+2] == 255 || edgeImg[(i-1)*width+j+2] == 255){edgeImg[(i-1)*width+j+1] = 128; continue;} // Up-Right
-        if (edgeImg[(i+2)*width+j-1] == 255 || edgeImg[(i+2)*width+j-2] == 255 || edgeImg[(i+1)*width+j-2] == 255){edgeImg[(i+1)*width+j-1] = 128; continue;} // Down-Left
-
-      } else { //if (loc == 8){
-        // Going Up-Right
-        //  x
-        // P
-        if (edgeImg[(i-2)*width+j+1] == 255 || edgeImg[(i-2)*width+j+2] == 255 || edgeImg[(i-1)*width+j+2] == 255){edgeImg[(i-1)*width+j+1] = 128; continue;} // Up-Right
-
-        if (edgeImg[(i-2)*width+j] == 255){edgeImg[(i-1)*width+j] = 128; continue;} // Up
-        if (edgeImg[i*width+j+2] == 255){edgeImg[i*width+j+1] = 128; continue;} // Right
-
-        if (edgeImg[(i-2)*width+j-1] == 255 || edgeImg[(i-2)*width+j-2] == 255 || edgeImg[(i-1)*width+j-2] == 255){edgeImg[(i-1)*width+j-1] = 128; continue;} // Up-Left
-        if (edgeImg[(i+2)*width+j+1] == 255 || edgeImg[(i+2)*width+j+2] == 255 || edgeImg[(i+1)*width+j+2] == 255){edgeImg[(i+1)*width+j+1] = 128; continue;} // Down-Right
-      } //end-else 
+  // Pixel at the tip of an edge group
+  if (loc == 1){
+    // Going Down
+    // P
+    // x
+    if (img(i+2, j)){E.Put(i+1, j); return;} // Down
+
+    if (img(i+2, j+1) || img(i+2, j+2) || img(i+1, j+2)){E.Put(i+1, j+1); return;} // Down-Right
+    if (img(i+2, j-1) || img(i+2, j-2) || img(i+1, j-2)){E.Put(i+1, j-1); return;} // Down-Left
+
+  } else if (loc == 2){
+    // Going Up
+    // x
+    // P
+    if (img(i-2, j)){E.Put(i-1, j); return;} // Up
+
+    if (img(i-2, j+1) || img(i-2, j+2) || img(i-1, j+2)){E.Put(i-1, j+1); return;} // Up-Right
+    if (img(i-2, j-1) || img(i-2, j-2) || img(i-1, j-2)){E.Put(i-1, j-1); return;} // Up-Left
+
+  } else if (loc == 3){
+    // Going Right
+    // Px
+    if (img(i, j+2)){E.Put(i, j+1); return;} // Right
+
+    if (img(i-2, j+1) || img(i-2, j+2) || img(i-1, j+2)){E.Put(i-1, j+1); return;} // Up-Right
+    if (img(i+2, j+1) || img(i+2, j+2) || img(i+1, j+2)){E.Put(i+1, j+1); return;} // Down-Right
+
+  } else if (loc == 4){
+    // Going Left
+    // xP
+    if (img(i, j-2)){E.Put(i, j-1); return;} // Left
+
+    if (img(i-2, j-1) || img(i-2, j-2) || img(i-1, j-2)){E.Put(i-1, j-1); return;} // Up-Left
+    if (img(i+2, j-1) || img(i+2, j-2) || img(i+1, j-2)){E.Put(i+1, j-1); return;} // Down-Left
+
+  } else if (loc == 5){
+    // Going Down-Right
+    // P
+    //  x
+    if (img(i+2, j+1) || img(i+2, j+2) || img(i+1, j+2)){E.Put(i+1, j+1); return;} // Down-Right
+
+    if (img(i, j+2)){E.Put(i, j+1); return;} // Down
+    if (img(i, j+2)){E.Put(i, j+1); return;} // Right
+
+    if (img(i+2, j-1) || img(i+2, j-2) || img(i+1, j-2)){E.Put(i+1, j-1); return;} // Down-Left
+    if (img(i-2, j+1) || img(i-2, j+2) || img(i-1, j+2)){E.Put(i-1, j+1); return;} // Up-Right
+
+  } else if (loc == 6){
+    // Going Down-Left
+    //  P
+    // x
+    if (img(i+2, j-1) || img(i+2, j-2) || img(i+1, j-2)){E.Put(i+1, j-1); return;} // Down-Left
+
+    if (img(i, j+2)){E.Put(i, j+1); return;} // Down
+    if (img(i, j-2)){E.Put(i, j-1); return;} // Left
+
+    if (img(i+2, j+1) || img(i+2, j+2) || img(i+1, j+2)){E.Put(i+1, j+1); return;} // Down-Right
+    if (img(i-2, j-1) || img(i-2, j-2) || img(i-1, j-2)){E.Put(i-1, j-1); return;} // Up-Left
+
+  } else if (loc == 7){
+    // Going Up-Left
+    // x
+    //  P
+    if (img(i-2, j-1) || img(i-2, j-2) || img(i-1, j-2)){E.Put(i-1, j-1); return;} // Up-Left
+
+    if (img(i-2, j)){E.Put(i-1, j); return;} // Up
+    if (img(i, j-2)){E.Put(i, j-1); return;} // Left
+
+    if (img(i-2, j+1) || img(i-2, j+2) || img(i-1, j+2)){E.Put(i-1, j+1); return;} // Up-Right
+    if (img(i+2, j-1) || img(i+2, j-2) || img(i+1, j-2)){E.Put(i+1, j-1); return;} // Down-Left
+
+  } else { //if (loc == 8){
+    // Going Up-Right
+    //  x
+    // P
+    if (img(i-2, j+1) || img(i-2, j+2) || img(i-1, j+2)){E.Put(i-1, j+1); return;} // Up-Right
+
+    if (img(i-2, j)){E.Put(i-1, j); return;} // Up
+    if (img(i, j+2)){E.Put(i, j+1); return;} // Right
+
+    if (img(i-2, j-1) || img(i-2, j-2) || img(i-1, j-2)){E.Put(i-1, j-1); return;} // Up-Left
+    if (img(i+2, j+1) || img(i+2, j+2) || img(i+1, j+2)){E.Put(i+1, j+1); return;} // Down-Right
+  } //end-else 
+} //end-FillGapAt
+
+///---------------------------------------------------------------------------------
+/// Looks at the tips in rows [firstRow, lastRow). This is the reference for the vectorized versions below
+///
+static void FillGapsInRowsScalar(const unsigned char *edgeImg, EdgelMap &E, int firstRow, int lastRow){
+  int width = E.width;
+  ByteEdgels img = {edgeImg, width};
+
+  for (int i=firstRow; i<lastRow; i++){
+    for (int j=2; j<width-2; j++) FillGapAt(img, i, j, E);
+  } //end-for
+} //end-FillGapsInRowsScalar
+
+#if PEL_SIMD
+///---------------------------------------------------------------------------------
+/// Most pixels are not edgels, & most edgels have 2 neighbors. So the SIMD versions count the neighbors of
+/// 16 (SSE2) or 32 (AVX2) pixels at once & only hand the tips over to FillGapAt. With the compare masks being
+/// -1, the sum of the masks is -(# of neighbors)
+///
+__attribute__((target("sse2")))
+static void FillGapsInRowsSSE2(const unsigned char *edgeImg, EdgelMap &E, int firstRow, int lastRow){
+  int width = E.width;
+  ByteEdgels img = {edgeImg, width};
+  const __m128i v255 = _mm_set1_epi8((char)255);
+  const __m128i minusOne = _mm_set1_epi8(-1);
+
+  for (int i=firstRow; i<lastRow; i++){
+    const unsigned char *p = edgeImg + i*width;
+    int j = 2;
+
+    for (; j+16 <= width-2; j+=16){
+      __m128i C = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p+j)), v255);
+      if (_mm_movemask_epi8(C) == 0) continue;     // No edgels here
+
+      __m128i U  = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p-width+j)), v255);
+      __m128i D  = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p+width+j)), v255);
+      __m128i L  = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p+j-1)), v255);
+      __m128i R  = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p+j+1)), v255);
+      __m128i UL = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p-width+j-1)), v255);
+      __m128i UR = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p-width+j+1)), v255);
+      __m128i DR = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p+width+j+1)), v255);
+      __m128i DL = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p+width+j-1)), v255);
+
+      // Diagonal neighbors only count if the 2 pixels between them & the center are not edgels
+      __m128i sum = _mm_add_epi8(_mm_add_epi8(U, D), _mm_add_epi8(L, R));
+      sum = _mm_add_epi8(sum, _mm_andnot_si128(_mm_or_si128(U, L), UL));
+      sum = _mm_add_epi8(sum, _mm_andnot_si128(_mm_or_si128(U, R), UR));
+      sum = _mm_add_epi8(sum, _mm_andnot_si128(_mm_or_si128(D, R), DR));
+      sum = _mm_add_epi8(sum, _mm_andnot_si128(_mm_or_si128(D, L), DL));
+
+      unsigned int tips = _mm_movemask_epi8(_mm_and_si128(C, _mm_cmpeq_epi8(sum, minusOne)));
+      while (tips){
+        FillGapAt(img, i, j+__builtin_ctz(tips), E);
+        tips &= tips-1;
+      } //end-while
+    } //end-for
+
+    for (; j<width-2; j++) FillGapAt(img, i, j, E);
+  } //end-for
+} //end-FillGapsInRowsSSE2
+
+__attribute__((target("avx2")))
+static void FillGapsInRowsAVX2(const unsigned char *edgeImg, EdgelMap &E, int firstRow, int lastRow){
+  int width = E.width;
+  ByteEdgels img = {edgeImg, width};
+  const __m256i v255 = _mm256_set1_epi8((char)255);
+  const __m256i minusOne = _mm256_set1_epi8(-1);
+
+  for (int i=firstRow; i<lastRow; i++){
+    const unsigned char *p = edgeImg + i*width;
+    int j = 2;
+
+    for (; j+32 <= width-2; j+=32){
+      __m256i C = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p+j)), v255);
+      if (_mm256_testz_si256(C, C)) continue;      // No edgels here
+
+      __m256i U  = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p-width+j)), v255);
+      __m256i D  = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p+width+j)), v255);
+      __m256i L  = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p+j-1)), v255);
+      __m256i R  = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p+j+1)), v255);
+      __m256i UL = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p-width+j-1)), v255);
+      __m256i UR = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p-width+j+1)), v255);
+      __m256i DR = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p+width+j+1)), v255);
+      __m256i DL = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p+width+j-1)), v255);
+
+      __m256i sum = _mm256_add_epi8(_mm256_add_epi8(U, D), _mm256_add_epi8(L, R));
+      sum = _mm256_add_epi8(sum, _mm256_andnot_si256(_mm256_or_si256(U, L), UL));
+      sum = _mm256_add_epi8(sum, _mm256_andnot_si256(_mm256_or_si256(U, R), UR));
+      sum = _mm256_add_epi8(sum, _mm256_andnot_si256(_mm256_or_si256(D, R), DR));
+      sum = _mm256_add_epi8(sum, _mm256_andnot_si256(_mm256_or_si256(D, L), DL));
+
+      unsigned int tips = _mm256_movemask_epi8(_mm256_and_si256(C, _mm256_cmpeq_epi8(sum, minusOne)));
+      while (tips){
+        FillGapAt(img, i, j+__builtin_ctz(tips), E);
+        tips &= tips-1;
+      } //end-while
     } //end-for
+
+    for (; j<width-2; j++) FillGapAt(img, i, j, E);
   } //end-for
+} //end-FillGapsInRowsAVX2
+#endif
+
+///---------------------------------------------------------------------------------
+/// Pixel c-1 (West) & c+1 (East) of the row, lined up with pixel c
+///
+static inline unsigned long long West(const unsigned long long *row, int w){
+  return (row[w] << 1) | (w > 0 ? row[w-1] >> 63 : 0);
+} //end-West
+
+static inline unsigned long long East(const unsigned long long *row, int w, int stride){
+  return (row[w] >> 1) | (w+1 < stride ? row[w+1] << 63 : 0);
+} //end-East
+
+///---------------------------------------------------------------------------------
+/// Looks at the tips in rows [firstRow, lastRow) of a bit edge map, 64 pixels at a time. "any" collects the pixels
+/// that have seen a neighbor, "many" the ones that have seen 2 or more, so the tips are the edgels in any & not in many
+///
+static void FillGapsInRowsBits(const BitEdgeImg *img, EdgelMap &E, int firstRow, int lastRow){
+  int width = img->width;
+  int stride = img->stride;
+
+  for (int i=firstRow; i<lastRow; i++){
+    const unsigned long long *up = img->bits + (i-1)*stride;
+    const unsigned long long *row = img->bits + i*stride;
+    const unsigned long long *down = img->bits + (i+1)*stride;
+
+    for (int w=0; w<stride; w++){
+      // Only the pixels 2..width-3 are looked at
+      unsigned long long C = row[w];
+      if (w == 0) C &= ~3ULL;
+
+      int n = width-2 - w*64;
+      if (n < 64) C &= n > 0 ? (1ULL << n)-1 : 0;
+      if (C == 0) continue;
+
+      unsigned long long U = up[w];
+      unsigned long long D = down[w];
+      unsigned long long L = West(row, w);
+      unsigned long long R = East(row, w, stride);
+
+      // Diagonal neighbors only count if the 2 pixels between them & the center are not edgels
+      unsigned long long N[8] = {U, D, L, R,
+                                 West(up, w) & ~(U|L), East(up, w, stride) & ~(U|R),
+                                 East(down, w, stride) & ~(D|R), West(down, w) & ~(D|L)};
+
+      unsigned long long any = 0, many = 0;
+      for (int k=0; k<8; k++){
+        many |= any & N[k];
+        any |= N[k];
+      } //end-for
 
-  for (int i=0; i<width*height; i++) if (edgeImg[i] == 128) edgeImg[i] = 255;
+      unsigned long long tips = C & any & ~many;
+      while (tips){
+        FillGapAt(*img, i, w*64+__builtin_ctzll(tips), E);
+        tips &= tips-1;
+      } //end-while
+    } //end-for
+  } //end-for
+} //end-FillGapsInRowsBits
+
+///---------------------------------------------------------------------------------
+/// Looks at the tips in rows [firstRow, lastRow) with the best kernel the CPU supports.
+/// The caller's edge map is either a byte map (edgeImg) or a bit map (bitImg); the other one is NULL
+///
+static void FillGapsInRows(const unsigned char *edgeImg, const BitEdgeImg *bitImg, EdgelMap &E, int firstRow, int lastRow){
+  if (firstRow < 2) firstRow = 2;
+  if (lastRow > E.height-2) lastRow = E.height-2;
+
+  if (bitImg){FillGapsInRowsBits(bitImg, E, firstRow, lastRow); return;}
+
+#if PEL_SIMD
+  static const int level = SimdLevel();
+
+  if (level >= 2){FillGapsInRowsAVX2(edgeImg, E, firstRow, lastRow); return;}
+  if (level >= 1){FillGapsInRowsSSE2(edgeImg, E, firstRow, lastRow); return;}
+#endif
+
+  FillGapsInRowsScalar(edgeImg, E, firstRow, lastRow);
+} //end-FillGapsInRows
+
+///---------------------------------------------------------------------------------
+/// Puts the edgels of rows [firstRow, lastRow) of the caller's edge map into E. A bit map has E's layout already
+///
+static void LoadEdgels(const unsigned char *edgeImg, const BitEdgeImg *bitImg, EdgelMap &E, int firstRow, int lastRow){
+  if (bitImg){
+    memcpy(E.bits + firstRow*E.stride, bitImg->bits + firstRow*E.stride, sizeof(unsigned long long)*E.stride*(lastRow-firstRow));
+    return;
+  } //end-if
+
+  PackEdgels(edgeImg, E, firstRow, lastRow);
+} //end-LoadEdgels
+
+struct FillGapsJob {
+  const unsigned char *edgeImg;
+  const BitEdgeImg *bitImg;
+  EdgelMap *E;
+  int numThreads;
+  int *noEdgels;             // # of edgels in each band
+};
+
+static void LoadEdgelsInBand(int t, void *arg){
+  FillGapsJob *job = (FillGapsJob *)arg;
+
+  int firstRow = BandStart(t, job->numThreads, job->E->height);
+  int lastRow = BandStart(t+1, job->numThreads, job->E->height);
+
+  LoadEdgels(job->edgeImg, job->bitImg, *job->E, firstRow, lastRow);
+} //end-LoadEdgelsInBand
+
+///---------------------------------------------------------------------------------
+/// A tip at row i reads rows i-2..i+2 & sets a gap in rows i-1..i+1. So the tips that are at least 3 rows away
+/// from the band's edges only touch the band's own rows & leave the 2 rows along the band's edges intact
+///
+static void FillGapsInBand(int t, void *arg){
+  FillGapsJob *job = (FillGapsJob *)arg;
+
+  int firstRow = BandStart(t, job->numThreads, job->E->height);
+  int lastRow = BandStart(t+1, job->numThreads, job->E->height);
+
+  FillGapsInRows(job->edgeImg, job->bitImg, *job->E, firstRow+3, lastRow-3);
+} //end-FillGapsInBand
+
+static void CountEdgelsInBand(int t, void *arg){
+  FillGapsJob *job = (FillGapsJob *)arg;
+
+  int firstRow = BandStart(t, job->numThreads, job->E->height);
+  int lastRow = BandStart(t+1, job->numThreads, job->E->height);
+
+  job->noEdgels[t] = CountEdgels(*job->E, firstRow, lastRow);
+} //end-CountEdgelsInBand
+
+///---------------------------------------------------------------------------------
+/// Close gaps of 1 pixel wide. Fills E with the edgels of the caller's edge map & the gaps. Returns the # of edgels in E
+/// With several threads, the band interiors are filled in parallel & the rows along the band seams afterwards
+///
+static int FillGaps2(const unsigned char *edgeImg, const BitEdgeImg *bitImg, EdgelMap &E, int numThreads){
+  PROFILE_STAGE("PEL FillGaps");
+
+  int height = E.height;
+  numThreads = ClampNumThreads(numThreads, height);
+
+  if (numThreads == 1){
+    LoadEdgels(edgeImg, bitImg, E, 0, height);
+    FillGapsInRows(edgeImg, bitImg, E, 2, height-2);
+    return CountEdgels(E, 0, height);
+  } //end-if
+
+  int *noEdgels = new int[numThreads];
+  FillGapsJob job = {edgeImg, bitImg, &E, numThreads, noEdgels};
+
+  RunThreads(numThreads, LoadEdgelsInBand, &job);
+  RunThreads(numThreads, FillGapsInBand, &job);
+
+  for (int t=0; t<numThreads; t++){
+    int firstRow = BandStart(t, numThreads, height);
+    int lastRow = BandStart(t+1, numThreads, height);
+
+    FillGapsInRows(edgeImg, bitImg, E, firstRow, firstRow+3);
+    FillGapsInRows(edgeImg, bitImg, E, lastRow-3 > firstRow+3 ? lastRow-3 : firstRow+3, lastRow);
+  } //end-for
+
+  RunThreads(numThreads, CountEdgelsInBand, &job);
+
+  int total = 0;
+  for (int t=0; t<numThreads; t++) total += noEdgels[t];
+
+  delete[] noEdgels;
+  return total;
 } //end-FillGaps2
 
 
@@ -284,104 +802,77 @@ static void FillGaps2(unsigned char *edgeImg, int width, int height){
 
 ///-----------------------------------------------------------------------------------------------
 /// Next direction prediction engine (Use the last 8 directions to make a prediction for the next)
+/// Only the # of times each direction occurs in the last 8 matters. These counts (0..8) are kept in 4 bit fields,
+/// field dir-1 for direction dir, & updated in O(1) as directions come & go. A prediction weighs the directions
+/// of one candidate against those of the other: the counts are picked out by a mask & summed by a multiply
 ///
 struct Queue {
 #define QSIZE 8
   int Q[QSIZE];
   int noItems;
   int rear;
+  unsigned int counts;
 
-  Queue(){noItems = 0; rear = 0;}
+  Queue(){noItems = 0; rear = 0; counts = 0;}
 
    void Add(int dir){
+    if (noItems == QSIZE) counts -= 1U << 4*(Q[rear]-1);
+    else                  noItems++;
+
+    counts += 1U << 4*(dir-1);
     Q[rear++] = dir;
     if (rear >= QSIZE) rear = 0;
-    if (noItems < QSIZE) noItems++;
   } //end-add
 
   int ComputeNextDir(int analysisDir){
-    int C[2] = {0, 0};
-
-    if (analysisDir == LEFT || analysisDir == RIGHT){
-      // LEFT or RIGHT
-      for (int i=0; i<noItems; i++){
-        if (Q[i] == UP || Q[i] == DOWN) continue;
-
-        if (Q[i] == LEFT || Q[i] == DOWN_LEFT || Q[i] == UP_LEFT) C[0]++;
-        else                                                      C[1]++;
-     } //end-for
-
-      if (C[0] >= C[1]) return LEFT;
-      else              return RIGHT;
-
-    } else if (analysisDir == UP || analysisDir == DOWN){
-      // UP or DOWN
-      for (int i=0; i<noItems; i++){
-        if (Q[i] == LEFT || Q[i] == RIGHT) continue;
-
-        if (Q[i] == UP || Q[i] == UP_LEFT || Q[i] == UP_RIGHT) C[0]++;
-        else                                                   C[1]++;
-      } //end-for
-
-      if (C[0] >= C[1]) return UP;
-      else              return DOWN;
-
-    } else if (analysisDir == UP_LEFT){
-      // UP or LEFT
-      for (int i=0; i<noItems; i++){
-        if      (Q[i] == UP)   C[0]++;
-        else if (Q[i] == LEFT) C[1]++;
-      } //end-for
-
-      if (C[0] >= C[1]) return UP;
-      else              return LEFT;
-
-    } else if (analysisDir == UP_RIGHT){
-      // UP or RIGHT
-      for (int i=0; i<noItems; i++){
-        if      (Q[i] == UP)    C[0]++;
-        else if (Q[i] == RIGHT) C[1]++;
-      } //end-for
-
-      if (C[0] >= C[1]) return UP;
-      else              return RIGHT;
-
-    } else if (analysisDir == DOWN_RIGHT){
-      // DOWN or RIGHT
-      for (int i=0; i<noItems; i++){
-        if      (Q[i] == DOWN)  C[0]++;
-        else if (Q[i] == RIGHT) C[1]++;
-      } //end-for
-
-      if (C[0] >= C[1]) return DOWN;
-      else              return RIGHT;
-
-    } else { //if (analysisDir == DOWN_LEFT){
-      // DOWN or LEFT
-      for (int i=0; i<noItems; i++){
-        if      (Q[i] == DOWN)  C[0]++;
-        else if (Q[i] == LEFT) C[1]++;
-      } //end-for
-
-      if (C[0] >= C[1]) return DOWN;
-      else              return LEFT;
-    } // end-else
+#define F(dir) (0xFU << 4*((dir)-1))
+    // For each analysis direction: the 2 candidates & the directions that vote for each
+    static const int dirs[9][2] = {
+      {0, 0},
+      {UP, LEFT},             // UP_LEFT
+      {UP, DOWN},             // UP
+      {UP, RIGHT},            // UP_RIGHT
+      {LEFT, RIGHT},          // RIGHT
+      {DOWN, RIGHT},          // DOWN_RIGHT
+      {UP, DOWN},             // DOWN
+      {DOWN, LEFT},           // DOWN_LEFT
+      {LEFT, RIGHT}           // LEFT
+    };
+
+    static const unsigned int votes[9][2] = {
+      {0, 0},
+      {F(UP), F(LEFT)},
+      {F(UP)|F(UP_LEFT)|F(UP_RIGHT), F(DOWN)|F(DOWN_LEFT)|F(DOWN_RIGHT)},
+      {F(UP), F(RIGHT)},
+      {F(LEFT)|F(DOWN_LEFT)|F(UP_LEFT), F(RIGHT)|F(UP_RIGHT)|F(DOWN_RIGHT)},
+      {F(DOWN), F(RIGHT)},
+      {F(UP)|F(UP_LEFT)|F(UP_RIGHT), F(DOWN)|F(DOWN_LEFT)|F(DOWN_RIGHT)},
+      {F(DOWN), F(LEFT)},
+      {F(LEFT)|F(DOWN_LEFT)|F(UP_LEFT), F(RIGHT)|F(UP_RIGHT)|F(DOWN_RIGHT)}
+    };
+#undef F
+
+    // The sum of the picked fields is at most 8, so it ends up in the top field without carries
+    unsigned int C0 = ((counts & votes[analysisDir][0])*0x11111111U) >> 28;
+    unsigned int C1 = ((counts & votes[analysisDir][1])*0x11111111U) >> 28;
+
+    return dirs[analysisDir][C0 < C1];
   } //end-ComputeNextDir
 };
 
 ///----------------------------------------------------------------------------------------------------
 /// 8 Directional Walk with Prediction
 ///
-static int Walk8Dirs(unsigned char *edgeImg, int width, int height, int r, int c, int dir, Pixel *pixels){
+static int Walk8Dirs(EdgelMap &E, int r, int c, int dir, Pixel *pixels){
   Queue Q;
 
   int count = 0;
 
   while (1){
-    edgeImg[r*width+c] = 0;
+    E.Take(r, c);
 
-    if (r<=0 || r>=height-1) return count;
-    if (c<=0 || c>=width-1) return count;
+    if (r<=0 || r>=E.height-1) return count;
+    if (c<=0 || c>=E.width-1) return count;
 
     pixels[count].r = r;
     pixels[count].c = c;
@@ -395,29 +886,29 @@ static int Walk8Dirs(unsigned char *edgeImg, int width, int height, int r, int c
       int nextDir = Q.ComputeNextDir(UP_LEFT);
 
       // Up-Left?
-      if (edgeImg[(r-1)*width+c-1]){
+      if (E(r-1, c-1)){
         if (nextDir == UP){
           // Up?
-          if (edgeImg[(r-1)*width+c]){
+          if (E(r-1, c)){
             pixels[count].r = r-1; pixels[count].c = c; count++;
-            edgeImg[(r-1)*width+c] = 0;
+            E.Take(r-1, c);
 
           // Left?
-          } else if (edgeImg[r*width+c-1]){
+          } else if (E(r, c-1)){
             pixels[count].r = r; pixels[count].c = c-1; count++;
-            edgeImg[r*width+c-1] = 0;
+            E.Take(r, c-1);
           } //end-else
 
         } else {
           // Left?
-          if (edgeImg[r*width+c-1]){
+          if (E(r, c-1)){
             pixels[count].r = r; pixels[count].c = c-1; count++;
-            edgeImg[r*width+c-1] = 0;
+            E.Take(r, c-1);
 
           // Up?
-          } else if (edgeImg[(r-1)*width+c]){
+          } else if (E(r-1, c)){
             pixels[count].r = r-1; pixels[count].c = c; count++;
-            edgeImg[(r-1)*width+c] = 0;
+            E.Take(r-1, c);
           } //end-else
         } //end-else
 
@@ -426,41 +917,41 @@ static int Walk8Dirs(unsigned char *edgeImg, int width, int height, int r, int c
 
       if (nextDir == UP){
         // Up
-        if (edgeImg[(r-1)*width+c]){r--; dir = UP; continue;}
+        if (E(r-1, c)){r--; dir = UP; continue;}
 
         // Left
-        if (edgeImg[r*width+c-1]){c--; dir = LEFT; continue;}
+        if (E(r, c-1)){c--; dir = LEFT; continue;}
 
         // Up-Right
-        if (edgeImg[(r-1)*width+c+1]){r--; c++; dir = UP_RIGHT; continue;}
+        if (E(r-1, c+1)){r--; c++; dir = UP_RIGHT; continue;}
 
         // Down-Left
-        if (edgeImg[(r+1)*width+c-1]){r++; c--; dir = DOWN_LEFT; continue;}
+        if (E(r+1, c-1)){r++; c--; dir = DOWN_LEFT; continue;}
 
         // Right
-        if (edgeImg[r*width+c+1]){c++; dir = RIGHT; continue;}
+        if (E(r, c+1)){c++; dir = RIGHT; continue;}
 
         // Down
-        if (edgeImg[(r+1)*width+c]){r++; dir = DOWN; continue;}
+        if (E(r+1, c)){r++; dir = DOWN; continue;}
 
       } else {
         // Left
-        if (edgeImg[r*width+c-1]){c--; dir = LEFT; continue;}
+        if (E(r, c-1)){c--; dir = LEFT; continue;}
 
         // Up
-        if (edgeImg[(r-1)*width+c]){r--; dir = UP; continue;}
+        if (E(r-1, c)){r--; dir = UP; continue;}
 
         // Down-Left
-        if (edgeImg[(r+1)*width+c-1]){r++; c--; dir = DOWN_LEFT; continue;}
+        if (E(r+1, c-1)){r++; c--; dir = DOWN_LEFT; continue;}
 
         // Up-Right
-        if (edgeImg[(r-1)*width+c+1]){r--; c++; dir = UP_RIGHT; continue;}
+        if (E(r-1, c+1)){r--; c++; dir = UP_RIGHT; continue;}
 
         // Down
-        if (edgeImg[(r+1)*width+c]){r++; dir = DOWN; continue;}
+        if (E(r+1, c)){r++; dir = DOWN; continue;}
 
         // Right
-        if (edgeImg[r*width+c+1]){c++; dir = RIGHT; continue;}
+        if (E(r, c+1)){c++; dir = RIGHT; continue;}
       } //end-else
 
       // Nowhere to go
@@ -468,60 +959,60 @@ static int Walk8Dirs(unsigned char *edgeImg, int width, int height, int r, int c
 
     } else if (dir == UP){
       // Up
-      if (edgeImg[(r-1)*width+c]){r--; dir = UP; continue;}
+      if (E(r-1, c)){r--; dir = UP; continue;}
 
       // Should we check LEFT or RIGHT first?
       int nextDir = Q.ComputeNextDir(LEFT);
 
       if (nextDir == LEFT){
         // Up-Left
-        if (edgeImg[(r-1)*width+c-1]){
-          if (edgeImg[r*width+c-1]){edgeImg[r*width+c-1] = 0; pixels[count].r = r; pixels[count].c = c-1; count++;}
+        if (E(r-1, c-1)){
+          if (E(r, c-1)){E.Take(r, c-1); pixels[count].r = r; pixels[count].c = c-1; count++;}
           r--; c--; dir = UP_LEFT; continue;
         } //end-if
 
         // Up-Right
-        if (edgeImg[(r-1)*width+c+1]){
-          if (edgeImg[r*width+c+1]){edgeImg[r*width+c+1]= 0; pixels[count].r = r; pixels[count].c = c+1; count++;}
+        if (E(r-1, c+1)){
+          if (E(r, c+1)){E.Take(r, c+1); pixels[count].r = r; pixels[count].c = c+1; count++;}
           r--; c++; dir = UP_RIGHT; continue;
         } //end-if
 
         // Left
-        if (edgeImg[r*width+c-1]){c--; dir = LEFT; continue;}
+        if (E(r, c-1)){c--; dir = LEFT; continue;}
 
         // Right
-        if (edgeImg[r*width+c+1]){c++; dir = RIGHT; continue;}
+        if (E(r, c+1)){c++; dir = RIGHT; continue;}
 
         // Down-Left
-        if (edgeImg[(r+1)*width+c-1]){r++; c--; dir = DOWN_LEFT; continue;}
+        if (E(r+1, c-1)){r++; c--; dir = DOWN_LEFT; continue;}
 
         // Down-Right
-        if (edgeImg[(r+1)*width+c+1]){r++; c++; dir = DOWN_RIGHT; continue;}
+        if (E(r+1, c+1)){r++; c++; dir = DOWN_RIGHT; continue;}
 
       } else {
         // Up-Right
-        if (edgeImg[(r-1)*width+c+1]){
-          if (edgeImg[r*width+c+1]){edgeImg[r*width+c+1]= 0; pixels[count].r = r; pixels[count].c = c+1; count++;}
+        if (E(r-1, c+1)){
+          if (E(r, c+1)){E.Take(r, c+1); pixels[count].r = r; pixels[count].c = c+1; count++;}
           r--; c++; dir = UP_RIGHT; continue;
         } //end-if
 
         // Up-Left
-        if (edgeImg[(r-1)*width+c-1]){
-          if (edgeImg[r*width+c-1]){edgeImg[r*width+c-1] = 0; pixels[count].r = r; pixels[count].c = c-1; count++;}
+        if (E(r-1, c-1)){
+          if (E(r, c-1)){E.Take(r, c-1); pixels[count].r = r; pixels[count].c = c-1; count++;}
           r--; c--; dir = UP_LEFT; continue;
         } //end-if
 
         // Right
-        if (edgeImg[r*width+c+1]){c++; dir = RIGHT; continue;}
+        if (E(r, c+1)){c++; dir = RIGHT; continue;}
 
         // Left
-        if (edgeImg[r*width+c-1]){c--; dir = LEFT; continue;}
+        if (E(r, c-1)){c--; dir = LEFT; continue;}
 
         // Down-Right
-        if (edgeImg[(r+1)*width+c+1]){r++; c++; dir = DOWN_RIGHT; continue;}
+        if (E(r+1, c+1)){r++; c++; dir = DOWN_RIGHT; continue;}
 
         // Down-Left
-        if (edgeImg[(r+1)*width+c-1]){r++; c--; dir = DOWN_LEFT; continue;}
+        if (E(r+1, c-1)){r++; c--; dir = DOWN_LEFT; continue;}
       } //end-else
 
       // Nowhere to go
@@ -532,29 +1023,29 @@ static int Walk8Dirs(unsigned char *edgeImg, int width, int height, int r, int c
       int nextDir = Q.ComputeNextDir(UP_RIGHT);
 
       // Up-Right
-      if (edgeImg[(r-1)*width+c+1]){
+      if (E(r-1, c+1)){
         if (nextDir == UP){
           // Up?
-          if (edgeImg[(r-1)*width+c]){
+          if (E(r-1, c)){
             pixels[count].r = r-1; pixels[count].c = c; count++;
-            edgeImg[(r-1)*width+c] = 0;
+            E.Take(r-1, c);
 
           // Right?
-          } else if (edgeImg[r*width+c+1]){
+          } else if (E(r, c+1)){
             pixels[count].r = r; pixels[count].c = c+1; count++;
-            edgeImg[r*width+c+1] = 0;
+            E.Take(r, c+1);
           } //end-else
 
         } else {
           // Right?
-          if (edgeImg[r*width+c+1]){
+          if (E(r, c+1)){
             pixels[count].r = r; pixels[count].c = c+1; count++;
-            edgeImg[r*width+c+1] = 0;
+            E.Take(r, c+1);
 
           // Up?
-          } else if (edgeImg[(r-1)*width+c]){
+          } else if (E(r-1, c)){
             pixels[count].r = r-1; pixels[count].c = c; count++;
-            edgeImg[(r-1)*width+c] = 0;
+            E.Take(r-1, c);
           } //end-else
         } //end-else
 
@@ -563,41 +1054,41 @@ static int Walk8Dirs(unsigned char *edgeImg, int width, int height, int r, int c
 
       if (nextDir == UP){
         // Up
-        if (edgeImg[(r-1)*width+c]){r--; dir = UP; continue;}
+        if (E(r-1, c)){r--; dir = UP; continue;}
 
         // Right
-        if (edgeImg[r*width+c+1]){c++; dir = RIGHT; continue;}
+        if (E(r, c+1)){c++; dir = RIGHT; continue;}
 
         // Up-Left
-        if (edgeImg[(r-1)*width+c-1]){r--; c--; dir = UP_LEFT; continue;}
+        if (E(r-1, c-1)){r--; c--; dir = UP_LEFT; continue;}
 
         // Down-Right
-        if (edgeImg[(r+1)*width+c+1]){r++; c++; dir = DOWN_RIGHT; continue;}
+        if (E(r+1, c+1)){r++; c++; dir = DOWN_RIGHT; continue;}
 
         // Left
-        if (edgeImg[r*width+c-1]){c--; dir = LEFT; continue;}
+        if (E(r, c-1)){c--; dir = LEFT; continue;}
 
         // Down
-        if (edgeImg[(r+1)*width+c]){r++; dir = DOWN; continue;}
+        if (E(r+1, c)){r++; dir = DOWN; continue;}
 
       } else {
         // Right
-        if (edgeImg[r*width+c+1]){c++; dir = RIGHT; continue;}
+        if (E(r, c+1)){c++; dir = RIGHT; continue;}
 
         // Up
-        if (edgeImg[(r-1)*width+c]){r--; dir = UP; continue;}
+        if (E(r-1, c)){r--; dir = UP; continue;}
 
         // Down-Right
-        if (edgeImg[(r+1)*width+c+1]){r++; c++; dir = DOWN_RIGHT; continue;}
+        if (E(r+1, c+1)){r++; c++; dir = DOWN_RIGHT; continue;}
 
         // Up-Left
-        if (edgeImg[(r-1)*width+c-1]){r--; c--; dir = UP_LEFT; continue;}
+        if (E(r-1, c-1)){r--; c--; dir = UP_LEFT; continue;}
 
         // Down
-        if (edgeImg[(r+1)*width+c]){r++; dir = DOWN; continue;}
+        if (E(r+1, c)){r++; dir = DOWN; continue;}
 
         // Left
-        if (edgeImg[r*width+c-1]){c--; dir = LEFT; continue;}
+        if (E(r, c-1)){c--; dir = LEFT; continue;}
       } //end-else
 
       // Nowhere to go
@@ -605,60 +1096,60 @@ static int Walk8Dirs(unsigned char *edgeImg, int width, int height, int r, int c
 
     } else if (dir == RIGHT){
       // Right
-      if (edgeImg[r*width+c+1]){c++; dir = RIGHT; continue;}
+      if (E(r, c+1)){c++; dir = RIGHT; continue;}
 
       // Should we check UP or DOWN first?
       int nextDir = Q.ComputeNextDir(UP);
 
       if (nextDir == UP){
         // Up-Right
-        if (edgeImg[(r-1)*width+c+1]){
-          if (edgeImg[(r-1)*width+c]){edgeImg[(r-1)*width+c]= 0; pixels[count].r = r-1; pixels[count].c = c; count++;}
+        if (E(r-1, c+1)){
+          if (E(r-1, c)){E.Take(r-1, c); pixels[count].r = r-1; pixels[count].c = c; count++;}
           r--; c++; dir = UP_RIGHT; continue;
         } //end-if
 
         // Down-Right
-        if (edgeImg[(r+1)*width+c+1]){
-          if (edgeImg[(r+1)*width+c]){edgeImg[(r+1)*width+c]= 0; pixels[count].r = r+1; pixels[count].c = c; count++;}
+        if (E(r+1, c+1)){
+          if (E(r+1, c)){E.Take(r+1, c); pixels[count].r = r+1; pixels[count].c = c; count++;}
           r++; c++; dir = DOWN_RIGHT; continue;
         } //end-if
 
         // Up
-        if (edgeImg[(r-1)*width+c]){r--; dir = UP; continue;}
+        if (E(r-1, c)){r--; dir = UP; continue;}
 
         // Down
-        if (edgeImg[(r+1)*width+c]){r++; dir = DOWN; continue;}
+        if (E(r+1, c)){r++; dir = DOWN; continue;}
 
         // Up-Left
-        if (edgeImg[(r-1)*width+c-1]){r--; c--; dir = UP_LEFT; continue;}
+        if (E(r-1, c-1)){r--; c--; dir = UP_LEFT; continue;}
 
         // Down-Left
-        if (edgeImg[(r+1)*width+c-1]){r++; c--; dir = DOWN_LEFT; continue;}
+        if (E(r+1, c-1)){r++; c--; dir = DOWN_LEFT; continue;}
 
       } else {
         // Down-Right
-        if (edgeImg[(r+1)*width+c+1]){
-          if (edgeImg[(r+1)*width+c]){edgeImg[(r+1)*width+c]= 0; pixels[count].r = r+1; pixels[count].c = c; count++;}
+        if (E(r+1, c+1)){
+          if (E(r+1, c)){E.Take(r+1, c); pixels[count].r = r+1; pixels[count].c = c; count++;}
           r++; c++; dir = DOWN_RIGHT; continue;
         } //end-if
 
         // Up-Right
-        if (edgeImg[(r-1)*width+c+1]){
-          if (edgeImg[(r-1)*width+c]){edgeImg[(r-1)*width+c]= 0; pixels[count].r = r-1; pixels[count].c = c; count++;}
+        if (E(r-1, c+1)){
+          if (E(r-1, c)){E.Take(r-1, c); pixels[count].r = r-1; pixels[count].c = c; count++;}
           r--; c++; dir = UP_RIGHT; continue;
         } //end-if
 
         // Down
-        if (edgeImg[(r+1)*width+c]){r++; dir = DOWN; continue;}
+        if (E(r+1, c)){r++; dir = DOWN; continue;}
 
         // Up
-        if (edgeImg[(r-1)*width+c]){r--; dir = UP; continue;}
+        if (E(r-1, c)){r--; dir = UP; continue;}
 
         // Down-Left
-        if (edgeImg[(r+1)*width+c-1]){r++; c--; dir = DOWN_LEFT; continue;}
+        if (E(r+1, c-1)){r++; c--; dir = DOWN_LEFT; continue;}
 
         // Up-Left
-        if (edgeImg[(r-1)*width+c-1]){r--; c--; dir = UP_LEFT; continue;}
+        if (E(r-1, c-1)){r--; c--; dir = UP_LEFT; continue;}
       } //end-else
 
       // Nowhere to go
@@ -669,29 +1160,29 @@ static int Walk8Dirs(unsigned char *edgeImg, int width, int height, int r, int c
       int nextDir = Q.ComputeNextDir(DOWN_RIGHT);
 
       // Down-Right?
-      if (edgeImg[(r+1)*width+c+1]){
+      if (E(r+1, c+1)){
         if (nextDir == DOWN){
           // Down?
-          if (edgeImg[(r+1)*width+c]){
+          if (E(r+1, c)){
             pixels[count].r = r+1; pixels[count].c = c; count++;
-            edgeImg[(r+1)*width+c] = 0;
+            E.Take(r+1, c);
 
           // Right?
-          } else if (edgeImg[r*width+c+1]){
+          } else if (E(r, c+1)){
             pixels[count].r = r; pixels[count].c = c+1; count++;
-            edgeImg[r*width+c+1] = 0;
+            E.Take(r, c+1);
           } //end-else
 
         } else {
           // Right?
-          if (edgeImg[r*width+c+1]){
+          if (E(r, c+1)){
             pixels[count].r = r; pixels[count].c = c+1; count++;
-            edgeImg[r*width+c+1] = 0;
+            E.Take(r, c+1);
 
           // Down?
-          } else if (edgeImg[(r+1)*width+c]){
+          } else if (E(r+1, c)){
             pixels[count].r = r+1; pixels[count].c = c; count++;
-            edgeImg[(r+1)*width+c] = 0;
+            E.Take(r+1, c);
           } //end-else
         } //end-else
 
@@ -700,41 +1191,41 @@ static int Walk8Dirs(unsigned char *edgeImg, int width, int height, int r, int c
 
       if (nextDir == DOWN){
         // Down
-        if (edgeImg[(r+1)*width+c]){r++; dir = DOWN; continue;}
+        if (E(r+1, c)){r++; dir = DOWN; continue;}
 
         // Right
-        if (edgeImg[r*width+c+1]){c++; dir = RIGHT; continue;}
+        if (E(r, c+1)){c++; dir = RIGHT; continue;}
 
         // Down-Left
-        if (edgeImg[(r+1)*width+c-1]){r++; c--; dir = DOWN_LEFT; continue;}
+        if (E(r+1, c-1)){r++; c--; dir = DOWN_LEFT; continue;}
 
         // Up-Right
-        if (edgeImg[(r-1)*width+c+1]){r--; c++; dir = UP_RIGHT; continue;}
+        if (E(r-1, c+1)){r--; c++; dir = UP_RIGHT; continue;}
 
         // Left
-        if (edgeImg[r*width+c-1]){c--; dir = LEFT; continue;}
+        if (E(r, c-1)){c--; dir = LEFT; continue;}
 
         // Up
-        if (edgeImg[(r-1)*width+c]){r--; dir = UP; continue;}
+        if (E(r-1, c)){r--; dir = UP; continue;}
 
       } else {
         // Right
-        if (edgeImg[r*width+c+1]){c++; dir = RIGHT; continue;}
+        if (E(r, c+1)){c++; dir = RIGHT; continue;}
 
         // Down
-        if (edgeImg[(r+1)*width+c]){r++; dir = DOWN; continue;}
+        if (E(r+1, c)){r++; dir = DOWN; continue;}
 
         // Up-Right
-        if (edgeImg[(r-1)*width+c+1]){r--; c++; dir = UP_RIGHT; continue;}
+        if (E(r-1, c+1)){r--; c++; dir = UP_RIGHT; continue;}
 
         // Down-Left
-        if (edgeImg[(r+1)*width+c-1]){r++; c--; dir = DOWN_LEFT; continue;}
+        if (E(r+1, c-1)){r++; c--; dir = DOWN_LEFT; continue;}
 
         // Up
-        if (edgeImg[(r-1)*width+c]){r--; dir = UP; continue;}
+        if (E(r-1, c)){r--; dir = UP; continue;}
 
         // Left
-        if (edgeImg[r*width+c-1]){c--; dir = LEFT; continue;}
+        if (E(r, c-1)){c--; dir = LEFT; continue;}
       } //end-else
 
       // Nowhere to go
@@ -742,60 +1233,60 @@ static int Walk8Dirs(unsigned char *edgeImg, int width, int height, int r, int c
 
     } else if (dir == DOWN){
       // Down
-      if (edgeImg[(r+1)*width+c]){r++; dir = DOWN; continue;}
+      if (E(r+1, c)){r++; dir = DOWN; continue;}
 
       // Should we check LEFT or RIGHT first?
       int nextDir = Q.ComputeNextDir(LEFT);
 
       if (nextDir == LEFT){
         // Down-Left
-        if (edgeImg[(r+1)*width+c-1]){
-          if (edgeImg[r*width+c-1]){edgeImg[r*width+c-1]= 0; pixels[count].r = r; pixels[count].c = c-1; count++;} 
+        if (E(r+1, c-1)){
+          if (E(r, c-1)){E.Take(r, c-1); pixels[count].r = r; pixels[count].c = c-1; count++;} 
           r++; c--; dir = DOWN_LEFT; continue;
         } //end-if
 
         // Down-Right
-        if (edgeImg[(r+1)*width+c+1]){
-          if (edgeImg[r*width+c+1]){edgeImg[r*width+c+1] = 0; pixels[count].r = r; pixels[count].c = c+1; count++;} 
+        if (E(r+1, c+1)){
+          if (E(r, c+1)){E.Take(r, c+1); pixels[count].r = r; pixels[count].c = c+1; count++;} 
           r++; c++; dir = DOWN_RIGHT; continue;
         } //end-if
 
         // Left
-        if (edgeImg[r*width+c-1]){c--; dir = LEFT; continue;}
+        if (E(r, c-1)){c--; dir = LEFT; continue;}
 
         // Right
-        if (edgeImg[r*width+c+1]){c++; dir = RIGHT; continue;}
+        if (E(r, c+1)){c++; dir = RIGHT; continue;}
 
         // Up-Left
-        if (edgeImg[(r-1)*width+c-1]){r--; c--; dir = UP_LEFT; continue;}
+        if (E(r-1, c-1)){r--; c--; dir = UP_LEFT; continue;}
 
         // Up-Right
-        if (edgeImg[(r-1)*width+c+1]){r--; c++; dir = UP_RIGHT; continue;}
+        if (E(r-1, c+1)){r--; c++; dir = UP_RIGHT; continue;}
 
       } else {
         // Down-Right
-        if (edgeImg[(r+1)*width+c+1]){
-          if (edgeImg[r*width+c+1]){edgeImg[r*width+c+1]= 0; pixels[count].r = r; pixels[count].c = c+1; count++;} 
+        if (E(r+1, c+1)){
+          if (E(r, c+1)){E.Take(r, c+1); pixels[count].r = r; pixels[count].c = c+1; count++;} 
           r++; c++; dir = DOWN_RIGHT; continue;
         } //end-if
 
         // Down-Left
-        if (edgeImg[(r+1)*width+c-1]){
-          if (edgeImg[r*width+c-1]){edgeImg[r*width+c-1]= 0; pixels[count].r = r; pixels[count].c = c-1; count++;} 
+        if (E(r+1, c-1)){
+          if (E(r, c-1)){E.Take(r, c-1); pixels[count].r = r; pixels[count].c = c-1; count++;} 
           r++; c--; dir = DOWN_LEFT; continue;
         } //end-if
 
         // Right
-        if (edgeImg[r*width+c+1]){c++; dir = RIGHT; continue;}
+        if (E(r, c+1)){c++; dir = RIGHT; continue;}
 
         // Left
-        if (edgeImg[r*width+c-1]){c--; dir = LEFT; continue;}
+        if (E(r, c-1)){c--; dir = LEFT; continue;}
 
         // Up-Right
-        if (edgeImg[(r-1)*width+c+1]){r--; c++; dir = UP_RIGHT; continue;}
+        if (E(r-1, c+1)){r--; c++; dir = UP_RIGHT; continue;}
 
         // Up-Left
-        if (edgeImg[(r-1)*width+c-1]){r--; c--; dir = UP_LEFT; continue;}
+        if (E(r-1, c-1)){r--; c--; dir = UP_LEFT; continue;}
       } //end-else
 
       // Nowhere to go
@@ -806,29 +1297,29 @@ static int Walk8Dirs(unsigned char *edgeImg, int width, int height, int r, int c
       int nextDir = Q.ComputeNextDir(DOWN_LEFT);
 
       // Down-Left?
-      if (edgeImg[(r+1)*width+c-1]){
+      if (E(r+1, c-1)){
         if (nextDir == DOWN){
           // Down?
-          if (edgeImg[(r+1)*width+c]){
+          if (E(r+1, c)){
             pixels[count].r = r+1; pixels[count].c = c; count++;
-            edgeImg[(r+1)*width+c] = 0;
+            E.Take(r+1, c);
 
           // Left?
-          } else if (edgeImg[r*width+c-1]){
+          } else if (E(r, c-1)){
             pixels[count].r = r; pixels[count].c = c-1; count++;
-            edgeImg[r*width+c-1] = 0;
+            E.Take(r, c-1);
           } //end-else
 
         } else {
           // Left?
-          if (edgeImg[r*width+c-1]){
+          if (E(r, c-1)){
             pixels[count].r = r; pixels[count].c = c-1; count++;
-            edgeImg[r*width+c-1] = 0;
+            E.Take(r, c-1);
 
           // Down?
-          } else if (edgeImg[(r+1)*width+c]){
+          } else if (E(r+1, c)){
             pixels[count].r = r+1; pixels[count].c = c; count++;
-            edgeImg[(r+1)*width+c] = 0;
+            E.Take(r+1, c);
           } //end-else
         } //end-else
 
@@ -837,101 +1328,101 @@ static int Walk8Dirs(unsigned char *edgeImg, int width, int height, int r, int c
 
       if (nextDir == DOWN){
         // Down
-        if (edgeImg[(r+1)*width+c]){r++; dir = DOWN; continue;}
+        if (E(r+1, c)){r++; dir = DOWN; continue;}
 
         // Left
-        if (edgeImg[r*width+c-1]){c--; dir = LEFT; continue;}
+        if (E(r, c-1)){c--; dir = LEFT; continue;}
 
         // Down-Right
-        if (edgeImg[(r+1)*width+c+1]){r++; c++; dir = DOWN_RIGHT; continue;}
+        if (E(r+1, c+1)){r++; c++; dir = DOWN_RIGHT; continue;}
 
         // Up-Left
-        if (edgeImg[(r-1)*width+c-1]){r--; c--; dir = UP_LEFT; continue;}
+        if (E(r-1, c-1)){r--; c--; dir = UP_LEFT; continue;}
 
         // Right
-        if (edgeImg[r*width+c+1]){c++; dir = RIGHT; continue;}
+        if (E(r, c+1)){c++; dir = RIGHT; continue;}
 
         // Up
-        if (edgeImg[(r-1)*width+c]){r--; dir = UP; continue;}
+        if (E(r-1, c)){r--; dir = UP; continue;}
 
       } else {
         // Left
-        if (edgeImg[r*width+c-1]){c--; dir = LEFT; continue;}
+        if (E(r, c-1)){c--; dir = LEFT; continue;}
 
         // Down
-        if (edgeImg[(r+1)*width+c]){r++; dir = DOWN; continue;}
+        if (E(r+1, c)){r++; dir = DOWN; continue;}
 
         // Up-Left
-        if (edgeImg[(r-1)*width+c-1]){r--; c--; dir = UP_LEFT; continue;}
+        if (E(r-1, c-1)){r--; c--; dir = UP_LEFT; continue;}
 
         // Down-Right
-        if (edgeImg[(r+1)*width+c+1]){r++; c++; dir = DOWN_RIGHT; continue;}
+        if (E(r+1, c+1)){r++; c++; dir = DOWN_RIGHT; continue;}
 
         // Up
-        if (edgeImg[(r-1)*width+c]){r--; dir = UP; continue;}
+        if (E(r-1, c)){r--; dir = UP; continue;}
 
         // Right
-        if (edgeImg[r*width+c+1]){c++; dir = RIGHT; continue;}
+        if (E(r, c+1)){c++; dir = RIGHT; continue;}
       } //end-else
       // Nowhere to go
       return count;
 
     } else { // (dir == LEFT){
       // Left
-      if (edgeImg[r*width+c-1]){c--; dir = LEFT; continue;}
+      if (E(r, c-1)){c--; dir = LEFT; continue;}
 
       // Should we check UP or DOWN first?
       int nextDir = Q.ComputeNextDir(UP);
 
       if (nextDir == UP){
         // Up-Left
-        if (edgeImg[(r-1)*width+c-1]){
-          if (edgeImg[(r-1)*width+c]){edgeImg[(r-1)*width+c]= 0; pixels[count].r = r-1; pixels[count].c = c; count++;}
+        if (E(r-1, c-1)){
+          if (E(r-1, c)){E.Take(r-1, c); pixels[count].r = r-1; pixels[count].c = c; count++;}
           r--; c--; dir = UP_LEFT; continue;
         } //end-if
 
         // Down-Left
-        if (edgeImg[(r+1)*width+c-1]){
-          if (edgeImg[(r+1)*width+c]){edgeImg[(r+1)*width+c] = 0; pixels[count].r = r+1; pixels[count].c = c; count++;}
+        if (E(r+1, c-1)){
+          if (E(r+1, c)){E.Take(r+1, c); pixels[count].r = r+1; pixels[count].c = c; count++;}
           r++; c--; dir = DOWN_LEFT; continue;
         } //end-if
 
         // Up
-        if (edgeImg[(r-1)*width+c]){r--; dir = UP; continue;}
+        if (E(r-1, c)){r--; dir = UP; continue;}
 
         // Down
-        if (edgeImg[(r+1)*width+c]){r++; dir = DOWN; continue;}
+        if (E(r+1, c)){r++; dir = DOWN; continue;}
 
         // Up-Right
-        if (edgeImg[(r-1)*width+c+1]){r--; c++; dir = UP_RIGHT; continue;}
+        if (E(r-1, c+1)){r--; c++; dir = UP_RIGHT; continue;}
 
         // Down-Right
-        if (edgeImg[(r+1)*width+c+1]){r++; c++; dir = DOWN_RIGHT; continue;}
+        if (E(r+1, c+1)){r++; c++; dir = DOWN_RIGHT; continue;}
 
       } else {
         // Down-Left
-        if (edgeImg[(r+1)*width+c-1]){
-          if (edgeImg[(r+1)*width+c]){edgeImg[(r+1)*width+c] = 0; pixels[count].r = r+1; pixels[count].c = c; count++;}
+        if (E(r+1, c-1)){
+          if (E(r+1, c)){E.Take(r+1, c); pixels[count].r = r+1; pixels[count].c = c; count++;}
           r++; c--; dir = DOWN_LEFT; continue;
         } //end-if
 
         // Up-Left
-        if (edgeImg[(r-1)*width+c-1]){
-          if (edgeImg[(r-1)*width+c]){edgeImg[(r-1)*width+c]= 0; pixels[count].r = r-1; pixels[count].c = c; count++;}
+        if (E(r-1, c-1)){
+          if (E(r-1, c)){E.Take(r-1, c); pixels[count].r = r-1; pixels[count].c = c; count++;}
           r--; c--; dir = UP_LEFT; continue;
         } //end-if
 
         // Down
-        if (edgeImg[(r+1)*width+c]){r++; dir = DOWN; continue;}
+        if (E(r+1, c)){r++; dir = DOWN; continue;}
 
         // Up
-        if (edgeImg[(r-1)*width+c]){r--; dir = UP; continue;}
+        if (E(r-1, c)){r--; dir = UP; continue;}
 
         // Down-Right
-        if (edgeImg[(r+1)*width+c+1]){r++; c++; dir = DOWN_RIGHT; continue;}
+        if (E(r+1, c+1)){r++; c++; dir = DOWN_RIGHT; continue;}
 
         // Up-Right
-        if (edgeImg[(r-1)*width+c+1]){r--; c++; dir = UP_RIGHT; continue;}
+        if (E(r-1, c+1)){r--; c++; dir = UP_RIGHT; continue;}
       } //end-else
 
       // Nowhere to go
@@ -943,163 +1434,343 @@ static int Walk8Dirs(unsigned char *edgeImg, int width, int height, int r, int c
 } //end-Walk8Dirs
 
 ///----------------------------------------------------------------------------------
-/// Predictive edge walk using 8 directions
+/// Starts a predictive walk at every edgel of the list that is still free & not on the image border, in the order
+/// of the list. The pixels are written one after the other to "pixels". Each walk of at least MIN_SEGMENT_LEN
+/// pixels becomes an edge segment; if starts is given, the offset of the pixel the walk starts from is kept there.
+/// Returns the # of edge segments
 ///
-EdgeMap *PELWalk8Dirs(unsigned char *edgeImg, int width, int height, int MIN_SEGMENT_LEN){
-  EdgeMap *map = new EdgeMap(width, height);
-  Pixel *pixels =  new Pixel[width*height];
+static int WalkEdgels(EdgelMap &E, int *edgels, int noEdgels, int MIN_SEGMENT_LEN, Pixel *pixels, EdgeSegment *segments, int *starts){
+  int width = E.width;
+  int height = E.height;
 
   int noSegments = 0;
   int totalLen = 0;
 
-  // Go over the anchors in sorted order
-  for (int i=1; i<height-1; i++){
-    for (int j=1; j<width-1; j++){
-      if (edgeImg[i*width+j] == 0) continue;
+  for (int k=0; k<noEdgels; k++){
+    int i = edgels[k]/width;
+    int j = edgels[k]-i*width;
 
-#if 0
-      int dir1, dir2;
-      dir1 = dir2 = -1;
+    if (i <= 0 || i >= height-1 || j <= 0 || j >= width-1) continue;
+    if (E(i, j) == false) continue;
 
-      // 8 directions
-      if      (edgeImg[i*width+j+1]){dir1 = RIGHT; dir2 = LEFT;}
-      else if (edgeImg[(i+1)*width+j]){dir1 = DOWN; dir2 = UP;}
+    int dir1, dir2;
+    dir1 = dir2 = -1;
 
-      else if (edgeImg[(i+1)*width+j-1]){dir1 = DOWN_LEFT; dir2 = UP_RIGHT;}
-      else if (edgeImg[(i+1)*width+j+1]){dir1 = DOWN_RIGHT; dir2 = UP_LEFT;}
+    // 8 directions
+    if      (E(i, j+1)) dir1 = RIGHT;
+    else if (E(i+1, j)) dir1 = DOWN;
 
-      // Skip single pixel edgels
-      if (dir1 < 0){edgeImg[i*width+j] = 0; continue;}
+    else if (E(i+1, j-1)) dir1 = DOWN_LEFT;
+    else if (E(i+1, j+1)) dir1 = DOWN_RIGHT;
 
-      // Walk using 8 directions
-      int len1 = Walk8Dirs(edgeImg, width, height, i, j, dir1, pixels);
-      int len2 = Walk8Dirs(edgeImg, width, height, i, j, dir2, pixels+len1);
+    // Skip single pixel edgels
+    if (dir1 < 0){E.Take(i, j); continue;}
 
-      if (len1+len2-1 < MIN_SEGMENT_LEN) continue;
+    // Walk using 8 directions. Walk straight into the map, the first walk gets reversed below
+    Pixel *segmentPixels = pixels+totalLen;
+    int len1 = Walk8Dirs(E, i, j, dir1, segmentPixels);
+  
+    int sr, sc;
+    if      (E(i, j+1)){dir2 = RIGHT; sr = i; sc = j+1;}
+    else if (E(i+1, j)){dir2 = DOWN; sr = i+1; sc = j;}
 
-      map->segments[noSegments].pixels = map->pixels+totalLen;
-      int len = 0;
-      for (int k=len1-1; k>=1; k--){
-        map->segments[noSegments].pixels[len] = pixels[k];
-        len++;
-      } //end-for
+    else if (E(i+1, j-1)){dir2 = DOWN_LEFT; sr = i+1; sc = j-1;}
+    else if (E(i+1, j+1)){dir2 = DOWN_RIGHT; sr = i+1; sc = j+1;}
 
-      for (int k=len1; k<len1+len2; k++){
-        map->segments[noSegments].pixels[len] = pixels[k];
-        len++;
-      } //end-for
+    int len2=0;
+    if (dir2 > 0) len2 = Walk8Dirs(E, sr, sc, dir2, segmentPixels+len1);
+
+    if (len1+len2 < MIN_SEGMENT_LEN) continue;
 
-      map->segments[noSegments].noPixels = len;
-      noSegments++;
-      totalLen += len;
+    for (int k=0; k<len1/2; k++){
+      Pixel tmp = segmentPixels[k];
+      segmentPixels[k] = segmentPixels[len1-1-k];
+      segmentPixels[len1-1-k] = tmp;
     } //end-for
-  } // end-for
-#else
-      int dir1, dir2;
-      dir1 = dir2 = -1;
 
-      // 8 directions
-      if      (edgeImg[i*width+j+1]) dir1 = RIGHT;
-      else if (edgeImg[(i+1)*width+j]) dir1 = DOWN;
+    int len = len1+len2;
+    segments[noSegments].pixels = segmentPixels;
+    segments[noSegments].noPixels = len;
+    if (starts) starts[noSegments] = edgels[k];
+    noSegments++;
+    totalLen += len;
+  } //end-for
+
+  return noSegments;
+} //end-WalkEdgels
 
-      else if (edgeImg[(i+1)*width+j-1]) dir1 = DOWN_LEFT;
-      else if (edgeImg[(i+1)*width+j+1]) dir1 = DOWN_RIGHT;
+///----------------------------------------------------------------------------------
+/// A walk never leaves the 8-connected component of edgels it starts in, & what it does only depends on that
+/// component. So the components that lie within a band are walked by the band's thread, while the components
+/// that cross a band seam are taken up front, released once the bands are done & walked by one thread.
+/// Merging the segments by the offset of their start pixels then gives exactly the segments of the serial walk
+///
+struct WalkJob {
+  EdgelMap *E;
+  int numThreads;
+  int MIN_SEGMENT_LEN;
+
+  int *noEdgels;                // # of edgels in each band
+  int **edgels;                 // Offsets of the edgels of each band
+  int *seeds;                   // Edgels on the first & last row of each band that touch the next band (2*width per band)
+  int *noSeeds;
+  int **seam;                   // Offsets of the edgels of each band that belong to components crossing a seam
+  int *noSeamPixels;
+
+  Pixel **pixels;               // The walks of each band go here
+  EdgeSegment **segments;       // Edge segments of each band
+  int **starts;                 // Offsets of the start pixels of the edge segments
+  int *noSegments;
+};
+
+///----------------------------------------------------------------------------------
+/// Counts the edgels of band t & collects the ones on its first & last rows that touch an edgel of the next band
+///
+static void FindSeamSeeds(int t, void *arg){
+  WalkJob *job = (WalkJob *)arg;
+  EdgelMap &E = *job->E;
+  int width = E.width;
+  int height = E.height;
 
-      // Skip single pixel edgels
-      if (dir1 < 0){edgeImg[i*width+j] = 0; continue;}
+  int firstRow = BandStart(t, job->numThreads, height);
+  int lastRow = BandStart(t+1, job->numThreads, height);
 
-      // Walk using 8 directions
-      int len1 = Walk8Dirs(edgeImg, width, height, i, j, dir1, pixels);
-    
-      int sr, sc;
-      if      (edgeImg[i*width+j+1]){dir2 = RIGHT; sr = i; sc = j+1;}
-      else if (edgeImg[(i+1)*width+j]){dir2 = DOWN; sr = i+1; sc = j;}
+  job->noEdgels[t] = CountEdgels(E, firstRow, lastRow);
 
-      else if (edgeImg[(i+1)*width+j-1]){dir2 = DOWN_LEFT; sr = i+1; sc = j-1;}
-      else if (edgeImg[(i+1)*width+j+1]){dir2 = DOWN_RIGHT; sr = i+1; sc = j+1;}
+  int *seeds = job->seeds + t*2*width;
+  int noSeeds = 0;
 
-      int len2=0;
-      if (dir2 > 0) len2 = Walk8Dirs(edgeImg, width, height, sr, sc, dir2, pixels+len1);
+  for (int k=0; k<2; k++){
+    int r  = k == 0 ? firstRow : lastRow-1;
+    int nr = k == 0 ? firstRow-1 : lastRow;      // Row of the next band
+    if (nr < 0 || nr >= height) continue;
 
-      if (len1+len2 < MIN_SEGMENT_LEN) continue;
+    for (int c=0; c<width; c++){
+      if (E(r, c) == false) continue;
 
-      map->segments[noSegments].pixels = map->pixels+totalLen;
-      int len = 0;
-      for (int k=len1-1; k>=0; k--){
-        map->segments[noSegments].pixels[len] = pixels[k];
-        len++;
-      } //end-for
+      bool touches = E(nr, c);
+      if (c > 0 && E(nr, c-1)) touches = true;
+      if (c < width-1 && E(nr, c+1)) touches = true;
 
-      for (int k=len1; k<len1+len2; k++){
-        map->segments[noSegments].pixels[len] = pixels[k];
-        len++;
+      if (touches) seeds[noSeeds++] = r*width+c;
+    } //end-for
+  } //end-for
+
+  job->noSeeds[t] = noSeeds;
+} //end-FindSeamSeeds
+
+///----------------------------------------------------------------------------------
+/// Indexes the edgels of band t & takes the pieces of the seam crossing components within the band, growing them
+/// from the seeds
+///
+static void TakeSeamComponents(int t, void *arg){
+  WalkJob *job = (WalkJob *)arg;
+  EdgelMap &E = *job->E;
+  int width = E.width;
+
+  int firstRow = BandStart(t, job->numThreads, E.height);
+  int lastRow = BandStart(t+1, job->numThreads, E.height);
+
+  IndexEdgels(E, firstRow, lastRow, job->edgels[t]);
+
+  int *seeds = job->seeds + t*2*width;
+  int *seam = job->seam[t];
+  int noSeamPixels = 0;
+
+  for (int k=0; k<job->noSeeds[t]; k++){
+    int r = seeds[k]/width;
+    int c = seeds[k]%width;
+    if (E(r, c) == false) continue;
+
+    E.Take(r, c);
+    seam[noSeamPixels++] = seeds[k];
+  } //end-for
+
+  // The seam list doubles as the queue of the flood fill
+  for (int k=0; k<noSeamPixels; k++){
+    int r = seam[k]/width;
+    int c = seam[k]%width;
+
+    for (int m=r-1; m<=r+1; m++){
+      if (m < firstRow || m >= lastRow) continue;
+
+      for (int n=c-1; n<=c+1; n++){
+        if (n < 0 || n >= width) continue;
+        if (E(m, n) == false) continue;
+
+        E.Take(m, n);
+        seam[noSeamPixels++] = m*width+n;
       } //end-for
+    } //end-for
+  } //end-for
+
+  job->noSeamPixels[t] = noSeamPixels;
+} //end-TakeSeamComponents
+
+///----------------------------------------------------------------------------------
+/// Walks the components that lie within band t
+///
+static void WalkBand(int t, void *arg){
+  WalkJob *job = (WalkJob *)arg;
+
+  job->noSegments[t] = WalkEdgels(*job->E, job->edgels[t], job->noEdgels[t], job->MIN_SEGMENT_LEN,
+                                  job->pixels[t], job->segments[t], job->starts[t]);
+} //end-WalkBand
+
+///----------------------------------------------------------------------------------
+/// Predictive edge walk using 8 directions
+/// Every edgel ends up in at most one walk, so the edge map is sized from the # of edgels
+/// (counted here if noEdgels < 0) rather than from the image size.
+/// The walks are seeded from a list of the edgels & take the edgels they walk over out of E
+///
+static EdgeMap *PELWalk8Dirs(EdgelMap &E, int MIN_SEGMENT_LEN, int noEdgels, EdgeMapPool *pool, int numThreads){
+  PROFILE_STAGE("PEL Walk8Dirs");
+
+  int width = E.width;
+  int height = E.height;
+  numThreads = ClampNumThreads(numThreads, height);
+
+  if (numThreads == 1){
+    if (noEdgels < 0) noEdgels = CountEdgels(E, 0, height);
+
+    int *edgels = new int[noEdgels+1];
+    noEdgels = IndexEdgels(E, 0, height, edgels);
+
+    int maxSegments = noEdgels/(MIN_SEGMENT_LEN > 1 ? MIN_SEGMENT_LEN : 1) + 1;
+    EdgeMap *map = new EdgeMap(width, height, noEdgels, maxSegments, pool);
+
+    map->noSegments = WalkEdgels(E, edgels, noEdgels, MIN_SEGMENT_LEN, map->pixels, map->segments, NULL);
+
+    delete[] edgels;
+    return map;
+  } //end-if
+
+  // Bands + 1 slot for the seam crossing components
+  int n = numThreads;
+  WalkJob job;
+  job.E = &E;
+  job.numThreads = n;
+  job.MIN_SEGMENT_LEN = MIN_SEGMENT_LEN;
+
+  job.noEdgels = new int[n];
+  job.edgels = new int *[n];
+  job.seeds = new int[n*2*width];
+  job.noSeeds = new int[n];
+  job.seam = new int *[n];
+  job.noSeamPixels = new int[n];
+
+  job.pixels = new Pixel *[n+1];
+  job.segments = new EdgeSegment *[n+1];
+  job.starts = new int *[n+1];
+  job.noSegments = new int[n+1];
+
+  RunThreads(n, FindSeamSeeds, &job);
+
+  noEdgels = 0;
+  for (int t=0; t<n; t++) noEdgels += job.noEdgels[t];
+
+  // The band lists follow each other, so together they list all edgels in raster order
+  int *edgelBuffer = new int[noEdgels+1];
+  int *seamBuffer = new int[noEdgels+1];
+  for (int t=0, offset=0; t<n; t++){
+    job.edgels[t] = edgelBuffer+offset;
+    job.seam[t] = seamBuffer+offset;
+    offset += job.noEdgels[t];
+  } //end-for
+
+  RunThreads(n, TakeSeamComponents, &job);
+
+  // Each band's walks take at most as many pixels as the band has edgels left. The seam crossing components go last
+  int divisor = MIN_SEGMENT_LEN > 1 ? MIN_SEGMENT_LEN : 1;
+  int maxSegments = noEdgels/divisor + 1;
+  EdgeMap *map = new EdgeMap(width, height, noEdgels, maxSegments, pool);
+
+  int noSeamPixels = 0;
+  for (int t=0; t<n; t++) noSeamPixels += job.noSeamPixels[t];
+
+  int totalSegments = noSeamPixels/divisor + 1;
+  for (int t=0; t<n; t++) totalSegments += (job.noEdgels[t]-job.noSeamPixels[t])/divisor + 1;
+
+  EdgeSegment *segmentBuffer = map->AllocSegments(totalSegments);
+  int *startBuffer = new int[totalSegments];
+
+  for (int t=0, pixelOffset=0, segmentOffset=0; t<=n; t++){
+    int noPixels = t < n ? job.noEdgels[t]-job.noSeamPixels[t] : noSeamPixels;
+
+    job.pixels[t] = map->pixels+pixelOffset;
+    job.segments[t] = segmentBuffer+segmentOffset;
+    job.starts[t] = startBuffer+segmentOffset;
+
+    pixelOffset += noPixels;
+    segmentOffset += noPixels/divisor + 1;
+  } //end-for
+
+  RunThreads(n, WalkBand, &job);
+
+  // Release the seam crossing components & walk them. They are the only edgels left
+  for (int t=0; t<n; t++){
+    for (int k=0; k<job.noSeamPixels[t]; k++) E.Put(job.seam[t][k]/width, job.seam[t][k]%width);
+  } //end-for
 
-      map->segments[noSegments].noPixels = len;
-      noSegments++;
-      totalLen += len;
+  job.noSegments[n] = WalkEdgels(E, edgelBuffer, noEdgels, MIN_SEGMENT_LEN, job.pixels[n], job.segments[n], job.starts[n]);
+
+  // Merge the segments of the bands with those of the seam crossing components by their start pixels
+  int noSegments = 0;
+  int k = 0;
+  for (int t=0; t<n; t++){
+    int bandEnd = BandStart(t+1, n, height)*width;
+
+    for (int i=0; i<job.noSegments[t]; i++){
+      while (k < job.noSegments[n] && job.starts[n][k] < job.starts[t][i]) map->segments[noSegments++] = job.segments[n][k++];
+      map->segments[noSegments++] = job.segments[t][i];
     } //end-for
-  } // end-for
-#endif
 
+    while (k < job.noSegments[n] && job.starts[n][k] < bandEnd) map->segments[noSegments++] = job.segments[n][k++];
+  } //end-for
 
   map->noSegments = noSegments;
-  delete pixels;
-  
+
+  delete[] startBuffer;
+  delete[] seamBuffer;
+  delete[] edgelBuffer;
+  delete[] job.noSegments;
+  delete[] job.starts;
+  delete[] job.segments;
+  delete[] job.pixels;
+  delete[] job.noSeamPixels;
+  delete[] job.seam;
+  delete[] job.noSeeds;
+  delete[] job.seeds;
+  delete[] job.edgels;
+  delete[] job.noEdgels;
+
   return map;
 } // end-PELWalk8Dirs
 
 ///========================== Step 3: Join Edge Segments ======================================
 ///-------------------------------------------------------------------------------------------
-/// Returns the joint points. 
+/// Flags the joint points in the map's labels: for each endpoint, its first 8-neighbor that belongs to another segment
 ///
-static unsigned char *FindJointPoints(EdgeMap *map){
+static void FindJointPoints(EdgeMap *map){
   int width = map->width;
   int height = map->height;
+  LabelMap &labels = *map->labels;
 
-  unsigned char *joints = new unsigned char[width*height];
-  memset(joints, 0, width*height);
-
-  short *segments = new short[width*height];
-  memset(segments, -1, sizeof(short)*width*height);
-
-  for (int i=0; i<map->noSegments; i++){
-    for (int j=0; j<map->segments[i].noPixels; j++){
-      int r = map->segments[i].pixels[j].r;
-      int c = map->segments[i].pixels[j].c;
-
-      segments[r*width+c] = i;
-    } //end-for
-  } //end-for
+  // up, down, left, right, up-left, up-right, down-right, down-left
+  const int dr[8] = {-1, 1, 0, 0, -1, -1, 1, 1};
+  const int dc[8] = {0, 0, -1, 1, -1, 1, 1, -1};
 
   for (int i=0; i<map->noSegments; i++){
     for (int k=0; k<2; k++){
-      int r, c;
-
-      if (k==0){
-        r = map->segments[i].pixels[0].r;
-        c = map->segments[i].pixels[0].c;
-
-      } else {
-        r = map->segments[i].pixels[map->segments[i].noPixels-1].r;
-        c = map->segments[i].pixels[map->segments[i].noPixels-1].c;
-      } //end-else
-
-      if (r <=0 || r>=height-1 || c<=0 || c>=width-1) continue;
+      Pixel p = map->segments[i].pixels[k == 0 ? 0 : map->segments[i].noPixels-1];
+      if (p.r <=0 || p.r>=height-1 || p.c<=0 || p.c>=width-1) continue;
 
-      if      (segments[(r-1)*width+c] >= 0 && segments[(r-1)*width+c] != i) joints[(r-1)*width+c] = 255;  // up
-      else if (segments[(r+1)*width+c] >= 0 && segments[(r+1)*width+c] != i) joints[(r+1)*width+c] = 255;  // down
-      else if (segments[r*width+c-1] >= 0 && segments[r*width+c-1] != i) joints[r*width+c-1] = 255;  // left
-      else if (segments[r*width+c+1] >= 0 && segments[r*width+c+1] != i) joints[r*width+c+1] = 255;  // right
-      else if (segments[(r-1)*width+c-1] >= 0 && segments[(r-1)*width+c-1] != i) joints[(r-1)*width+c-1] = 255;  // up-left
-      else if (segments[(r-1)*width+c+1] >= 0 && segments[(r-1)*width+c+1] != i) joints[(r-1)*width+c+1] = 255;  // up-right
-      else if (segments[(r+1)*width+c+1] >= 0 && segments[(r+1)*width+c+1] != i) joints[(r+1)*width+c+1] = 255;  // down-right
-      else if (segments[(r+1)*width+c-1] >= 0 && segments[(r+1)*width+c-1] != i) joints[(r+1)*width+c-1] = 255;  // down-left
+      for (int d=0; d<8; d++){
+        int owner = labels(p.r+dr[d], p.c+dc[d]);
+        if (owner >= 0 && owner != i){labels.SetFlag(p.r+dr[d], p.c+dc[d], JOINT_POINT); break;}
+      } //end-for
     } //end-for
   } //end-for
-
-  delete segments;
-  return joints;
 } //end-FindJointPoints
 
 ///---------------------------------------------------------------------
@@ -1107,10 +1778,8 @@ static unsigned char *FindJointPoints(EdgeMap *map){
 /// maxClipSize is the maximum # of pixels to clip from the tips of the edge segments
 ///
 static void ClipEdgeSegments(EdgeMap *map, int maxClipSize=5){
-  int width = map->width;
-  int height = map->height;
-    
-  unsigned char *joints = FindJointPoints(map);
+  LabelMap &joints = *map->labels;
+  FindJointPoints(map);
 
   for (int i=0; i<map->noSegments; i++){
     // The loopy segments should not be broken
@@ -1123,31 +1792,32 @@ static void ClipEdgeSegments(EdgeMap *map, int maxClipSize=5){
     // Skip this segment if it forms a loop
     if (abs(fr-lr) <= 3 && abs(fc-lc) <= 3) continue;
 
-    for (int k=0; k<map->segments[i].noPixels; k++){
+    // A joint further in than maxClipSize pixels stops the search without a clip, so only the tips are looked at
+    for (int k=0; k<map->segments[i].noPixels && k<=maxClipSize; k++){
       int r = map->segments[i].pixels[k].r;
       int c = map->segments[i].pixels[k].c;  
 
-      if (joints[r*width+c]){
+      if (joints.Flagged(r, c, JOINT_POINT)){
         if (k <= maxClipSize){
           map->segments[i].pixels += k;
           map->segments[i].noPixels -= k;
 
-          joints[r*width+c] = 0;
+          joints.ClearFlag(r, c, JOINT_POINT);
         } //end-if
 
         break;
       } //end-if
     } //end-for
 
-    for (int k=map->segments[i].noPixels-1; k>=0; k--){
+    for (int k=map->segments[i].noPixels-1; k>=0 && map->segments[i].noPixels-k<=maxClipSize; k--){
       int r = map->segments[i].pixels[k].r;
       int c = map->segments[i].pixels[k].c;  
 
-      if (joints[r*width+c]){
+      if (joints.Flagged(r, c, JOINT_POINT)){
         if (map->segments[i].noPixels - k <= maxClipSize){
           map->segments[i].noPixels = k+1;
 
-          joints[r*width+c] = 0;
+          joints.ClearFlag(r, c, JOINT_POINT);
         } //end-if
 
         break;
@@ -1155,36 +1825,32 @@ static void ClipEdgeSegments(EdgeMap *map, int maxClipSize=5){
     } //end-for
 
   } //end-for
-
-  delete joints;
 } //end-ClipEdgeSegments
 
 ///---------------------------------------------------------------------
 /// Join edge segments whose endpoints are at most 2 pixels away from each other
 ///
 static void JoinNeighborEdgeSegments(EdgeMap *map){
+  PROFILE_STAGE("PEL JoinNeighborEdgeSegments");
+
+  if (map->noSegments == 0) return;
+
+  // Label the pixels of the segments once, for both the clipping & the joining
+  map->AttachLabels(&labelMap);
+
   // Clip the tips of the edge segments
   ClipEdgeSegments(map, 5);
 
   int width = map->width;
   int height = map->height;
 
-  int *segments = new int[width*height];
-  memset(segments, 0, sizeof(int)*width*height);
-
-  // Mark the end of the segments on the "segments" array
+  // Flag the ends of the clipped segments
+  LabelMap &labels = *map->labels;
   for (int i=0; i<map->noSegments; i++){
-    int r, c;
-
-    r = map->segments[i].pixels[0].r;
-    c = map->segments[i].pixels[0].c;
-    segments[r*width+c] = i+1;
-
-
-    int index = map->segments[i].noPixels-1;
-    r = map->segments[i].pixels[index].r;
-    c = map->segments[i].pixels[index].c;
-    segments[r*width+c] = i+1;
+    Pixel first = map->segments[i].pixels[0];
+    Pixel last = map->segments[i].pixels[map->segments[i].noPixels-1];
+    labels.SetFlag(first.r, first.c, END_POINT);
+    labels.SetFlag(last.r, last.c, END_POINT);
   } //end-for
 
   // Find the neighbors of each segment in the 2x2 neighborhood
@@ -1211,10 +1877,10 @@ static void JoinNeighborEdgeSegments(EdgeMap *map){
 
       for (int n=c-2; n<=c+2; n++){
         if (n < 0 || n >= width) continue;
-        if (segments[m*width+n] == 0) continue;
-        if (segments[m*width+n] == i+1) continue;
+        if (labels.Flagged(m, n, END_POINT) == false) continue;
+        int s = labels(m, n);
+        if (s == i) continue;
 
-        int s = segments[m*width+n]-1;
         if (map->segments[s].noPixels > len){neighbor=s; len = map->segments[s].noPixels;}
       } //end-for
     } //end-for
@@ -1231,10 +1897,10 @@ static void JoinNeighborEdgeSegments(EdgeMap *map){
 
       for (int n=c-2; n<=c+2; n++){
         if (n < 0 || n >= width) continue;
-        if (segments[m*width+n] == 0) continue;
-        if (segments[m*width+n] == i+1) continue;
+        if (labels.Flagged(m, n, END_POINT) == false) continue;
+        int s = labels(m, n);
+        if (s == i) continue;
 
-        int s = segments[m*width+n]-1;
         if (map->segments[s].noPixels > len){neighbor=s; len = map->segments[s].noPixels;}
       } //end-for
     } //end-for
@@ -1244,9 +1910,13 @@ static void JoinNeighborEdgeSegments(EdgeMap *map){
   } //end-for
 
   // Now join. Create a new edgemap for the joined edge segments
+  // Joined segments get their pixels copied, so take room for all pixels from the map's pool
+  int totalPixels = 0;
+  for (int i=0; i<map->noSegments; i++) totalPixels += map->segments[i].noPixels;
+
   int noSegments2 = 0;
-  EdgeSegment *segments2 = new EdgeSegment[map->noSegments*4];
-  Pixel *pix2 = map->segments[map->noSegments-1].pixels + map->segments[map->noSegments-1].noPixels;
+  EdgeSegment *segments2 = map->AllocSegments(map->noSegments);
+  Pixel *pix2 = map->AllocPixels(totalPixels);
   int *listBuffer = new int[map->noSegments*2];
 
   for (int i=0; i<map->noSegments; i++){
@@ -1259,7 +1929,6 @@ static void JoinNeighborEdgeSegments(EdgeMap *map){
 
       segments2[noSegments2].pixels = map->segments[i].pixels;
       segments2[noSegments2].noPixels = map->segments[i].noPixels;
-      pix2 += segments2[noSegments2].noPixels;
       noSegments2++;
 
       continue;
@@ -1349,12 +2018,12 @@ static void JoinNeighborEdgeSegments(EdgeMap *map){
   } //end-for
 
   map->noSegments = noSegments2;
-  delete map->segments;
-  map->segments = segments2;
+  map->segments = segments2;  // The old segments go back to the pool with the map
 
-  delete listBuffer;
-  delete nn;
-  delete segments;
+  delete[] listBuffer;
+  delete[] nn;
+
+  map->DetachLabels();
 } //end-JoinEdgeSegments
 
 ///============================= Step 4: ThinEdgeSegments ==================================
@@ -1365,26 +2034,64 @@ static void JoinNeighborEdgeSegments(EdgeMap *map){
 /// xx       x  
 ///
 ///
-static void ThinEdgeSegments(EdgeMap *map, int MIN_SEGMENT_LEN){
-  // Thin the edge segments
-  int noSegments = 0;
-  for (int i=0; i<map->noSegments; i++){
-    int index = 0;
-
-    for (int j=2; j<map->segments[i].noPixels; j++){
-      int dx = abs(map->segments[i].pixels[index].c - map->segments[i].pixels[j].c);
-      int dy = abs(map->segments[i].pixels[index].r - map->segments[i].pixels[j].r);
-      
-      if (dx >= 2 || dy >= 2){
-//      if (dx+dy >= 2){
-        map->segments[i].pixels[++index] = map->segments[i].pixels[j-1];
-      } // end-if
-    } //end-for
+static void ThinEdgeSegment(EdgeSegment *segment){
+  int index = 0;
+
+  for (int j=2; j<segment->noPixels; j++){
+    int dx = abs(segment->pixels[index].c - segment->pixels[j].c);
+    int dy = abs(segment->pixels[index].r - segment->pixels[j].r);
+    
+    if (dx >= 2 || dy >= 2){
+//    if (dx+dy >= 2){
+      segment->pixels[++index] = segment->pixels[j-1];
+    } // end-if
+  } //end-for
+
+  // Copy the last pixel
+  segment->pixels[++index] = segment->pixels[segment->noPixels-1];
+  segment->noPixels = index+1;
+} //end-ThinEdgeSegment
+
+///-------------------------------------------------------------------------------------------
+/// Each thread works on its share of the edge segments. Segments never share pixels
+///
+struct SegmentJob {
+  EdgeMap *map;
+  int numThreads;
+  void (*func)(EdgeSegment *segment);
+};
+
+static void RunOnSegments(int t, void *arg){
+  SegmentJob *job = (SegmentJob *)arg;
+
+  int first = (int)((long long)t*job->map->noSegments/job->numThreads);
+  int last = (int)((long long)(t+1)*job->map->noSegments/job->numThreads);
 
-    // Copy the last pixel
-    map->segments[i].pixels[++index] = map->segments[i].pixels[map->segments[i].noPixels-1];
-    map->segments[i].noPixels = index+1;
+  for (int i=first; i<last; i++) job->func(&job->map->segments[i]);
+} //end-RunOnSegments
 
+static void ForEachSegment(EdgeMap *map, void (*func)(EdgeSegment *segment), int numThreads){
+  if (numThreads > map->noSegments/64) numThreads = map->noSegments/64;
+
+  if (numThreads <= 1){
+    for (int i=0; i<map->noSegments; i++) func(&map->segments[i]);
+    return;
+  } //end-if
+
+  SegmentJob job = {map, numThreads, func};
+  RunThreads(numThreads, RunOnSegments, &job);
+} //end-ForEachSegment
+
+///-------------------------------------------------------------------------------------------
+/// Thin the edge segments & drop the ones that get too short
+///
+static void ThinEdgeSegments(EdgeMap *map, int MIN_SEGMENT_LEN, int numThreads){
+  PROFILE_STAGE("PEL ThinEdgeSegments");
+
+  ForEachSegment(map, ThinEdgeSegment, numThreads);
+
+  int noSegments = 0;
+  for (int i=0; i<map->noSegments; i++){
     if (map->segments[i].noPixels >= MIN_SEGMENT_LEN) map->segments[noSegments++] = map->segments[i];
   } //end-for
 
@@ -1402,64 +2109,68 @@ static void ThinEdgeSegments(EdgeMap *map, int MIN_SEGMENT_LEN){
 ///  xx
 /// x  x --> xxxx
 ///
-static void FixEdgeSegments(EdgeMap *map){
+static void FixEdgeSegment(EdgeSegment *segment){
   /// First fix one pixel problems: There are four cases
-  for (int i=0; i<map->noSegments; i++){
-    int cp = map->segments[i].noPixels-2;  // Current pixel index
-    int n2 = 0;  // next next pixel index
+  int cp = segment->noPixels-2;  // Current pixel index
+  int n2 = 0;  // next next pixel index
 
-    while (n2 < map->segments[i].noPixels){
-      int n1 = cp+1; // next pixel
+  while (n2 < segment->noPixels){
+    int n1 = cp+1; // next pixel
 
-      cp = cp % map->segments[i].noPixels; // Roll back to the beginning
-      n1 = n1 % map->segments[i].noPixels; // Roll back to the beginning
+    cp = cp % segment->noPixels; // Roll back to the beginning
+    n1 = n1 % segment->noPixels; // Roll back to the beginning
 
-      int r = map->segments[i].pixels[cp].r;
-      int c = map->segments[i].pixels[cp].c;
+    int r = segment->pixels[cp].r;
+    int c = segment->pixels[cp].c;
 
-      int r1 = map->segments[i].pixels[n1].r;
-      int c1 = map->segments[i].pixels[n1].c;
+    int r1 = segment->pixels[n1].r;
+    int c1 = segment->pixels[n1].c;
 
-      int r2 = map->segments[i].pixels[n2].r;
-      int c2 = map->segments[i].pixels[n2].c;
+    int r2 = segment->pixels[n2].r;
+    int c2 = segment->pixels[n2].c;
 
-      // 4 cases to fix
-      if (r2 == r-2 && c2 == c){
-        if (c1 != c){
-          map->segments[i].pixels[n1].c = c;
-        } //end-if
+    // 4 cases to fix
+    if (r2 == r-2 && c2 == c){
+      if (c1 != c){
+        segment->pixels[n1].c = c;
+      } //end-if
 
-        cp = n2;
-        n2 += 2;
+      cp = n2;
+      n2 += 2;
 
-      } else if (r2 == r+2 && c2 == c){
-        if (c1 != c){
-          map->segments[i].pixels[n1].c = c;
-        } //end-if
+    } else if (r2 == r+2 && c2 == c){
+      if (c1 != c){
+        segment->pixels[n1].c = c;
+      } //end-if
 
-        cp = n2;
-        n2 += 2;
+      cp = n2;
+      n2 += 2;
 
-      } else if (r2 == r && c2 == c-2){
-        if (r1 != r){
-          map->segments[i].pixels[n1].r = r;
-        } //end-if
+    } else if (r2 == r && c2 == c-2){
+      if (r1 != r){
+        segment->pixels[n1].r = r;
+      } //end-if
 
-        cp = n2;
-        n2 += 2;
+      cp = n2;
+      n2 += 2;
 
-      } else if (r2 == r && c2 == c+2){
-        if (r1 != r){
-          map->segments[i].pixels[n1].r = r;
-        } //end-if
+    } else if (r2 == r && c2 == c+2){
+      if (r1 != r){
+        segment->pixels[n1].r = r;
+      } //end-if
 
-        cp = n2;
-        n2 += 2;
+      cp = n2;
+      n2 += 2;
 
-      } else {
-        cp++;
-        n2++;
-      } //end-else
-    } //end-while
-  } // end-for
+    } else {
+      cp++;
+      n2++;
+    } //end-else
+  } //end-while
+} //end-FixEdgeSegment
+
+static void FixEdgeSegments(EdgeMap *map, int numThreads){
+  PROFILE_STAGE("PEL FixEdgeSegments");
+
+  ForEachSegment(map, FixEdgeSegment, numThreads);
 } //end-FixEdgeMap
@@ -0,0 +1,277 @@
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <stdio.h>
+
+///------------------------------------------------------------------------------------
+/// Per stage profiler. Build with -DPROFILE to turn it on; otherwise PROFILE_STAGE
+/// compiles to nothing & the query functions report no stages.
+///
+///   void SmoothImage(...){
+///     PROFILE_STAGE("SmoothImage");     // Times the rest of the enclosing block
+///     ...
+///
+/// Each thread adds its times & call counts to counters of its own, so stages running
+/// on several threads at once never contend. The clock is CLOCK_MONOTONIC. Every timed
+/// call is also kept as an event (up to PROFILE_MAX_EVENTS per thread) so that the run
+/// can be written as a Chrome trace (chrome://tracing, ui.perfetto.dev). The events are
+/// allocated PROFILE_EVENT_CHUNK at a time as they come, & the counters of a thread that
+/// exits are taken over by the next new thread, so a program that keeps starting threads
+/// does not keep growing the profiler.
+///
+struct ProfileStageStats {
+  const char *name;
+  long long calls;
+  double totalMs;
+};
+
+#ifdef PROFILE
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <mutex>
+
+#define PROFILE_MAX_STAGES  128
+#define PROFILE_MAX_EVENTS  (1<<20)
+#define PROFILE_EVENT_CHUNK 4096
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+
+// The stage id is looked up once per call site
+#define PROFILE_STAGE(name) \
+  static const int PROFILE_CONCAT(profileStage, __LINE__) = ProfileStageId(name); \
+  ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(PROFILE_CONCAT(profileStage, __LINE__))
+
+inline long long ProfileNow(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec*1000000000LL + ts.tv_nsec;
+} //end-ProfileNow
+
+struct ProfileEvent {
+  int stage;
+  long long start, end;       // ns
+};
+
+struct ProfileEventChunk {
+  ProfileEvent events[PROFILE_EVENT_CHUNK];
+  ProfileEventChunk *next;
+};
+
+// Counters of one thread. They outlive the thread so that short lived worker threads are still reported;
+// once the thread exits, a new thread adds to them & to its events (on the same track of the trace)
+struct ProfileThread {
+  int tid;
+  long long ns[PROFILE_MAX_STAGES];
+  long long calls[PROFILE_MAX_STAGES];
+
+  ProfileEventChunk *chunks;  // Kept over ProfileReset() for the next events
+  ProfileEventChunk *chunk;   // Chunk of the last event, NULL if there are none
+  int noEvents;
+
+  bool inUse;                 // A running thread has it
+  ProfileThread *next;
+};
+
+struct ProfileRegistry {
+  std::mutex lock;
+  const char *names[PROFILE_MAX_STAGES];
+  int noStages;
+
+  ProfileThread *threads;
+  int noThreads;
+  long long origin;           // Time 0 of the trace
+};
+
+inline ProfileRegistry &Profile(){
+  static ProfileRegistry registry = {{}, {}, 0, NULL, 0, ProfileNow()};
+  return registry;
+} //end-Profile
+
+// Id of a stage by name. Call sites with the same name share the stage
+inline int ProfileStageId(const char *name){
+  ProfileRegistry &R = Profile();
+  std::lock_guard<std::mutex> guard(R.lock);
+
+  for (int i=0; i<R.noStages; i++){
+    if (strcmp(R.names[i], name) == 0) return i;
+  } //end-for
+
+  if (R.noStages == PROFILE_MAX_STAGES) return PROFILE_MAX_STAGES-1;
+  R.names[R.noStages] = name;
+  return R.noStages++;
+} //end-ProfileStageId
+
+// Hands the counters of a thread back when it exits
+struct ProfileThreadSlot {
+  ProfileThread *T;
+
+  ~ProfileThreadSlot(){
+    if (T == NULL) return;
+
+    ProfileRegistry &R = Profile();
+    std::lock_guard<std::mutex> guard(R.lock);
+    T->inUse = false;
+    T = NULL;
+  } //end-~ProfileThreadSlot
+};
+
+// Counters of the calling thread: those of a thread that exited if there are any, new ones otherwise
+inline ProfileThread *ProfileThisThread(){
+  static thread_local ProfileThreadSlot slot = {NULL};
+  if (slot.T) return slot.T;
+
+  ProfileRegistry &R = Profile();
+  std::lock_guard<std::mutex> guard(R.lock);
+
+  ProfileThread *T = R.threads;
+  while (T && T->inUse) T = T->next;
+
+  if (T == NULL){
+    T = (ProfileThread *)calloc(1, sizeof(ProfileThread));
+    T->tid = R.noThreads++;
+    T->next = R.threads;
+    R.threads = T;
+  } //end-if
+
+  T->inUse = true;
+  slot.T = T;
+  return T;
+} //end-ProfileThisThread
+
+// Adds an event to T, in the next chunk when the last one is full
+inline void ProfileAddEvent(ProfileThread *T, int stage, long long start, long long end){
+  if (T->noEvents == PROFILE_MAX_EVENTS) return;
+
+  int index = T->noEvents % PROFILE_EVENT_CHUNK;
+  if (index == 0){
+    ProfileEventChunk **pNext = T->chunk ? &T->chunk->next : &T->chunks;
+    if (*pNext == NULL){
+      *pNext = (ProfileEventChunk *)malloc(sizeof(ProfileEventChunk));
+      if (*pNext == NULL) return;
+      (*pNext)->next = NULL;
+    } //end-if
+
+    T->chunk = *pNext;
+  } //end-if
+
+  ProfileEvent &e = T->chunk->events[index];
+  e.stage = stage;
+  e.start = start;
+  e.end = end;
+  T->noEvents++;
+} //end-ProfileAddEvent
+
+struct ProfileScope {
+  int stage;
+  long long start;
+
+  ProfileScope(int stage){
+    this->stage = stage;
+    start = ProfileNow();
+  } //end-ProfileScope
+
+  ~ProfileScope(){
+    long long end = ProfileNow();
+    ProfileThread *T = ProfileThisThread();
+
+    T->ns[stage] += end - start;
+    T->calls[stage]++;
+    ProfileAddEvent(T, stage, start, end);
+  } //end-~ProfileScope
+};
+
+///------------------------------------------------------------------------------------
+/// Totals of the stages over all threads since the last ProfileReset(), in the order the
+/// stages were first seen. Returns the # of stages, at most maxStages are written
+///
+inline int ProfileGetStages(ProfileStageStats *stats, int maxStages){
+  ProfileRegistry &R = Profile();
+  std::lock_guard<std::mutex> guard(R.lock);
+
+  int n = 0;
+  for (int i=0; i<R.noStages && n<maxStages; i++){
+    long long ns = 0, calls = 0;
+    for (ProfileThread *T = R.threads; T; T = T->next){ns += T->ns[i]; calls += T->calls[i];}
+    if (calls == 0) continue;
+
+    stats[n].name = R.names[i];
+    stats[n].calls = calls;
+    stats[n].totalMs = ns/1e6;
+    n++;
+  } //end-for
+
+  return n;
+} //end-ProfileGetStages
+
+// Clears all counters & events. No stage may be running on another thread
+inline void ProfileReset(){
+  ProfileRegistry &R = Profile();
+  std::lock_guard<std::mutex> guard(R.lock);
+
+  for (ProfileThread *T = R.threads; T; T = T->next){
+    memset(T->ns, 0, sizeof(T->ns));
+    memset(T->calls, 0, sizeof(T->calls));
+    T->chunk = NULL;
+    T->noEvents = 0;
+  } //end-for
+
+  R.origin = ProfileNow();
+} //end-ProfileReset
+
+inline void ProfilePrint(FILE *fp){
+  ProfileStageStats stats[PROFILE_MAX_STAGES];
+  int n = ProfileGetStages(stats, PROFILE_MAX_STAGES);
+
+  fprintf(fp, "%-36s %10s %12s %12s\n", "Stage", "Calls", "Total ms", "ms/call");
+  for (int i=0; i<n; i++){
+    fprintf(fp, "%-36s %10lld %12.3lf %12.4lf\n", stats[i].name, stats[i].calls, stats[i].totalMs, stats[i].totalMs/stats[i].calls);
+  } //end-for
+} //end-ProfilePrint
+
+///------------------------------------------------------------------------------------
+/// Writes the events since the last ProfileReset() as a Chrome trace: one complete ("X")
+/// event per timed call, in microseconds, one track per thread
+///
+inline bool ProfileWriteChromeTrace(const char *filename){
+  FILE *fp = fopen(filename, "w");
+  if (fp == NULL) return false;
+
+  ProfileRegistry &R = Profile();
+  std::lock_guard<std::mutex> guard(R.lock);
+
+  fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+
+  bool first = true;
+  for (ProfileThread *T = R.threads; T; T = T->next){
+    ProfileEventChunk *chunk = T->chunks;
+    for (int i=0; i<T->noEvents; i++){
+      if (i > 0 && i % PROFILE_EVENT_CHUNK == 0) chunk = chunk->next;
+
+      ProfileEvent &e = chunk->events[i % PROFILE_EVENT_CHUNK];
+      if (e.start < R.origin) continue;
+
+      fprintf(fp, "%s\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3lf, \"dur\": %.3lf}",
+              first ? "" : ",", R.names[e.stage], T->tid, (e.start - R.origin)/1e3, (e.end - e.start)/1e3);
+      first = false;
+    } //end-for
+  } //end-for
+
+  fprintf(fp, "\n]}\n");
+  return fclose(fp) == 0;
+} //end-ProfileWriteChromeTrace
+
+#else
+
+#define PROFILE_STAGE(name)
+
+inline int ProfileGetStages(ProfileStageStats *, int){return 0;}
+inline void ProfileReset(){}
+inline void ProfilePrint(FILE *){}
+inline bool ProfileWriteChromeTrace(const char *){return false;}
+
+#endif
+
+#endif
@@ -0,0 +1,286 @@
+#ifndef _SEGMENT_IO_H_
+#define _SEGMENT_IO_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "EdgeMap.h"
+
+///------------------------------------------------------------------------------------
+/// Writes to a file through a large buffer, so that the file sees a few big fwrite()s.
+/// Numbers go out little endian whatever the host is. A failed write is remembered &
+/// reported by Close()
+///
+struct BufferedWriter {
+  FILE *fp;
+  unsigned char *buffer;
+  size_t size;
+  size_t used;
+  bool failed;
+
+public:
+  // constructor
+  BufferedWriter(const char *filename, size_t bufferSize=1<<20){
+    fp = fopen(filename, "wb");
+    size = bufferSize;
+    buffer = (unsigned char *)malloc(size);
+    used = 0;
+    failed = (fp == NULL || buffer == NULL);
+  } //end-BufferedWriter
+
+  // Destructor
+  ~BufferedWriter(){
+    Close();
+    free(buffer);
+  } //end-~BufferedWriter
+
+  void Flush(){
+    if (fp && used > 0 && fwrite(buffer, 1, used, fp) != used) failed = true;
+    used = 0;
+  } //end-Flush
+
+  // Returns false if anything could not be written
+  bool Close(){
+    if (fp){
+      Flush();
+      if (fclose(fp) != 0) failed = true;
+      fp = NULL;
+    } //end-if
+
+    return !failed;
+  } //end-Close
+
+  void Put(const void *p, size_t n){
+    if (used + n > size){
+      Flush();
+      if (n > size){
+        if (fp && fwrite(p, 1, n, fp) != n) failed = true;
+        return;
+      } //end-if
+    } //end-if
+
+    memcpy(buffer+used, p, n);
+    used += n;
+  } //end-Put
+
+  void PutString(const char *s){Put(s, strlen(s));}
+
+  void PutUInt32(unsigned int v){
+    if (used + 4 > size) Flush();
+    buffer[used] = v; buffer[used+1] = v>>8; buffer[used+2] = v>>16; buffer[used+3] = v>>24;
+    used += 4;
+  } //end-PutUInt32
+
+  void PutFloat(float f){
+    unsigned int v;
+    memcpy(&v, &f, 4);
+    PutUInt32(v);
+  } //end-PutFloat
+
+  // 7 bits per byte, low bits first; the high bit tells that more bytes follow
+  void PutVarint(unsigned long long v){
+    if (used + 10 > size) Flush();
+    while (v >= 0x80){buffer[used++] = (v & 0x7F) | 0x80; v >>= 7;}
+    buffer[used++] = v;
+  } //end-PutVarint
+};
+
+///------------------------------------------------------------------------------------
+/// Saves the edge segments as a PLY mesh: one vertex per pixel in the xz plane, centered
+/// on the image, & one face per segment listing its vertices in chain order. The face
+/// lists are counted with a uint as segments may be longer than 255 pixels.
+/// binary_little_endian by default; ascii is kept for the tools that need text
+///
+inline bool SaveSegmentsPLY(const char *filename, EdgeMap *map, bool binary=true){
+  BufferedWriter out(filename);
+
+  int noVertices = 0;
+  for (int i=0; i<map->noSegments; i++) noVertices += map->segments[i].noPixels;
+
+  char line[100];
+  out.PutString("ply\n");
+  out.PutString(binary ? "format binary_little_endian 1.0\n" : "format ascii 1.0\n");
+  out.PutString("comment created by luluxxx\n");
+  sprintf(line, "element vertex %d\n", noVertices); out.PutString(line);
+  out.PutString("property float x\n");
+  out.PutString("property float y\n");
+  out.PutString("property float z\n");
+  sprintf(line, "element face %d\n", map->noSegments); out.PutString(line);
+  out.PutString("property list uint int vertex_indices\n");
+  out.PutString("end_header\n");
+
+  // Vertices
+  float cx = (float)(map->width/2) - 0.5f;
+  float cy = (float)(map->height/2) - 0.5f;
+
+  for (int i=0; i<map->noSegments; i++){
+    Pixel *pixels = map->segments[i].pixels;
+
+    for (int j=0; j<map->segments[i].noPixels; j++){
+      float x = pixels[j].c - cx;
+      float z = pixels[j].r - cy;
+
+      if (binary){
+        out.PutFloat(x);
+        out.PutFloat(0.0f);
+        out.PutFloat(z);
+
+      } else {
+        sprintf(line, "%f 0 %f\n", x, z);
+        out.PutString(line);
+      } //end-else
+    } //end-for
+  } //end-for
+
+  // Faces: the vertices of a segment are consecutive
+  int vertex = 0;
+  for (int i=0; i<map->noSegments; i++){
+    int noPixels = map->segments[i].noPixels;
+
+    if (binary){
+      out.PutUInt32(noPixels);
+      for (int j=0; j<noPixels; j++) out.PutUInt32(vertex++);
+
+    } else {
+      sprintf(line, "%d", noPixels); out.PutString(line);
+      for (int j=0; j<noPixels; j++){sprintf(line, " %d", vertex++); out.PutString(line);}
+      out.PutString("\n");
+    } //end-else
+  } //end-for
+
+  return out.Close();
+} //end-SaveSegmentsPLY
+
+///------------------------------------------------------------------------------------
+/// Compact chain format. All numbers are varints (see BufferedWriter::PutVarint):
+///   "PELC" 1 width height noSegments
+///   per segment: noPixels r c step step ... (noPixels-1 steps)
+/// A step is the move (dr, dc) from the previous pixel: both are zigzag coded
+/// (0,-1,1,-2,2,... -> 0,1,2,3,4,...) & their bits interleaved, dr's in the odd bits.
+/// The 8 moves of a chain of neighbors fit in 1 byte
+///
+inline unsigned int ZigZag(int v){return ((unsigned int)v << 1) ^ (unsigned int)(v >> 31);}
+inline int UnZigZag(unsigned int v){return (int)(v >> 1) ^ -(int)(v & 1);}
+
+// Spreads the 32 bits of v to the even bits
+inline unsigned long long SpreadBits(unsigned int x){
+  unsigned long long v = x;
+  v = (v | (v << 16)) & 0x0000FFFF0000FFFFULL;
+  v = (v | (v << 8))  & 0x00FF00FF00FF00FFULL;
+  v = (v | (v << 4))  & 0x0F0F0F0F0F0F0F0FULL;
+  v = (v | (v << 2))  & 0x3333333333333333ULL;
+  v = (v | (v << 1))  & 0x5555555555555555ULL;
+  return v;
+} //end-SpreadBits
+
+inline unsigned int GatherBits(unsigned long long v){
+  v &= 0x5555555555555555ULL;
+  v = (v | (v >> 1))  & 0x3333333333333333ULL;
+  v = (v | (v >> 2))  & 0x0F0F0F0F0F0F0F0FULL;
+  v = (v | (v >> 4))  & 0x00FF00FF00FF00FFULL;
+  v = (v | (v >> 8))  & 0x0000FFFF0000FFFFULL;
+  v = (v | (v >> 16)) & 0x00000000FFFFFFFFULL;
+  return (unsigned int)v;
+} //end-GatherBits
+
+inline bool SaveSegmentChains(const char *filename, EdgeMap *map){
+  BufferedWriter out(filename);
+
+  out.PutString("PELC");
+  out.PutVarint(1);
+  out.PutVarint(map->width);
+  out.PutVarint(map->height);
+  out.PutVarint(map->noSegments);
+
+  for (int i=0; i<map->noSegments; i++){
+    Pixel *pixels = map->segments[i].pixels;
+    int noPixels = map->segments[i].noPixels;
+
+    out.PutVarint(noPixels);
+    if (noPixels == 0) continue;
+
+    out.PutVarint(pixels[0].r);
+    out.PutVarint(pixels[0].c);
+
+    for (int j=1; j<noPixels; j++){
+      unsigned int dr = ZigZag(pixels[j].r - pixels[j-1].r);
+      unsigned int dc = ZigZag(pixels[j].c - pixels[j-1].c);
+      out.PutVarint((SpreadBits(dr) << 1) | SpreadBits(dc));
+    } //end-for
+  } //end-for
+
+  return out.Close();
+} //end-SaveSegmentChains
+
+///------------------------------------------------------------------------------------
+/// Reads a file written by SaveSegmentChains. Returns NULL if it can not be read
+///
+inline const unsigned char *GetVarint(const unsigned char *p, const unsigned char *end, unsigned long long *v){
+  unsigned long long value = 0;
+  for (int shift=0; p < end && shift < 64; shift += 7){
+    unsigned char b = *p++;
+    value |= (unsigned long long)(b & 0x7F) << shift;
+    if ((b & 0x80) == 0){*v = value; return p;}
+  } //end-for
+
+  return NULL;
+} //end-GetVarint
+
+inline EdgeMap *LoadSegmentChains(const char *filename){
+  FILE *fp = fopen(filename, "rb");
+  if (fp == NULL) return NULL;
+
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  unsigned char *data = (unsigned char *)malloc(size > 0 ? size : 1);
+  bool ok = size > 4 && fread(data, 1, size, fp) == (size_t)size && memcmp(data, "PELC", 4) == 0;
+  fclose(fp);
+
+  const unsigned char *p = data+4;
+  const unsigned char *end = data+size;
+  unsigned long long version = 0, width = 0, height = 0, noSegments = 0;
+
+  if (ok) ok = (p = GetVarint(p, end, &version)) && version == 1;
+  if (ok) ok = (p = GetVarint(p, end, &width)) && (p = GetVarint(p, end, &height)) && (p = GetVarint(p, end, &noSegments));
+
+  // Every pixel takes at least 1 byte, so the size of the file bounds the # of segments & pixels
+  if (ok) ok = width > 0 && height > 0 && width*height < (1ULL<<31) && noSegments <= (unsigned long long)size;
+  if (ok == false){free(data); return NULL;}
+
+  EdgeMap *map = new EdgeMap((int)width, (int)height, (int)size, (int)noSegments);
+  Pixel *pixels = map->pixels;
+
+  for (int i=0; i<(int)noSegments && ok; i++){
+    unsigned long long noPixels, r = 0, c = 0;
+    ok = (p = GetVarint(p, end, &noPixels)) && noPixels <= (unsigned long long)(end-p);
+    if (ok && noPixels > 0) ok = (p = GetVarint(p, end, &r)) && (p = GetVarint(p, end, &c));
+
+    for (int j=0; j<(int)noPixels && ok; j++){
+      if (j > 0){
+        unsigned long long step;
+        if ((p = GetVarint(p, end, &step)) == NULL){ok = false; break;}
+        r += UnZigZag(GatherBits(step >> 1));
+        c += UnZigZag(GatherBits(step));
+      } //end-if
+
+      ok = r < height && c < width;
+      pixels[j].r = (int)r;
+      pixels[j].c = (int)c;
+    } //end-for
+
+    map->segments[i].pixels = pixels;
+    map->segments[i].noPixels = (int)noPixels;
+    map->noSegments = i+1;
+    pixels += noPixels;
+  } //end-for
+
+  free(data);
+  if (ok == false){delete map; return NULL;}
+
+  return map;
+} //end-LoadSegmentChains
+
+#endif